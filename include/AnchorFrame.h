@@ -0,0 +1,362 @@
+#ifndef ANCHOR_FRAME_H
+#define ANCHOR_FRAME_H
+
+#include <stddef.h>
+#include <string.h>
+#include "DataUtils.h"
+
+// ============================================================================
+// PROTOCOLO ANCLA -> CONCENTRADOR
+//
+// v1: un AnchorRangeReport_t por frame ESP-NOW (71 bytes, sin cabecera).
+//
+// v2: cabecera + N registros agregados hasta el límite de ESP-NOW:
+//   frame    = AnchorFrameHeader_t + registro * count
+//   registro = tipo (1 B) + largo del contenido (1 B) + contenido
+// Lo que es del ancla (saddr, PHY, base de tiempo) viaja una vez por frame;
+// cada registro lleva solo lo propio de un (tag, seq). Un tipo desconocido
+// se salta por su largo, como en el log de flash.
+//
+// Un frame es v2 si empieza con magic + versión y los registros ocupan
+// exactamente el largo recibido; si no, y mide sizeof(AnchorRangeReport_t),
+// es v1. Los anclas pueden migrar de a una: el concentrador acepta ambos.
+//
+// El timestamp y los sensores del tag (TagTelemetry_t, 39 bytes) son los
+// mismos para todas las anclas que oyen una secuencia. RANGE_FULL los repite
+// en cada registro, como v1; con RANGE + TAG_TELEMETRY cada ancla envía solo
+// su medición (26 bytes) y el bloque del tag lo envían, por turno, las
+// anclas a las que les toca esa seq (telemetry_duty). El concentrador lo
+// guarda en el estado del tag.
+// ============================================================================
+#define ESPNOW_MAX_PAYLOAD     250
+#define ANCHOR_FRAME_MAGIC     0xA7
+#define ANCHOR_FRAME_VERSION   2
+
+enum AnchorRecordType : uint8_t {
+    ANCHOR_REC_RANGE_FULL    = 1,  // rango + calidad + telemetría del tag
+    ANCHOR_REC_RANGE         = 2,  // rango + calidad
+    ANCHOR_REC_TAG_TELEMETRY = 3   // telemetría de un (tag, seq)
+};
+
+#pragma pack(push, 1)
+typedef struct AnchorFrameHeader_t {
+    uint8_t  magic;          // ANCHOR_FRAME_MAGIC
+    uint8_t  version;        // ANCHOR_FRAME_VERSION
+    uint16_t anchor_saddr;
+    uint32_t t_base_ms;      // t_ms del ancla; cada registro lleva su delta
+    uint8_t  uwb_ch, uwb_prf, uwb_pcode, uwb_drate;
+    uint8_t  count;          // registros en el frame
+} AnchorFrameHeader_t;       // 13 bytes
+
+typedef struct AnchorRecordHeader_t {
+    uint8_t type;            // AnchorRecordType
+    uint8_t len;             // bytes de contenido que siguen
+} AnchorRecordHeader_t;
+
+// Medición de un (tag, seq): lo mismo que v1 sin los campos del ancla
+typedef struct RangeRecord_t {
+    uint32_t tag_uid;
+    uint16_t seq;
+    uint16_t dt_ms;          // t_ms - t_base_ms
+    float    range_m;
+    uint16_t rxpacc;
+    uint16_t std_noise;
+    uint16_t fp_ampl1, fp_ampl2, fp_ampl3;
+    uint16_t cir_pwr;
+} RangeRecord_t;             // 24 bytes
+
+// Timestamp y sensores del tag (mismas escalas que v1)
+typedef struct TagTelemetry_t {
+    uint16_t year;
+    uint8_t  month, day, hour, minute, second;
+    uint16_t millis;
+    int16_t  temp;
+    uint16_t hum;
+    int16_t  aX, aY, aZ, aSQ;
+    int16_t  gX, gY, gZ;
+    int16_t  mX, mY, mZ;
+    uint16_t mDir;
+    char     etiqueta[4];
+} TagTelemetry_t;            // 39 bytes
+
+typedef struct RangeFullRecord_t {
+    RangeRecord_t  range;
+    TagTelemetry_t telemetry;
+} RangeFullRecord_t;         // 63 bytes (+2 de cabecera)
+
+typedef struct TagTelemetryRecord_t {
+    uint32_t tag_uid;
+    uint16_t seq;
+    TagTelemetry_t telemetry;
+} TagTelemetryRecord_t;      // 45 bytes (+2 de cabecera)
+#pragma pack(pop)
+
+// Resultado de decodificar un frame
+struct AnchorFrameInfo {
+    uint8_t version = 0;     // 1, 2 o 0 si se rechazó
+    uint8_t reports = 0;     // reportes entregados
+    uint8_t telemetry = 0;   // bloques TAG_TELEMETRY entregados
+    uint8_t skipped = 0;     // registros de tipo desconocido
+    bool    truncated = false; // v2 con registros que no cierran con el largo
+};
+
+// ============================================================================
+// Conversión de registros v2 <-> DecodedAnchorReport_t
+// ============================================================================
+inline void unpack_tag_telemetry(const TagTelemetry_t& t, DecodedAnchorReport_t& d) {
+    d.year   = t.year;
+    d.month  = t.month;   d.day    = t.day;
+    d.hour   = t.hour;    d.minute = t.minute; d.second = t.second;
+    d.millis = t.millis;
+
+    d.temp = t.temp / TEMP_SCALE;
+    d.hum  = t.hum  / HUM_SCALE;
+    d.aX = t.aX / ACC_SCALE;  d.aY = t.aY / ACC_SCALE;  d.aZ = t.aZ / ACC_SCALE;  d.aSQ = t.aSQ / ACC_SCALE;
+    d.gX = t.gX / GYR_SCALE;  d.gY = t.gY / GYR_SCALE;  d.gZ = t.gZ / GYR_SCALE;
+    d.mX = t.mX / MAG_SCALE;  d.mY = t.mY / MAG_SCALE;  d.mZ = t.mZ / MAG_SCALE;
+    d.mDir = t.mDir / MDIR_SCALE;
+
+    // El campo del aire puede venir sin '\0': se copia hasta el largo fijo y
+    // se termina a mano
+    static_assert(sizeof(d.etiqueta) == sizeof(t.etiqueta), "etiqueta: mismo largo en aire y en memoria");
+    const size_t n = strnlen(t.etiqueta, sizeof(d.etiqueta) - 1);
+    memcpy(d.etiqueta, t.etiqueta, n);
+    d.etiqueta[n] = '\0';
+}
+
+inline TagTelemetry_t pack_tag_telemetry(const DecodedAnchorReport_t& d) {
+    TagTelemetry_t t = {};
+    t.year   = d.year;
+    t.month  = d.month;   t.day    = d.day;
+    t.hour   = d.hour;    t.minute = d.minute; t.second = d.second;
+    t.millis = d.millis;
+
+    t.temp = clamp_i16(d.temp * TEMP_SCALE);
+    t.hum  = clamp_u16(d.hum  * HUM_SCALE);
+    t.aX = clamp_i16(d.aX * ACC_SCALE);  t.aY = clamp_i16(d.aY * ACC_SCALE);
+    t.aZ = clamp_i16(d.aZ * ACC_SCALE);  t.aSQ = clamp_i16(d.aSQ * ACC_SCALE);
+    t.gX = clamp_i16(d.gX * GYR_SCALE);  t.gY = clamp_i16(d.gY * GYR_SCALE);  t.gZ = clamp_i16(d.gZ * GYR_SCALE);
+    t.mX = clamp_i16(d.mX * MAG_SCALE);  t.mY = clamp_i16(d.mY * MAG_SCALE);  t.mZ = clamp_i16(d.mZ * MAG_SCALE);
+    t.mDir = clamp_u16(d.mDir * MDIR_SCALE);
+
+    // t viene en cero: el resto del campo queda relleno y terminado
+    memcpy(t.etiqueta, d.etiqueta, strnlen(d.etiqueta, sizeof(t.etiqueta) - 1));
+    return t;
+}
+
+inline void unpack_range_record(const AnchorFrameHeader_t& h, const RangeRecord_t& r, DecodedAnchorReport_t& d) {
+    d.anchor_saddr = h.anchor_saddr;
+    d.tag_uid      = r.tag_uid;
+    d.seq          = r.seq;
+    d.range_m      = r.range_m;
+    d.t_ms         = h.t_base_ms + r.dt_ms;
+
+    d.rxpacc    = r.rxpacc;
+    d.std_noise = r.std_noise;
+    d.fp_ampl1  = r.fp_ampl1;
+    d.fp_ampl2  = r.fp_ampl2;
+    d.fp_ampl3  = r.fp_ampl3;
+    d.cir_pwr   = r.cir_pwr;
+
+    d.uwb_ch    = h.uwb_ch;
+    d.uwb_prf   = h.uwb_prf;
+    d.uwb_pcode = h.uwb_pcode;
+    d.uwb_drate = h.uwb_drate;
+}
+
+inline void pack_range_record(const DecodedAnchorReport_t& d, uint32_t t_base_ms, RangeRecord_t& r) {
+    r.tag_uid   = d.tag_uid;
+    r.seq       = d.seq;
+    r.dt_ms     = (uint16_t)(d.t_ms - t_base_ms);
+    r.range_m   = d.range_m;
+    r.rxpacc    = d.rxpacc;
+    r.std_noise = d.std_noise;
+    r.fp_ampl1  = d.fp_ampl1;
+    r.fp_ampl2  = d.fp_ampl2;
+    r.fp_ampl3  = d.fp_ampl3;
+    r.cir_pwr   = d.cir_pwr;
+}
+
+// ¿Le toca a esta ancla enviar el bloque del tag para esta seq? Las anclas
+// del despliegue se numeran 0..total-1 (en su firmware) y la tarea rota con
+// la seq: cada secuencia la cubren `copies` anclas consecutivas. Si ninguna
+// de ellas oyó al tag, esa seq queda sin telemetría; copies > 1 lo hace
+// menos probable a cambio de bytes.
+inline bool telemetry_duty(uint16_t seq, uint8_t index, uint8_t total, uint8_t copies) {
+    if (total == 0 || copies >= total) return true;
+    return (uint8_t)((seq + total - index % total) % total) < copies;
+}
+
+// ============================================================================
+// Decodifica un frame v1 o v2 en una sola pasada, entregando cada reporte a
+// sink(DecodedAnchorReport_t&) y cada bloque del tag suelto a
+// telemetrySink(const TagTelemetryRecord_t&), sin copias intermedias del
+// frame. En v2 la estructura se valida mientras se recorre: los registros se
+// entregan a medida que se leen y uno que no cabe en el frame corta el
+// recorrido. Los reportes v1 y RANGE_FULL llegan con has_telemetry.
+// ============================================================================
+template <typename Sink, typename TelemetrySink>
+inline AnchorFrameInfo decode_anchor_frame(const uint8_t* data, int len, Sink&& sink, TelemetrySink&& telemetrySink) {
+    AnchorFrameInfo info;
+    if (len <= 0) return info;
+
+    if ((size_t)len >= sizeof(AnchorFrameHeader_t) && data[0] == ANCHOR_FRAME_MAGIC && data[1] == ANCHOR_FRAME_VERSION) {
+        AnchorFrameHeader_t h;
+        memcpy(&h, data, sizeof(h));
+        size_t off = sizeof(h);
+        uint8_t seen = 0;
+        for (; seen < h.count; seen++) {
+            if (off + sizeof(AnchorRecordHeader_t) > (size_t)len) break;
+            const uint8_t type = data[off];
+            const uint8_t rlen = data[off + 1];
+            if (off + sizeof(AnchorRecordHeader_t) + rlen > (size_t)len) break;
+            off += sizeof(AnchorRecordHeader_t);
+
+            if (type == ANCHOR_REC_RANGE_FULL && rlen >= sizeof(RangeFullRecord_t)) {
+                RangeFullRecord_t r;
+                memcpy(&r, data + off, sizeof(r));
+                DecodedAnchorReport_t d = {};
+                unpack_range_record(h, r.range, d);
+                unpack_tag_telemetry(r.telemetry, d);
+                d.has_telemetry = true;
+                info.reports++;
+                sink(d);
+            } else if (type == ANCHOR_REC_RANGE && rlen >= sizeof(RangeRecord_t)) {
+                RangeRecord_t r;
+                memcpy(&r, data + off, sizeof(r));
+                DecodedAnchorReport_t d = {};
+                unpack_range_record(h, r, d);
+                info.reports++;
+                sink(d);
+            } else if (type == ANCHOR_REC_TAG_TELEMETRY && rlen >= sizeof(TagTelemetryRecord_t)) {
+                TagTelemetryRecord_t t;
+                memcpy(&t, data + off, sizeof(t));
+                info.telemetry++;
+                telemetrySink(t);
+            } else {
+                info.skipped++;
+            }
+            off += rlen;
+        }
+        info.truncated = (seen != h.count) || (off != (size_t)len);
+        if (info.reports > 0 || info.telemetry > 0 || !info.truncated) {
+            info.version = ANCHOR_FRAME_VERSION;
+            return info;
+        }
+        // Nada válido: puede ser un v1 de un ancla cuyo saddr imita la cabecera
+        info = AnchorFrameInfo();
+    }
+
+    if (len != sizeof(AnchorRangeReport_t)) return info;
+    AnchorRangeReport_t packed;
+    memcpy(&packed, data, sizeof(packed));
+    DecodedAnchorReport_t d = unpack_anchor_report(packed);
+    info.version = 1;
+    info.reports = 1;
+    sink(d);
+    return info;
+}
+
+// saddr que declara el frame, sin entregar sus reportes (para filtrar por
+// emisor). false si no tiene forma de v1 ni de v2. Un frame del tamaño de
+// un v1 con cabecera v2 se clasifica igual que en decode_anchor_frame: si el
+// recorrido v2 no entrega nada es un v1 cuyo saddr imita la cabecera.
+inline bool anchor_frame_saddr(const uint8_t* data, int len, uint16_t& saddr) {
+    if (len >= (int)sizeof(AnchorFrameHeader_t) && data[0] == ANCHOR_FRAME_MAGIC && data[1] == ANCHOR_FRAME_VERSION) {
+        const bool v2 = len != (int)sizeof(AnchorRangeReport_t)
+            || decode_anchor_frame(data, len, [](DecodedAnchorReport_t&) {},
+                                   [](const TagTelemetryRecord_t&) {}).version == ANCHOR_FRAME_VERSION;
+        if (v2) {
+            saddr = (uint16_t)(data[offsetof(AnchorFrameHeader_t, anchor_saddr)]
+                             | (data[offsetof(AnchorFrameHeader_t, anchor_saddr) + 1] << 8));
+            return true;
+        }
+    }
+    if (len != (int)sizeof(AnchorRangeReport_t)) return false;
+    saddr = (uint16_t)(data[0] | (data[1] << 8));
+    return true;
+}
+
+// ============================================================================
+// Armado de frames v2 en el ancla (y en el simulador). Acumula reportes
+// hasta que el siguiente no cabe en ESPNOW_MAX_PAYLOAD o su t_ms se aleja
+// de la base más de lo que admite dt_ms; el llamador envía el frame y
+// reinicia con reset().
+//   add():      RANGE_FULL, la telemetría del tag en cada registro.
+//   addRange(): RANGE y, si withTelemetry, el TAG_TELEMETRY de esa seq en
+//               el mismo frame (ambos o ninguno).
+// ============================================================================
+class AnchorFrameBuilder {
+public:
+    AnchorFrameBuilder() { reset(); }
+
+    void reset() { _len = 0; _count = 0; _tBase = 0; }
+    bool empty() const { return _count == 0; }
+    const uint8_t* data() const { return _buf; }
+    size_t size() const { return _len; }
+    uint8_t count() const { return _count; }
+
+    // false si el reporte no cabe: enviar el frame actual y reintentar
+    bool add(const DecodedAnchorReport_t& d) {
+        if (!reserve(d, sizeof(RangeFullRecord_t), 1)) return false;
+        RangeFullRecord_t r = {};
+        pack_range_record(d, _tBase, r.range);
+        r.telemetry = pack_tag_telemetry(d);
+        append(ANCHOR_REC_RANGE_FULL, &r, sizeof(r));
+        return true;
+    }
+
+    bool addRange(const DecodedAnchorReport_t& d, bool withTelemetry) {
+        const size_t need = sizeof(RangeRecord_t)
+            + (withTelemetry ? sizeof(AnchorRecordHeader_t) + sizeof(TagTelemetryRecord_t) : 0);
+        if (!reserve(d, need, withTelemetry ? 2 : 1)) return false;
+        RangeRecord_t r = {};
+        pack_range_record(d, _tBase, r);
+        append(ANCHOR_REC_RANGE, &r, sizeof(r));
+        if (withTelemetry) {
+            TagTelemetryRecord_t t = {};
+            t.tag_uid   = d.tag_uid;
+            t.seq       = d.seq;
+            t.telemetry = pack_tag_telemetry(d);
+            append(ANCHOR_REC_TAG_TELEMETRY, &t, sizeof(t));
+        }
+        return true;
+    }
+
+private:
+    // Abre el frame con el primer reporte o verifica que caben `bytes` más
+    // (sin la cabecera del primer registro) y `records` registros
+    bool reserve(const DecodedAnchorReport_t& d, size_t bytes, uint8_t records) {
+        if (_count == 0) {
+            AnchorFrameHeader_t h = {};
+            h.magic        = ANCHOR_FRAME_MAGIC;
+            h.version      = ANCHOR_FRAME_VERSION;
+            h.anchor_saddr = d.anchor_saddr;
+            h.t_base_ms    = d.t_ms;
+            h.uwb_ch = d.uwb_ch;        h.uwb_prf = d.uwb_prf;
+            h.uwb_pcode = d.uwb_pcode;  h.uwb_drate = d.uwb_drate;
+            memcpy(_buf, &h, sizeof(h));
+            _len = sizeof(h);
+            _tBase = d.t_ms;
+            return true;
+        }
+        return _len + sizeof(AnchorRecordHeader_t) + bytes <= ESPNOW_MAX_PAYLOAD
+            && _count + records <= 255 && d.t_ms - _tBase <= 0xFFFF;
+    }
+
+    void append(uint8_t type, const void* body, size_t len) {
+        const AnchorRecordHeader_t rh = { type, (uint8_t)len };
+        memcpy(_buf + _len, &rh, sizeof(rh));
+        memcpy(_buf + _len + sizeof(rh), body, len);
+        _len += sizeof(rh) + len;
+        _count++;
+        _buf[offsetof(AnchorFrameHeader_t, count)] = _count;
+    }
+
+    uint8_t  _buf[ESPNOW_MAX_PAYLOAD];
+    size_t   _len;
+    uint8_t  _count;
+    uint32_t _tBase;
+};
+
+#endif // ANCHOR_FRAME_H
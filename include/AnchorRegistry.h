@@ -0,0 +1,104 @@
+#ifndef ANCHOR_REGISTRY_H
+#define ANCHOR_REGISTRY_H
+
+#include <atomic>
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include "PositioningManager.h"
+#include "Seqlock.h"
+
+// --- CONFIGURACIÓN DEL REGISTRO DE ANCLAS (redefinibles con -D en build_flags) ---
+#ifndef REGISTRY_PATH
+#define REGISTRY_PATH      "/anchors.bin"
+#endif
+#ifndef REGISTRY_SAVE_MS
+#define REGISTRY_SAVE_MS   5000          // agrupa los cambios antes de escribir en flash
+#endif
+#define REGISTRY_MAX       MAX_ANCHORS
+#define REGISTRY_MAGIC     0x31524741UL  // "AGR1" en little-endian
+
+// - OPEN:    no filtra (solo cuenta desconocidos y discrepancias).
+// - LEARN:   puesta en marcha: cada MAC nueva se registra con el saddr que
+//            declara; una discrepancia actualiza el registro.
+// - ENFORCE: solo pasan las MAC registradas con su saddr.
+enum RegistryMode : uint8_t {
+    REGISTRY_OPEN    = 0,
+    REGISTRY_LEARN   = 1,
+    REGISTRY_ENFORCE = 2
+};
+
+enum RegistryVerdict : uint8_t {
+    REGISTRY_ACCEPT   = 0,
+    REGISTRY_UNKNOWN  = 1,   // MAC no registrada
+    REGISTRY_MISMATCH = 2    // MAC registrada con otro saddr
+};
+
+// MAC en dos palabras para comparar sin memcmp
+struct RegistryEntry {
+    uint32_t mac_hi;         // bytes 0..3
+    uint16_t mac_lo;         // bytes 4..5
+    uint16_t saddr;
+};
+
+#pragma pack(push, 1)
+typedef struct RegistryFileHeader_t {
+    uint32_t magic;          // REGISTRY_MAGIC
+    uint8_t  count;
+} RegistryFileHeader_t;
+#pragma pack(pop)
+
+// ============================================================================
+// Registro MAC -> ancla, consultado en el callback de ESP-NOW antes de
+// copiar o decodificar el frame. Un emisor desconocido se descarta con una
+// recorrida de a lo sumo REGISTRY_MAX comparaciones de dos palabras.
+// - check() corre en la tarea Wi-Fi y es el único escritor de las casillas
+//   (aprendizaje, vaciado pedido desde la web).
+// - La web y loop() leen las casillas con seqlock; loop() guarda el registro
+//   en LittleFS tras REGISTRY_SAVE_MS sin cambios.
+// - Al arrancar: ENFORCE si hay un registro guardado, LEARN si no.
+// ============================================================================
+class AnchorRegistry {
+public:
+    AnchorRegistry();
+    bool begin();
+    void loop();
+    void serve(AsyncWebServer& server);
+
+    // Tarea Wi-Fi: saddr es el que declara el payload (anchor_frame_saddr)
+    RegistryVerdict check(const uint8_t* mac, uint16_t saddr);
+
+    void setMode(RegistryMode mode) { _mode.store(mode, std::memory_order_relaxed); }
+    RegistryMode mode() const { return (RegistryMode)_mode.load(std::memory_order_relaxed); }
+    // Se aplica en el próximo frame recibido (lo ejecuta la tarea Wi-Fi)
+    void requestClear() { _clearRequested.store(true, std::memory_order_release); }
+
+    size_t count() const { return _count.load(std::memory_order_acquire); }
+    bool read(size_t index, RegistryEntry& out) const;
+
+    static const char* modeName(RegistryMode mode);
+    static bool parseMode(const char* name, RegistryMode& out);
+
+    // Contadores para /metrics (solo los incrementa la tarea Wi-Fi)
+    uint32_t unknown() const { return _unknown; }
+    uint32_t mismatch() const { return _mismatch; }
+    uint32_t rejected() const { return _rejected; }
+    uint32_t learned() const { return _learned; }
+
+private:
+    bool load();
+    bool save();
+    void markDirty();
+
+    SeqlockSlot<RegistryEntry> _entries[REGISTRY_MAX];
+    std::atomic<uint8_t>  _count;
+    std::atomic<uint8_t>  _mode;
+    std::atomic<bool>     _clearRequested;
+    std::atomic<uint32_t> _changedMs;   // último cambio (0 = guardado)
+
+    uint32_t _unknown;
+    uint32_t _mismatch;
+    uint32_t _rejected;
+    uint32_t _learned;
+};
+
+#endif // ANCHOR_REGISTRY_H
@@ -0,0 +1,147 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+// --- CONFIGURACIÓN DEL LOG DIFERIDO ---
+#define ASYNCLOG_RING_SIZE   64      // entradas en el anillo (potencia de dos)
+#define ASYNCLOG_MAX_ARGS     6      // argumentos por mensaje
+#define ASYNCLOG_LINE_MAX   192      // línea formateada más larga
+#define ASYNCLOG_TASK_STACK 4096
+#define ASYNCLOG_TASK_PRIO     1     // la de loopTask (se turnan por tick), muy por debajo de la tarea Wi-Fi
+
+enum LogLevel : uint8_t {
+    LOG_LEVEL_OFF   = 0,
+    LOG_LEVEL_ERROR = 1,
+    LOG_LEVEL_WARN  = 2,
+    LOG_LEVEL_INFO  = 3,
+    LOG_LEVEL_DEBUG = 4
+};
+
+// Nivel máximo compilado: sin -DDEBUG_ENABLED solo quedan errores y avisos.
+// El nivel efectivo se elige en tiempo de ejecución (setLevel, /loglevel).
+#ifndef ASYNCLOG_MAX_LEVEL
+#ifdef DEBUG_ENABLED
+#define ASYNCLOG_MAX_LEVEL LOG_LEVEL_DEBUG
+#else
+#define ASYNCLOG_MAX_LEVEL LOG_LEVEL_WARN
+#endif
+#endif
+
+enum LogArgType : uint8_t {
+    LOG_ARG_I32, LOG_ARG_U32, LOG_ARG_I64, LOG_ARG_U64, LOG_ARG_F64, LOG_ARG_PTR, LOG_ARG_STR
+};
+
+union LogValue {
+    int64_t     i;
+    uint64_t    u;
+    double      d;
+    const void* p;
+};
+
+// Mensaje diferido: puntero al formato (literal, vive todo el programa) y
+// los argumentos crudos. El formateo ocurre en la tarea de drenado.
+struct LogEntry {
+    const char* fmt;
+    uint32_t    t_ms;
+    uint8_t     level;
+    uint8_t     nargs;
+    uint8_t     types[ASYNCLOG_MAX_ARGS];
+    LogValue    args[ASYNCLOG_MAX_ARGS];
+};
+
+// --- Empaquetado de argumentos según su tipo C++ ---
+inline void log_set(LogEntry& e, uint8_t i, int v)                { e.types[i] = LOG_ARG_I32; e.args[i].i = v; }
+inline void log_set(LogEntry& e, uint8_t i, unsigned v)           { e.types[i] = LOG_ARG_U32; e.args[i].u = v; }
+inline void log_set(LogEntry& e, uint8_t i, long v)               { e.types[i] = sizeof(long) == 4 ? LOG_ARG_I32 : LOG_ARG_I64; e.args[i].i = v; }
+inline void log_set(LogEntry& e, uint8_t i, unsigned long v)      { e.types[i] = sizeof(long) == 4 ? LOG_ARG_U32 : LOG_ARG_U64; e.args[i].u = v; }
+inline void log_set(LogEntry& e, uint8_t i, long long v)          { e.types[i] = LOG_ARG_I64; e.args[i].i = v; }
+inline void log_set(LogEntry& e, uint8_t i, unsigned long long v) { e.types[i] = LOG_ARG_U64; e.args[i].u = v; }
+inline void log_set(LogEntry& e, uint8_t i, double v)             { e.types[i] = LOG_ARG_F64; e.args[i].d = v; }
+inline void log_set(LogEntry& e, uint8_t i, const char* v)        { e.types[i] = LOG_ARG_STR; e.args[i].p = v; }
+inline void log_set(LogEntry& e, uint8_t i, const void* v)        { e.types[i] = LOG_ARG_PTR; e.args[i].p = v; }
+// Promociones de printf: enteros cortos a int, float a double
+inline void log_set(LogEntry& e, uint8_t i, char v)               { log_set(e, i, (int)v); }
+inline void log_set(LogEntry& e, uint8_t i, signed char v)        { log_set(e, i, (int)v); }
+inline void log_set(LogEntry& e, uint8_t i, unsigned char v)      { log_set(e, i, (unsigned)v); }
+inline void log_set(LogEntry& e, uint8_t i, short v)              { log_set(e, i, (int)v); }
+inline void log_set(LogEntry& e, uint8_t i, unsigned short v)     { log_set(e, i, (unsigned)v); }
+inline void log_set(LogEntry& e, uint8_t i, bool v)               { log_set(e, i, (int)v); }
+inline void log_set(LogEntry& e, uint8_t i, float v)              { log_set(e, i, (double)v); }
+
+inline void log_pack(LogEntry&, uint8_t) {}
+template <typename T, typename... Rest>
+inline void log_pack(LogEntry& e, uint8_t i, T v, Rest... rest) {
+    log_set(e, i, v);
+    log_pack(e, i + 1, rest...);
+}
+
+// ============================================================================
+// Log de depuración diferido, sin bloqueo en el camino crítico.
+// - El productor (callback de radio, loop(), handlers) solo copia el puntero
+//   al formato y los argumentos a un anillo acotado multi-productor sin
+//   bloqueo (celdas con número de secuencia, esquema de Vyukov).
+// - Una tarea de baja prioridad formatea y escribe en Serial.
+// - Si el anillo está lleno el mensaje se descarta y se cuenta en overruns():
+//   nunca se espera al puerto serie.
+// - "%s" solo admite literales: el texto se lee recién al drenar.
+// ============================================================================
+class AsyncLog {
+public:
+    AsyncLog();
+    void begin();
+
+    void setLevel(LogLevel level) { _level.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return (LogLevel)_level.load(std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level <= _level.load(std::memory_order_relaxed); }
+    uint32_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+
+    template <typename... Args>
+    void log(LogLevel level, const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) <= ASYNCLOG_MAX_ARGS, "demasiados argumentos para AsyncLog");
+        LogEntry e;
+        e.fmt   = fmt;
+        e.level = level;
+        e.nargs = sizeof...(Args);
+        log_pack(e, 0, args...);
+        push(e);
+    }
+
+    // Formatea y escribe todo lo pendiente (la tarea lo llama en bucle)
+    size_t drain();
+
+    static const char* levelName(LogLevel level);
+    static bool parseLevel(const char* name, LogLevel& out);
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> seq;
+        LogEntry entry;
+    };
+
+    void push(LogEntry& e);
+    bool pop(LogEntry& out);
+    size_t format(const LogEntry& e, char* out, size_t len) const;
+    static void taskMain(void* arg);
+
+    Cell _cells[ASYNCLOG_RING_SIZE];
+    std::atomic<uint32_t> _enqueuePos;
+    uint32_t _dequeuePos;            // solo la tarea de drenado
+    std::atomic<uint8_t> _level;
+    std::atomic<uint32_t> _overruns;
+    uint32_t _reportedOverruns;
+};
+
+extern AsyncLog asyncLog;
+
+#define ASYNCLOG_AT(lvl, fmt, ...) \
+    do { if ((lvl) <= ASYNCLOG_MAX_LEVEL && asyncLog.enabled(lvl)) asyncLog.log((lvl), fmt, ##__VA_ARGS__); } while (0)
+
+#define LOG_E(fmt, ...) ASYNCLOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...) ASYNCLOG_AT(LOG_LEVEL_WARN,  fmt, ##__VA_ARGS__)
+#define LOG_I(fmt, ...) ASYNCLOG_AT(LOG_LEVEL_INFO,  fmt, ##__VA_ARGS__)
+#define LOG_D(fmt, ...) ASYNCLOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif // ASYNC_LOG_H
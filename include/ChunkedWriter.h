@@ -0,0 +1,55 @@
+#ifndef CHUNKED_WRITER_H
+#define CHUNKED_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHUNKED_PIECE_SIZE 256
+
+// ============================================================================
+// Base de los serializadores reanudables para respuestas chunked.
+// La subclase prepara un fragmento a la vez en _piece (nextPiece); fill() lo
+// copia en el buffer que entrega el servidor y, si no cabe, continúa en la
+// siguiente llamada. Memoria constante: un fragmento por respuesta en curso.
+// ============================================================================
+class ChunkedWriter {
+public:
+    ChunkedWriter() : _len(0), _off(0) {}
+    virtual ~ChunkedWriter() {}
+
+    // Copia hasta maxLen bytes en buf. Devuelve 0 cuando el documento terminó.
+    size_t fill(uint8_t* buf, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (_off >= _len) {
+                if (!nextPiece()) break;
+                continue;
+            }
+            size_t n = _len - _off;
+            if (n > maxLen - written) n = maxLen - written;
+            memcpy(buf + written, _piece + _off, n);
+            _off += n;
+            written += n;
+        }
+        return written;
+    }
+
+protected:
+    // Prepara en _piece/_len el siguiente fragmento; false al terminar
+    virtual bool nextPiece() = 0;
+
+    // Fija el fragmento a partir del resultado de snprintf sobre _piece
+    bool setPiece(int n) {
+        _off = 0;
+        if (n < 0) { _len = 0; return false; }
+        _len = ((size_t)n < sizeof(_piece)) ? (size_t)n : sizeof(_piece) - 1;
+        return true;
+    }
+
+    char   _piece[CHUNKED_PIECE_SIZE];
+    size_t _len;
+    size_t _off;
+};
+
+#endif // CHUNKED_WRITER_H
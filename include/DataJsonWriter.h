@@ -0,0 +1,111 @@
+#ifndef DATA_JSON_WRITER_H
+#define DATA_JSON_WRITER_H
+
+#include "PositioningManager.h"
+#include "TrailBuffer.h"
+#include "FixHistory.h"
+#include "ChunkedWriter.h"
+
+// ============================================================================
+// Serializador JSON reanudable para /data (respuesta chunked).
+// Genera un fragmento (una entrada) a la vez directamente desde las tablas
+// publicadas del manager. La memoria es constante: no depende de la cantidad
+// de anclas ni de tags. El cursor es el índice de casilla, que no
+// se mueve aunque el escritor publique altas entre llamadas.
+//
+// Con since > 0 solo se emiten las entradas cuya versión es posterior (delta).
+// "boot" identifica el arranque: las versiones de otro arranque no sirven.
+// "version" va al final: es la del manager al empezar, o since si alguna
+// casilla no se pudo leer y quedó fuera (el cliente la vuelve a pedir).
+//
+// Formato:
+//   {"boot":B,"since":S,"tag_position":{"x":..,"y":..,"z":..},
+//    "anchors":{"<saddr hex>":{...último reporte..., "online", "rate_hz",
+//               "participation", "range_mean", "range_std", "rssi", ...},...},
+//    "tags":{"<tag_uid hex>":{...fix..., "telemetry":{"seq","age_ms","ts",
+//             "temp","hum","aSQ","mDir","etiqueta"}},...},"version":N}
+// "telemetry" es el último bloque de timestamp+sensores del tag (falta si
+// todavía no llegó ninguno); su seq puede diferir de la del fix.
+// ============================================================================
+class DataJsonWriter : public ChunkedWriter {
+public:
+    DataJsonWriter(const PositioningManager& manager, uint32_t since = 0, uint32_t boot = 0);
+
+protected:
+    bool nextPiece() override;
+
+private:
+    enum Phase : uint8_t { PH_HEAD, PH_ANCHORS, PH_ANCHOR_STATS, PH_TAGS_OPEN, PH_TAGS, PH_TAG_TELEMETRY, PH_TAIL, PH_DONE };
+
+    const PositioningManager& _manager;
+    uint32_t _since;
+    uint32_t _boot;
+    uint32_t _version;    // del manager al empezar (se emite al final)
+    bool     _skipped;    // alguna casilla no se pudo leer: se devuelve since
+    Phase    _phase;
+    bool     _first;      // primera entrada del objeto actual (sin coma)
+    uint32_t _nextKey;    // próxima casilla a emitir en la fase actual
+    AnchorEntry _anchor;  // ancla en curso (su salud va en un segundo fragmento)
+    TagTelemetryEntry _telemetry; // telemetría del tag en curso (segundo fragmento)
+    uint32_t _now;        // millis() al empezar, para la antigüedad de las anclas
+};
+
+// ============================================================================
+// Serializador JSON reanudable para /trails: estela reciente de cada tag en
+// centímetros, del punto más antiguo al más reciente.
+//   {"length":TRAIL_LENGTH,"tags":{"<tag_uid hex>":[[x,y,z],...],...}}
+// ============================================================================
+class TrailJsonWriter : public ChunkedWriter {
+public:
+    explicit TrailJsonWriter(const TrailBuffer& trails);
+
+protected:
+    bool nextPiece() override;
+
+private:
+    enum Phase : uint8_t { PH_HEAD, PH_TAG, PH_POINTS, PH_TAIL, PH_DONE };
+
+    const TrailBuffer& _trails;
+    Phase    _phase;
+    bool     _first;      // primer tag del objeto (sin coma)
+    size_t   _index;      // casilla de tag en curso
+    uint8_t  _point;      // punto en curso dentro de la estela copiada
+    TagTrail _trail;      // copia consistente de la estela en curso
+};
+
+// ============================================================================
+// Serializador JSON reanudable para /history: fixes archivados de un tag con
+// from_ms <= t_ms <= to_ms, del más antiguo al más reciente. Recorre el anillo
+// de FixHistory registro a registro (nada se acumula en RAM) hasta el último
+// fix existente al iniciar la consulta. "lost" cuenta los fixes que el
+// escritor descartó mientras la respuesta se enviaba.
+//   {"tag":"<hex>","from":..,"to":..,"resolution_ms":..,
+//    "fixes":[[t_ms,x_cm,y_cm,z_cm,rms_cm,anchors,is3D],...],"lost":N}
+// ============================================================================
+class HistoryJsonWriter : public ChunkedWriter {
+public:
+    HistoryJsonWriter(const FixHistory& history, uint32_t tag_uid, uint32_t from_ms, uint32_t to_ms);
+
+protected:
+    bool nextPiece() override;
+
+private:
+    enum Phase : uint8_t { PH_HEAD, PH_FIXES, PH_TAIL, PH_DONE };
+
+    bool resync();
+
+    const FixHistory& _history;
+    uint32_t _tag;
+    uint32_t _from;
+    uint32_t _to;
+    Phase    _phase;
+    bool     _first;      // primer fix del arreglo (sin coma)
+    int      _slot;       // casilla del tag (-1 si no tiene historial)
+    uint32_t _index;      // próximo registro a leer
+    uint32_t _end;        // "next" al iniciar la consulta
+    uint32_t _q;          // tiempo del registro anterior
+    bool     _atBase;     // el próximo registro es "first": su tiempo es base_q
+    uint32_t _lost;
+};
+
+#endif // DATA_JSON_WRITER_H
@@ -6,7 +6,10 @@
 #include <Arduino.h>    // para Serial y tipos Arduino
 
 // --- CONTROL DE DEPURACIÓN SERIAL ---
-#define DEBUG_ENABLED
+// DEBUG_ENABLED se define en build_flags de los entornos de depuración.
+// Estas macros escriben en Serial de forma bloqueante: solo para setup() y
+// mensajes fuera del camino crítico. En el callback de radio y el cálculo
+// de posiciones se usa el log diferido (LOG_D/LOG_W de AsyncLog.h).
 #ifdef DEBUG_ENABLED
   #define DEBUG_PRINT(x)        Serial.print(x)
   #define DEBUG_PRINTLN(x)      Serial.println(x)
@@ -112,6 +115,12 @@ typedef struct DecodedAnchorReport_t {
     float gX, gY, gZ;
     float mX, mY, mZ, mDir;
     char  etiqueta[4];  // se mantiene fijo en 4 chars + '\0'
+    bool  has_telemetry; // trae timestamp+sensores (v1, RANGE_FULL); un RANGE v2 no
+
+    // Metadatos de recepción (los completa el CONCENTRADOR, no viajan por aire)
+    uint32_t rx_ms;     // millis() del concentrador al recibir el reporte
+    uint32_t meas_ms;   // t_ms llevado a millis() del concentrador (TimeBase; rx_ms si no hay t_ms)
+    int8_t   rx_rssi;   // RSSI del frame ESP-NOW en dBm (0 = no disponible)
 } DecodedAnchorReport_t;
 
 // ============================================================================
@@ -158,6 +167,7 @@ inline DecodedAnchorReport_t unpack_anchor_report(const AnchorRangeReport_t& p)
 
     strncpy(d.etiqueta, p.etiqueta, sizeof(d.etiqueta));
     d.etiqueta[sizeof(d.etiqueta)-1] = '\0';
+    d.has_telemetry = true;
 
     return d;
 }
@@ -0,0 +1,73 @@
+#ifndef FIX_HISTORY_H
+#define FIX_HISTORY_H
+
+#include "PositioningManager.h"
+
+// --- CONFIGURACIÓN DEL HISTORIAL (redefinibles con -D en build_flags) ---
+#ifndef HISTORY_TAGS
+#define HISTORY_TAGS        8     // tags con historial simultáneo (LRU al llenarse)
+#endif
+#ifndef HISTORY_DEPTH
+#define HISTORY_DEPTH     256     // fixes retenidos por tag
+#endif
+#ifndef HISTORY_TIME_RES_MS
+#define HISTORY_TIME_RES_MS 10    // resolución de las marcas de tiempo
+#endif
+
+// Fix archivado: 10 bytes. Coordenadas en centímetros (±327 m) y tiempo como
+// delta respecto del fix anterior del mismo tag, en unidades de
+// HISTORY_TIME_RES_MS (hasta ~655 s con 10 ms).
+#pragma pack(push, 1)
+typedef struct HistoryRecord_t {
+    int16_t  x_cm, y_cm, z_cm;
+    uint16_t dt;          // 0 en el primer fix retenido
+    uint8_t  rms_cm;      // saturado a 255
+    uint8_t  info;        // bits 0-6: anclas usadas; bit 7: solución 3D
+} HistoryRecord_t;
+#pragma pack(pop)
+
+#define HISTORY_INFO_3D 0x80
+
+// Estado publicado de un tag. Los índices son absolutos y monótonos por
+// casilla (no se reinician al reciclarla): el registro "i" vive en
+// ring[i % HISTORY_DEPTH] mientras first <= i < next.
+struct HistoryHeader {
+    uint32_t tag_uid;
+    uint32_t first;       // índice del fix más antiguo retenido
+    uint32_t next;        // índice que recibirá el próximo fix
+    uint32_t base_q;      // tiempo del fix "first" (unidades de HISTORY_TIME_RES_MS)
+    uint32_t last_q;      // tiempo del fix "next - 1"
+};
+
+// ============================================================================
+// Historial circular de fixes por tag, de memoria fija.
+// - Memoria: HISTORY_TAGS * (HISTORY_DEPTH * 10 + ~48) bytes; con los valores
+//   por defecto, 8 * 256 fixes ≈ 21 KB (25 s por tag a 10 Hz).
+// - Se alimenta como FixListener (tarea Wi-Fi o loop(), de a uno con el lock
+//   del manager). Los lectores recorren el anillo sin copiarlo: readRecord()
+//   detecta si el registro fue sobrescrito durante la lectura comparando con
+//   el contador _head, al estilo de un seqlock.
+// - Un hueco sin fixes mayor que el delta máximo se acorta: los tiempos más
+//   recientes siguen exactos y los previos al hueco quedan adelantados.
+// ============================================================================
+class FixHistory {
+public:
+    FixHistory();
+    void attach(PositioningManager& manager);
+    void addFix(const TagFix& fix);
+
+    size_t count() const;
+    bool readHeader(size_t slot, HistoryHeader& out) const;
+    int  findTag(uint32_t tag_uid, HistoryHeader& out) const;   // casilla o -1
+    bool readRecord(size_t slot, uint32_t index, HistoryRecord_t& out) const;
+
+private:
+    HistoryRecord_t             _ring[HISTORY_TAGS][HISTORY_DEPTH];
+    SeqlockSlot<HistoryHeader>  _headers[HISTORY_TAGS];
+    HistoryHeader               _work[HISTORY_TAGS];   // copia del escritor
+    uint32_t                    _lastMs[HISTORY_TAGS]; // para reciclar la casilla
+    std::atomic<uint32_t>       _head[HISTORY_TAGS];   // registros iniciados
+    std::atomic<uint8_t>        _count;
+};
+
+#endif // FIX_HISTORY_H
@@ -0,0 +1,132 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include "PositioningManager.h"
+
+// --- CONFIGURACIÓN DEL LOG EN FLASH (redefinibles con -D en build_flags) ---
+#ifndef FLASHLOG_DIR
+#define FLASHLOG_DIR           "/log"
+#endif
+#ifndef FLASHLOG_BLOCK_SIZE
+#define FLASHLOG_BLOCK_SIZE    4096           // bytes por escritura (un bloque de LittleFS)
+#endif
+#ifndef FLASHLOG_SEGMENT_SIZE
+#define FLASHLOG_SEGMENT_SIZE  (64 * 1024)    // tamaño de cada archivo de segmento
+#endif
+#ifndef FLASHLOG_MAX_SEGMENTS
+#define FLASHLOG_MAX_SEGMENTS  16             // se borra el más antiguo al superarlo
+#endif
+#ifndef FLASHLOG_FLUSH_MS
+#define FLASHLOG_FLUSH_MS      10000          // un bloque a medio llenar se escribe tras este tiempo
+#endif
+#ifndef FLASHLOG_RAW_REPORTS
+#define FLASHLOG_RAW_REPORTS   0              // registrar también los reportes crudos (valor inicial)
+#endif
+
+#define FLASHLOG_MAGIC    0x31474C46UL   // "FLG1" en little-endian
+#define FLASHLOG_VERSION  1
+
+enum LogRecordType : uint8_t {
+    LOG_REC_FIX    = 1,
+    LOG_REC_REPORT = 2
+};
+
+// ============================================================================
+// Formato en flash (little-endian):
+//   segmento = LogSegmentHeader_t + registros
+//   registro = tipo (1 B) + largo del contenido (1 B) + contenido
+// Un lector desconoce un tipo nuevo sin perder la sincronía: salta "len" bytes.
+// ============================================================================
+#pragma pack(push, 1)
+typedef struct LogSegmentHeader_t {
+    uint32_t magic;          // FLASHLOG_MAGIC
+    uint16_t version;        // FLASHLOG_VERSION
+    uint16_t header_len;     // sizeof(LogSegmentHeader_t)
+    uint32_t segment;        // número de segmento (monótono)
+    uint32_t created_ms;     // millis() del concentrador al abrirlo
+    uint32_t block_size;     // FLASHLOG_BLOCK_SIZE
+    uint32_t crc32;          // CRC-32 de los campos anteriores
+} LogSegmentHeader_t;        // 24 bytes
+
+typedef struct LogFixRecord_t {
+    uint32_t t_ms;
+    uint32_t tag_uid;
+    uint16_t seq;
+    int32_t  x_mm, y_mm, z_mm;
+    uint16_t rms_mm;
+    uint8_t  anchors;
+    uint8_t  flags;          // bit 0: solución 3D
+} LogFixRecord_t;            // 26 bytes (+2 de cabecera)
+
+typedef struct LogReportRecord_t {
+    uint32_t            rx_ms;
+    AnchorRangeReport_t report;   // tal como llegó por ESP-NOW
+} LogReportRecord_t;
+#pragma pack(pop)
+
+// ============================================================================
+// Log persistente de fixes (y opcionalmente reportes crudos) en LittleFS.
+// - Los registros se agregan a un buffer de RAM de FLASHLOG_BLOCK_SIZE desde
+//   la tarea Wi-Fi (sección crítica corta, sin tocar la flash).
+// - Al llenarse, el buffer se sella y se cambia al segundo; loop() escribe
+//   el sellado en un solo write() por bloque. Si ambos están ocupados el
+//   registro se descarta y se cuenta en "dropped": la flash nunca frena
+//   el cálculo de posiciones.
+// - Segmentos /log/<n>.bin de hasta FLASHLOG_SEGMENT_SIZE; la cabecera se
+//   escribe y confirma al crear el archivo. LittleFS es copy-on-write: tras
+//   un corte de energía el segmento vuelve al último bloque confirmado, así
+//   que nunca queda un registro a medias.
+// ============================================================================
+class FlashLog {
+public:
+    FlashLog();
+    bool begin(PositioningManager& manager);
+    void loop();
+    void serve(AsyncWebServer& server);
+
+    void logFix(const TagFix& fix);
+    void logReport(const AnchorRangeReport_t& report, uint32_t rx_ms);
+    // Para no armar el reporte v1 de un registro v2 si no se va a guardar
+    bool logsReports() const { return _logReports; }
+
+    // Contadores para /metrics
+    bool     ready() const { return _ready; }
+    uint32_t bytesWritten() const { return _bytesWritten; }
+    uint32_t dropped() const { return _dropped; }
+    uint32_t writeErrors() const { return _writeErrors; }
+    uint32_t maxWriteUs() const { return _maxWriteUs; }
+    uint32_t stagedHighWater() const { return _stagedHighWater; }
+
+private:
+    void append(LogRecordType type, const void* payload, uint8_t len);
+    bool sealActive();
+    void writeBlock(const uint8_t* data, size_t len);
+    bool openSegment();
+    void pruneSegments();
+    String segmentPath(uint32_t segment) const;
+
+    uint8_t  _buf[2][FLASHLOG_BLOCK_SIZE];
+    size_t   _len[2];
+    bool     _sealed[2];      // listo para escribir (lo libera loop())
+    uint8_t  _active;         // buffer que recibe registros
+    uint32_t _blockStartMs;   // primer registro del buffer activo
+    portMUX_TYPE _lock;
+
+    bool     _ready;
+    bool     _logReports;
+    File     _file;
+    uint32_t _segmentSize;
+    uint32_t _firstSegment;   // segmento más antiguo en flash
+    uint32_t _nextSegment;    // número del próximo segmento a crear
+
+    uint32_t _bytesWritten;
+    uint32_t _blocksWritten;
+    uint32_t _dropped;
+    uint32_t _writeErrors;
+    uint32_t _maxWriteUs;     // peor escritura de un bloque
+    uint32_t _stagedHighWater; // máximo de bytes en RAM a la espera de la flash
+};
+
+#endif // FLASH_LOG_H
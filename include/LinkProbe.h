@@ -0,0 +1,121 @@
+#ifndef LINK_PROBE_H
+#define LINK_PROBE_H
+
+#include <atomic>
+#include <WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include "UpstreamPublisher.h"
+
+enum LinkLevel : uint8_t {
+    LINK_UNKNOWN = 0,        // sin ecos todavía
+    LINK_GOOD    = 1,
+    LINK_FAIR    = 2,
+    LINK_POOR    = 3,
+    LINK_DOWN    = 4         // LINKPROBE_DOWN_MISSES ecos perdidos seguidos
+};
+
+// --- CONFIGURACIÓN DEL SONDEO (redefinibles con -D en build_flags) ---
+#ifndef LINKPROBE_INTERVAL_MS
+#define LINKPROBE_INTERVAL_MS  1000           // un eco ICMP por intervalo
+#endif
+#ifndef LINKPROBE_ADAPT
+#define LINKPROBE_ADAPT        1              // ajustar el batching del publicador (valor inicial)
+#endif
+#define LINKPROBE_TASK_STACK   3072
+#define LINKPROBE_TASK_PRIO    1              // como AsyncLog: la de loopTask (se turnan por tick), muy por debajo de la tarea Wi-Fi
+#define LINKPROBE_WINDOW       20             // ecos por ventana del histograma de pérdida
+#define LINKPROBE_HOLD         3              // ecos seguidos que piden otro nivel antes de cambiarlo
+#define LINKPROBE_DOWN_MISSES  5
+#define LINKPROBE_HIST_MAX     12             // límites finitos por histograma como mucho
+
+// Niveles por RTT y pérdida medios (exponenciales, ANCHOR_EMA_ALPHA)
+#define LINK_GOOD_RTT_MS       20
+#define LINK_GOOD_LOSS         0.02f
+#define LINK_POOR_RTT_MS       150
+#define LINK_POOR_LOSS         0.10f
+
+// Histograma con límites fijos "le"; buckets[n] es +Inf. No acumulado.
+struct LinkHistogram {
+    const float* le;
+    uint8_t  n;
+    uint32_t buckets[LINKPROBE_HIST_MAX + 1];
+    double   sum;
+    uint32_t count;
+
+    void add(float v) {
+        uint8_t i = 0;
+        while (i < n && v > le[i]) i++;
+        buckets[i]++;
+        sum += v;
+        count++;
+    }
+};
+
+// ============================================================================
+// Sondeo del enlace hacia el colector del UpstreamPublisher con ICMP
+// (lib/ESP32Ping). Ping.ping() bloquea hasta la respuesta o 1 s por eco:
+// corre en una tarea propia de baja prioridad y nunca en loop() ni en la
+// tarea Wi-Fi. ESP32Ping guarda estado global: esta tarea es su único
+// usuario.
+// - Un eco por LINKPROBE_INTERVAL_MS, solo con la STA conectada y el
+//   publicador activo. Histogramas de RTT (ms) y de pérdida por ventana
+//   de LINKPROBE_WINDOW ecos, más RTT y pérdida medios.
+// - Nivel del enlace: bueno, regular, malo o caído. Cambia cuando
+//   LINKPROBE_HOLD ecos seguidos piden el mismo nivel nuevo.
+// - Con adapt, cada cambio de nivel ajusta batch y flush del publicador:
+//   enlace bueno -> batches chicos y poca latencia; malo o caído -> batches
+//   llenos y flush largo (menos paquetes que compitan por el aire y menos
+//   bytes de cabecera por fix).
+// ============================================================================
+class LinkProbe {
+public:
+    LinkProbe();
+    void begin(UpstreamPublisher& publisher);
+    void serve(AsyncWebServer& server);
+
+    // Lo mismo que /link?enable, ?adapt e ?interval_ms
+    void setEnabled(bool on);
+    void setAdapt(bool on);
+    void setIntervalMs(uint32_t ms);
+
+    static const char* levelName(LinkLevel level);
+
+    // Para /metrics (las escribe la tarea del sondeo)
+    LinkLevel level() const { return _level; }
+    uint32_t probesOk() const { return _ok; }
+    uint32_t probesLost() const { return _lost; }
+    uint32_t levelChanges() const { return _changes; }
+    float    rttMs() const { return _rttMs; }
+    float    lossRatio() const { return _loss; }
+    const LinkHistogram& rttHistogram() const { return _rttHist; }
+    const LinkHistogram& lossHistogram() const { return _lossHist; }
+
+    // Un eco (tarea del sondeo); público para el banco en host
+    void probe(const IPAddress& host);
+
+private:
+    static void taskMain(void* arg);
+    void adapt(LinkLevel suggested);
+
+    UpstreamPublisher* _publisher;
+    portMUX_TYPE _lock;
+    std::atomic<bool>     _enabled;
+    std::atomic<bool>     _adapt;
+    std::atomic<uint32_t> _intervalMs;
+
+    LinkLevel _level;
+    LinkLevel _candidate;     // nivel pedido por los últimos ecos...
+    uint8_t   _hold;          // ...en tantos seguidos
+    uint8_t   _misses;        // ecos perdidos seguidos
+    uint8_t   _windowSent;
+    uint8_t   _windowLost;
+    float     _rttMs;
+    float     _loss;
+    uint32_t  _ok;
+    uint32_t  _lost;
+    uint32_t  _changes;
+    LinkHistogram _rttHist;
+    LinkHistogram _lossHist;
+};
+
+#endif // LINK_PROBE_H
@@ -0,0 +1,84 @@
+#ifndef METRICS_WRITER_H
+#define METRICS_WRITER_H
+
+#include "ChunkedWriter.h"
+#include "PerfProbe.h"
+#include "PositioningManager.h"
+
+class PositionStream;
+class FlashLog;
+class AnchorRegistry;
+class RawForwarder;
+class UpstreamPublisher;
+class LinkProbe;
+
+// ============================================================================
+// Serializador reanudable de /metrics en formato de texto de Prometheus.
+// Emite una métrica por fragmento directamente desde los contadores, sin
+// construir el documento en RAM.
+//
+// Contadores y medidores (concentrator_*): reportes recibidos, descartados
+// y de tamaño incorrecto; secuencias completadas y expiradas; resultados del
+// solver; frames filtrados por el registro de anclas; reenvío crudo;
+// publicación al colector (descartes, latencia, fixes por batch, eficiencia);
+// sondeo del enlace (ecos, RTT y pérdida medios, nivel);
+// latencia medición -> fix; heap libre y mínimo; marcas de agua de las colas; por ancla,
+// reportes recibidos, rango medio y las medias móviles de AnchorStats
+// (tasa, participación, desvío del rango, ruido, CIR, RSSI, latencia,
+// offset y deriva del reloj, caída).
+//
+// Histogramas del enlace (con LinkProbe): concentrator_link_rtt_ms y
+// concentrator_link_window_loss_ratio, con límites fijos.
+//
+// Histogramas por etapa (si PERF_PROBES):
+//   concentrator_stage_seconds_bucket{stage="solve",le="..."} N
+//   concentrator_stage_seconds_sum / _count, concentrator_stage_max_seconds
+// Los límites "le" son las potencias de dos de ticks entre 2^PERF_LE_MIN_BITS
+// y la del máximo observado; dentro de cada potencia el histograma del
+// dispositivo es más fino, pero el scrape solo publica los cortes exactos.
+// ============================================================================
+#define PERF_LE_MIN_BITS 8
+
+class MetricsWriter : public ChunkedWriter {
+public:
+    MetricsWriter(const PositioningManager& manager, const PositionStream* stream, const FlashLog* log,
+                  const AnchorRegistry* registry = nullptr, const RawForwarder* forwarder = nullptr,
+                  const UpstreamPublisher* upstream = nullptr, const LinkProbe* link = nullptr);
+
+protected:
+    bool nextPiece() override;
+
+private:
+    enum Phase : uint8_t { PH_SCALARS, PH_ANCHORS, PH_LINK, PH_PERF_HEAD, PH_PERF_BUCKET, PH_PERF_INF, PH_PERF_SUM, PH_PERF_MAX, PH_DONE };
+
+    // Una muestra: name{label} value. "help" solo en la primera de la familia.
+    struct Sample {
+        const char* name;
+        const char* type;
+        const char* help;
+        const char* label;
+        double      value;
+    };
+    bool scalarAt(uint8_t item, Sample& out) const;
+    int  printSample(const Sample& s);
+    void startStage(uint8_t stage);
+
+    const PositioningManager& _manager;
+    const PositionStream* _stream;
+    const FlashLog* _log;
+    const AnchorRegistry* _registry;
+    const RawForwarder* _forwarder;
+    const UpstreamPublisher* _upstream;
+    const LinkProbe* _link;
+    Phase    _phase;
+    uint8_t  _item;       // muestra escalar o familia por ancla en curso
+    uint32_t _nextKey;    // casilla de ancla en curso
+    bool     _familyOpen; // la familia por ancla en curso ya emitió help/type
+    uint8_t  _stage;      // etapa (o histograma del enlace) en curso
+    uint8_t  _bit;        // próximo límite le = 2^_bit ticks
+    uint8_t  _bucket;     // próximo bucket a acumular
+    uint32_t _cum;        // cuenta acumulada de la etapa
+    uint32_t _hz;         // ticks por segundo
+};
+
+#endif // METRICS_WRITER_H
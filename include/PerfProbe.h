@@ -0,0 +1,112 @@
+#ifndef PERF_PROBE_H
+#define PERF_PROBE_H
+
+#include <stdint.h>
+
+// --- INSTRUMENTACIÓN DEL PIPELINE ---
+// PERF_PROBES=0 (build_flags del entorno release) elimina por completo las
+// sondas: PERF_SCOPE no genera código y /metrics omite los histogramas.
+#ifndef PERF_PROBES
+#define PERF_PROBES 1
+#endif
+
+// Etapas entre OnDataRecv y el fix publicado. Se miden inclusivas:
+// receive contiene a las demás y solve contiene a filter.
+enum PerfStage : uint8_t {
+    PERF_RECEIVE = 0,   // OnDataRecv completo
+    PERF_DECODE,        // unpack_anchor_report
+    PERF_CORRELATE,     // casilla del ancla + agrupación por (tag, seq)
+    PERF_SOLVE,         // trilateración
+    PERF_FILTER,        // residuo RMS y validación del resultado
+    PERF_PUBLISH,       // tablas publicadas + FixListeners
+    PERF_STAGE_COUNT
+};
+
+#if PERF_PROBES
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_cpu.h>
+static inline uint32_t perf_ticks() { return esp_cpu_get_cycle_count(); }
+#else
+#include <xtensa/core-macros.h>
+static inline uint32_t perf_ticks() { return XTHAL_GET_CCOUNT(); }
+#endif
+// Ciclos de CPU; todas las etapas corren en la tarea Wi-Fi (un solo núcleo),
+// así que el contador por núcleo es coherente dentro de cada medición
+static inline uint32_t perf_ticks_per_sec() { return getCpuFrequencyMhz() * 1000000UL; }
+#else
+#include <chrono>
+// Host (simulador): reloj monótono en nanosegundos
+static inline uint32_t perf_ticks() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline uint32_t perf_ticks_per_sec() { return 1000000000UL; }
+#endif
+
+// ============================================================================
+// Histograma log-lineal de ticks, sin asignaciones: 4 sub-buckets lineales
+// por potencia de dos (error relativo <= 25%) cubren todo el rango de 32 bits
+// en PERF_BUCKETS contadores. Un solo escritor (la tarea Wi-Fi); los lectores
+// toleran que un scrape vea contadores de mediciones distintas.
+// ============================================================================
+#define PERF_SUB_BITS 2
+#define PERF_SUB      (1u << PERF_SUB_BITS)
+#define PERF_BUCKETS  ((32 - PERF_SUB_BITS + 1) * PERF_SUB)   // 124
+
+struct PerfHistogram {
+    uint32_t buckets[PERF_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint32_t max;
+
+    static uint8_t bucketOf(uint32_t v) {
+        if (v < PERF_SUB) return (uint8_t)v;
+        const uint8_t msb = 31 - __builtin_clz(v);
+        const uint8_t sub = (v >> (msb - PERF_SUB_BITS)) & (PERF_SUB - 1);
+        return (uint8_t)((msb - PERF_SUB_BITS + 1) * PERF_SUB + sub);
+    }
+
+    // Límite inferior (inclusivo) del bucket
+    static uint64_t bucketLow(uint8_t b) {
+        if (b < PERF_SUB) return b;
+        const uint8_t msb = b / PERF_SUB + PERF_SUB_BITS - 1;
+        return (uint64_t)(PERF_SUB + b % PERF_SUB) << (msb - PERF_SUB_BITS);
+    }
+
+    void record(uint32_t ticks) {
+        buckets[bucketOf(ticks)]++;
+        count++;
+        sum += ticks;
+        if (ticks > max) max = ticks;
+    }
+};
+
+extern PerfHistogram g_perf[PERF_STAGE_COUNT];
+extern const char* const PERF_STAGE_NAMES[PERF_STAGE_COUNT];
+
+// Mide el bloque que la contiene y lo registra al salir
+class PerfScope {
+public:
+    explicit PerfScope(PerfStage stage) : _stage(stage), _t0(perf_ticks()) {}
+    ~PerfScope() { g_perf[_stage].record(perf_ticks() - _t0); }
+
+private:
+    PerfStage _stage;
+    uint32_t  _t0;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b)  PERF_CONCAT_(a, b)
+#define PERF_SCOPE(stage)  PerfScope PERF_CONCAT(_perfScope, __LINE__)(stage)
+
+#else
+
+#define PERF_SCOPE(stage)
+
+#endif // PERF_PROBES
+
+#endif // PERF_PROBE_H
@@ -3,15 +3,30 @@
 
 #include <ESPAsyncWebServer.h>
 #include "PositioningManager.h"
+#include "PositionStream.h"
+#include "TrailBuffer.h"
+#include "FixHistory.h"
+#include "FlashLog.h"
+#include "AnchorRegistry.h"
+#include "RawForwarder.h"
+#include "UpstreamPublisher.h"
+#include "LinkProbe.h"
 
 class PortalWeb {
 public:
     PortalWeb(const char* ssid, const char* password);
-    void begin(String mac, PositioningManager& manager);
+    void begin(String mac, PositioningManager& manager, FlashLog* log = nullptr, AnchorRegistry* registry = nullptr,
+               RawForwarder* forwarder = nullptr, UpstreamPublisher* upstream = nullptr,
+               LinkProbe* link = nullptr);
+    void loop();
 
 private:
     AsyncWebServer _server;
+    PositionStream _stream;
+    TrailBuffer _trails;
+    FixHistory _history;
     PositioningManager* _manager;
+    uint32_t _bootId;         // al azar en cada arranque: valida el ?since= de /data
     const char* _ssid;
     const char* _password;
 };
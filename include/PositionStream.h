@@ -0,0 +1,73 @@
+#ifndef POSITION_STREAM_H
+#define POSITION_STREAM_H
+
+#include <atomic>
+#include <ESPAsyncWebServer.h>
+#include <AsyncEventSource.h>
+#include <AsyncWebSocket.h>
+#include "PositioningManager.h"
+#include "StreamCodec.h"
+
+// --- CONFIGURACIÓN DEL STREAM SSE ---
+#define STREAM_RING_SIZE          32    // eventos recientes retenidos (reanudación con Last-Event-ID)
+#define STREAM_COALESCE_MARGIN     4    // holgura bajo SSE_MAX_QUEUED_MESSAGES antes de coalescer
+#define STREAM_RECONNECT_MS     2000    // "retry:" sugerido a los clientes
+#define ANCHOR_HEALTH_PERIOD_MS 5000    // latido periódico del estado de anclas
+#define STREAM_BENCH_ITERATIONS 1000    // iteraciones por formato en /stream/bench
+#define STREAM_BENCH_MAX        2000    // tope de ?n=: corre en la tarea async_tcp, que atiende todo el servidor
+
+// Cliente WebSocket suscrito y la codificación que eligió (id 0 = casilla libre)
+struct WsSubscriber {
+    uint32_t     id = 0;
+    StreamFormat fmt = FORMAT_JSON;
+};
+
+// ============================================================================
+// Stream de posiciones por tag y salud de anclas.
+// - /events: Server-Sent Events (JSON), reanudable con Last-Event-ID.
+// - /ws?fmt=json|msgpack|struct: WebSocket; el cliente elige la codificación
+//   al suscribirse (o luego, enviando el texto "fmt=<nombre>").
+// - Los fixes se encolan en un anillo fijo desde la tarea Wi-Fi (sin bloquear).
+// - loop() difunde los eventos pendientes; si los clientes acumulan cola cerca
+//   de SSE_MAX_QUEUED_MESSAGES solo se envía el último fix de cada tag.
+// ============================================================================
+class PositionStream {
+public:
+    PositionStream(const char* url = "/events", const char* wsUrl = "/ws");
+    void begin(AsyncWebServer& server, PositioningManager& manager);
+    void loop();
+    void publishFix(const TagFix& fix);
+    void benchmark(Print& out, uint32_t iterations);
+
+    // Contadores para /metrics
+    uint32_t coalesced() const { return _coalesced; }
+    uint32_t overrun() const { return _overrun; }
+    uint32_t pendingHighWater() const { return _pendingHighWater; }
+
+private:
+    void push(StreamEvent& ev);
+    bool eventAt(uint32_t id, StreamEvent& out);
+    void sendEvent(AsyncEventSourceClient* client, const StreamEvent& ev);
+    void sendWs(const StreamEvent& ev, const WsSubscriber* subs, size_t nSubs);
+    void replay(AsyncEventSourceClient* client);
+    void onWsEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void setWsFormat(uint32_t id, StreamFormat fmt);
+    void removeWs(uint32_t id);
+    void checkAnchors();
+
+    AsyncEventSource _events;
+    AsyncWebSocket _ws;
+    WsSubscriber _wsSubs[DEFAULT_MAX_WS_CLIENTS];
+    PositioningManager* _manager;
+    StreamEvent _ring[STREAM_RING_SIZE];
+    uint32_t _nextId;       // id que recibirá el próximo evento
+    std::atomic<uint32_t> _sentId;  // último id difundido (lo lee replay() en la tarea async_tcp)
+    uint32_t _coalesced;    // fixes omitidos por coalescencia
+    uint32_t _overrun;      // eventos sobrescritos antes de difundirse
+    uint32_t _pendingHighWater; // máximo de eventos pendientes en un loop()
+    uint32_t _lastHealthMs;
+    std::map<uint16_t, bool> _anchorOnline;
+    portMUX_TYPE _lock;
+};
+
+#endif // POSITION_STREAM_H
@@ -1,29 +1,365 @@
 #ifndef POSITIONING_MANAGER_H
 #define POSITIONING_MANAGER_H
 
+#include <math.h>
 #include <map>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
 #include "DataUtils.h"
+#include "AnchorFrame.h"
+#include "Seqlock.h"
+
+// Capacidad de las tablas publicadas (memoria fija, sin realocación)
+#define MAX_ANCHORS 32
+#ifndef MAX_TAGS
+#define MAX_TAGS    32               // redefinible (tools/solver usa más); a lo sumo 255
+#endif
+#if MAX_TAGS > 255
+#error "MAX_TAGS > 255: las casillas de tag se indexan con uint8_t"
+#endif
+
+#include "TimeBase.h"   // dimensionada con las capacidades de arriba
+
+// Secuencias (tag, seq) a la espera de completar anclas
+#ifndef MAX_PENDING_SEQUENCES
+#define MAX_PENDING_SEQUENCES 64     // más allá se descartan los reportes de secuencias nuevas
+#endif
+#ifndef MAX_LINGER_SEQUENCES
+#define MAX_LINGER_SEQUENCES  MAX_PENDING_SEQUENCES  // resueltas esperando tardíos (cupo propio)
+#endif
+#define SEQUENCE_TIMEOUT_MS   500    // una secuencia incompleta expira tras este tiempo
+#define SEQUENCE_SWEEP_MS      50    // periodo mínimo entre barridos de expiración
+
+// Salud de anclas (medias móviles exponenciales, memoria fija por ancla)
+#define ANCHOR_EMA_ALPHA      0.1f   // peso de la muestra nueva (~10 muestras de memoria)
+#define ANCHOR_STALE_PERIODS  5      // caída si calla más de N intervalos medios...
+#define ANCHOR_STALE_MIN_MS   1000   // ...pero nunca antes de este tiempo
+#define ANCHOR_STALE_MS       3000   // ...ni después de este otro
+#define ANCHORS_MIN_SOLVE     3      // mínimo absoluto de anclas (solución 2D)
+
+// Política de cierre de secuencias (redefinibles con -D en build_flags)
+#ifndef POLICY_DEFAULT_MODE
+#define POLICY_DEFAULT_MODE     POLICY_ACCURACY_FIRST
+#endif
+#ifndef POLICY_WAIT_MS
+#define POLICY_WAIT_MS          30   // espera máxima por anclas esperadas tras alcanzar el mínimo
+#endif
+#define POLICY_LINGER_MS       100   // una secuencia resuelta sigue registrando reportes tardíos
+#define POLICY_LEARN_SHIFT       3   // media exponencial 1/8 de "el ancla oye al tag"
+#define POLICY_EXPECT_THRESHOLD 128  // puntaje (0..255) desde el que un ancla se espera
+#define POLICY_MAX_PROFILES    MAX_TAGS
+
+// Filtro de duplicados (retransmisiones ESP-NOW, frames repetidos)
+#define DEDUP_WINDOW          32     // seqs recordadas por (ancla, tag): bits de SeqWindow
+
+// Orden de secuencias por tag (aritmética de números de serie sobre seq)
+#ifndef SEQ_REORDER_WINDOW
+#define SEQ_REORDER_WINDOW    16     // un reporte puede llegar hasta N seqs detrás del más nuevo del tag
+#endif
+#ifndef SEQ_RESTART_MS
+#define SEQ_RESTART_MS      2000     // tag callado este tiempo: su seq puede haber reiniciado
+#endif
+#ifndef SEQ_RESYNC_STALE
+#define SEQ_RESYNC_STALE      16     // reportes atrasados seguidos, sin ninguno aceptado: el tag reinició
+#endif
+static_assert(SEQ_REORDER_WINDOW < DEDUP_WINDOW, "la ventana de duplicados debe cubrir la de reorden");
 
 struct Point {
     float x = 0.0f, y = 0.0f, z = 0.0f;
 };
 
+// Resultado de una trilateración para un tag concreto
+struct TagFix {
+    uint32_t tag_uid = 0;
+    uint16_t seq = 0;
+    Point    pos;
+    float    rms = 0.0f;     // residuo RMS (m)
+    uint8_t  anchors = 0;    // anclas usadas en el cálculo
+    bool     is3D = false;
+    uint32_t t_ms = 0;       // medición: mediana de los t_ms de las anclas en millis() del concentrador (TimeBase)
+    uint32_t version = 0;    // versión del manager en la que se publicó
+};
+
+// Último timestamp+sensores de un tag. Todas las anclas que oyen una
+// secuencia traen el mismo bloque: se toma el primero de cada seq y las
+// copias (v1, RANGE_FULL, TAG_TELEMETRY redundantes) solo se cuentan.
+struct TagTelemetryEntry {
+    TagTelemetry_t data = {};    // empaquetado, como viaja (unpack_tag_telemetry)
+    uint16_t seq = 0;            // secuencia de la que proviene
+    uint32_t rx_ms = 0;
+    uint64_t epoch_ms = 0;       // timestamp del tag en ms Unix (0 = fecha inválida)
+    uint32_t version = 0;        // 0 = el tag aún no envió telemetría
+};
+
+// Estadísticas móviles de un ancla. Cada reporte las actualiza en O(1) con
+// medias exponenciales; el rango mezcla todos los tags que mide el ancla.
+struct AnchorStats {
+    float    interval_ms = 0.0f;     // intervalo medio entre reportes
+    float    participation = 0.0f;   // fracción de secuencias cerradas en que reportó...
+    uint32_t participation_at = 0;   // ...hasta esta cuenta de secuencias cerradas del manager
+    float    range_mean = 0.0f;      // m
+    float    range_var = 0.0f;       // m²
+    float    noise_mean = 0.0f;      // std_noise
+    float    cir_mean = 0.0f;        // cir_pwr
+    float    rssi_dbm = 0.0f;        // RSSI del enlace ESP-NOW (0 = sin dato)
+    float    latency_ms = 0.0f;      // recepción - medición (retardo en el ancla y en el aire)
+    int32_t  clock_offset_ms = 0;    // millis() del concentrador - t_ms del ancla
+    float    clock_drift_ppm = 0.0f; // deriva del reloj del ancla (TimeBase; + = adelanta)
+    bool     stale = false;          // según el último barrido del escritor
+
+    // Participación con "closed" secuencias cerradas: las que cerraron desde
+    // participation_at sin el ancla la decaen, como si se hubiera aplicado
+    // la media a cada una (el escritor solo actualiza las anclas presentes)
+    float participationAt(uint32_t closed) const {
+        const int32_t missed = (int32_t)(closed - participation_at);
+        return (missed > 0) ? participation * powf(1.0f - ANCHOR_EMA_ALPHA, (float)missed) : participation;
+    }
+    // Reportes por segundo según el intervalo medio
+    float rateHz() const { return interval_ms > 0.0f ? 1000.0f / interval_ms : 0.0f; }
+    // Tiempo de silencio tras el cual el ancla se da por caída
+    uint32_t staleAfterMs() const {
+        uint32_t ms = (uint32_t)(interval_ms * ANCHOR_STALE_PERIODS);
+        if (ms < ANCHOR_STALE_MIN_MS) ms = ANCHOR_STALE_MIN_MS;
+        if (ms > ANCHOR_STALE_MS) ms = ANCHOR_STALE_MS;
+        return ms;
+    }
+};
+
+// Último reporte de un ancla y la versión del manager en que cambió
+struct AnchorEntry {
+    DecodedAnchorReport_t report = {};
+    uint32_t version = 0;
+    uint32_t reports = 0;       // reportes recibidos desde el arranque
+    double   range_sum = 0.0;   // suma de range_m (media = range_sum / reports)
+    AnchorStats stats;
+
+    // Los lectores evalúan la caída con su propio reloj: el flag publicado
+    // solo se refresca cuando llegan reportes de cualquier ancla
+    // (diferencia con signo: el lector pudo tomar "now" antes del último reporte)
+    bool staleAt(uint32_t now) const {
+        return reports == 0 || (int32_t)(now - report.rx_ms) > (int32_t)stats.staleAfterMs();
+    }
+};
+
+// Contadores del pipeline. Solo los incrementa el escritor (con _writerLock); los lectores
+// (/metrics) leen palabras de 32 bits sueltas, sin necesidad de bloqueo.
+struct ManagerStats {
+    uint32_t reports_received = 0;
+    uint32_t reports_wrong_size = 0;    // frames descartados en OnDataRecv (ni v1 ni v2)
+    uint32_t frames_v1 = 0;             // frames con un AnchorRangeReport_t
+    uint32_t frames_v2 = 0;             // frames agregados (AnchorFrame.h)
+    uint32_t frames_truncated = 0;      // v2 cuyos registros no cierran con el largo
+    uint32_t records_skipped = 0;       // registros v2 de tipo desconocido
+    uint32_t telemetry_updates = 0;     // bloques del tag incorporados (uno por seq)
+    uint32_t telemetry_redundant = 0;   // copias de un bloque ya incorporado o más viejo
+    uint32_t reports_dropped = 0;       // sin aporte a un fix: secuencia expirada o tabla llena
+    uint32_t anchor_table_full = 0;     // reportes de anclas sin casilla libre
+    uint32_t sequences_completed = 0;
+    uint32_t sequences_expired = 0;
+    uint32_t sequences_short = 0;       // cerradas sin esperar: todas las anclas vivas ya reportaron
+    uint32_t solves_ok = 0;
+    uint32_t solves_ill_conditioned = 0;
+    uint32_t solves_unknown_anchor = 0; // conjunto con un ancla sin posición configurada
+    uint32_t pending_sequences = 0;     // sin resolver (cupo MAX_PENDING_SEQUENCES)
+    uint32_t pending_high_water = 0;
+    uint32_t lingering_sequences = 0;   // resueltas esperando tardíos (cupo MAX_LINGER_SEQUENCES)
+    uint32_t lingering_full = 0;        // resueltas cerradas sin esperar tardíos por falta de cupo
+    uint32_t anchors_live = 0;          // anclas no caídas según el último barrido
+    uint32_t solves_early = 0;          // resueltas al reportar todas las anclas esperadas
+    uint32_t solves_deadline = 0;       // resueltas al vencer el plazo de espera
+    uint32_t reports_late = 0;          // llegados con la secuencia ya resuelta (solo aprendizaje)
+    uint32_t reports_duplicate = 0;     // (ancla, tag, seq) ya recibido: retransmisiones
+    uint32_t reports_stale = 0;         // más de SEQ_REORDER_WINDOW seqs detrás del tag
+    uint32_t sequences_aged = 0;        // incompletas que quedaron fuera de la ventana de reorden
+    uint32_t clock_resyncs = 0;         // relojes de ancla reiniciados (reinicio o salto del ancla)
+    uint32_t seq_resyncs = 0;           // órdenes de tag reiniciados por SEQ_RESYNC_STALE atrasados seguidos
+    float    fix_latency_ms = 0.0f;     // publicación - medición (media exponencial)
+    uint32_t fix_latency_max_ms = 0;
+};
+
+// Secuencia en espera: reportes por ancla y medición del primero.
+// Las máscaras son de casillas de ancla (bit i = casilla i).
+struct PendingSequence {
+    uint32_t first_ms = 0;        // meas_ms del primer reporte (reloj del concentrador)
+    uint32_t deadline_ms = 0;     // plazo de espera armado (0 = sin plazo)
+    uint32_t solved_ms = 0;       // resuelta: solo registra tardíos hasta POLICY_LINGER_MS
+    bool     solved = false;
+    uint32_t expected = 0;        // anclas que suelen oír a este tag
+    uint32_t present = 0;         // anclas que ya reportaron
+    std::map<uint16_t, DecodedAnchorReport_t> readings;
+};
+
+// Cuándo cerrar una secuencia que ya alcanzó min_anchors:
+// - LATENCY_FIRST: en el acto (comportamiento clásico).
+// - ACCURACY_FIRST: espera hasta wait_ms a las anclas esperadas del tag y
+//   resuelve antes si todas reportaron.
+enum AnchorPolicyMode : uint8_t {
+    POLICY_LATENCY_FIRST  = 0,
+    POLICY_ACCURACY_FIRST = 1
+};
+
+struct AnchorPolicy {
+    AnchorPolicyMode mode = POLICY_DEFAULT_MODE;
+    uint8_t  min_anchors = 4;
+    uint16_t wait_ms = POLICY_WAIT_MS;
+};
+
+// Qué anclas oyen a un tag: puntaje 0..255 por casilla de ancla, aprendido
+// al cerrar cada secuencia del tag
+struct TagProfile {
+    uint8_t  hear[MAX_ANCHORS] = {};
+    uint32_t last_ms = 0;
+};
+
+// Seqs ya vistas de un (ancla, tag): bit i = top - i. Avanza con
+// aritmética de números de serie (RFC 1982), así que el salto 65535 -> 0 es
+// un paso más. Un seq más viejo que la ventana se toma como reinicio del tag.
+struct SeqWindow {
+    uint32_t bits = 0;            // 0 = vacía
+    uint16_t top = 0;             // seq más nueva vista
+
+    // true si el seq no se había visto (y queda marcado)
+    bool accept(uint16_t seq) {
+        const int16_t d = (int16_t)(seq - top);
+        if (bits == 0 || d >= DEDUP_WINDOW || d <= -DEDUP_WINDOW) {
+            top = seq;
+            bits = 1;
+            return true;
+        }
+        if (d > 0) {
+            bits = (bits << d) | 1;
+            top = seq;
+            return true;
+        }
+        const uint32_t mask = 1UL << (-d);
+        if (bits & mask) return false;
+        bits |= mask;
+        return true;
+    }
+};
+
+// Orden de un tag: su seq más nueva, las ventanas de duplicados (una por
+// casilla de ancla) y la seq del último bloque de telemetría incorporado.
+// Un reinicio del orden reinicia también el de la telemetría.
+struct TagSeqWindows {
+    SeqWindow anchors[MAX_ANCHORS];
+    uint16_t  newest = 0;         // seq más nueva aceptada
+    bool      seen = false;
+    uint32_t  last_ms = 0;        // último reporte aceptado
+    uint8_t   stale_run = 0;      // reportes atrasados seguidos desde el último aceptado
+    uint16_t  telemetry_seq = 0;
+    bool      telemetry_seen = false;
+};
+
+// Se invoca con _writerLock tomado desde el escritor que resolvió la secuencia:
+// la tarea Wi-Fi (addAnchorReport en OnDataRecv) o loop() (poll() al vencer un
+// plazo de la política). Debe ser breve, no bloquear ni volver a llamar a los
+// métodos de escritura del manager.
+typedef std::function<void(const TagFix&)> FixListener;
+
+// ============================================================================
+// El manager tiene un escritor a la vez y varios lectores (handlers web en
+// async_tcp, loop()). Escriben la tarea Wi-Fi (addAnchorReport) y loop()
+// (poll, solo cuando vence un plazo de la política), serializados por
+// _writerLock. El estado que leen los demás hilos se publica en tablas de
+// casillas SeqlockSlot de tamaño fijo: los lectores nunca se bloquean ni ven
+// una entrada a medias. Las casillas no se mueven; el lector recorre
+// 0..count()-1.
+// ============================================================================
 class PositioningManager {
 public:
     PositioningManager(int minAnchors = 3);
     void setAnchorPosition(uint16_t anchor_saddr, float x, float y, float z);
-    void addAnchorReport(const DecodedAnchorReport_t& report);
+    // Completa report.meas_ms con la base de tiempo antes de correlacionar
+    void addAnchorReport(const DecodedAnchorReport_t& received);
+    // Bloque del tag enviado aparte de los rangos (registro TAG_TELEMETRY)
+    void addTagTelemetry(const TagTelemetryRecord_t& record, uint32_t rx_ms);
+    void addFixListener(FixListener listener);
+    // Resuelve las secuencias cuyo plazo de espera venció (llamar desde loop())
+    void poll();
+    void setPolicy(const AnchorPolicy& policy);
+    AnchorPolicy policy() const;
+    static const char* policyModeName(AnchorPolicyMode mode);
+    static bool parsePolicyMode(const char* name, AnchorPolicyMode& out);
+    // OnDataRecv descartó un paquete de tamaño inesperado
+    void countWrongSize() { _stats.reports_wrong_size++; }
+    // OnDataRecv decodificó un frame (v1 o v2)
+    void countFrame(const AnchorFrameInfo& info) {
+        if (info.version == 1) _stats.frames_v1++; else _stats.frames_v2++;
+        if (info.truncated) _stats.frames_truncated++;
+        _stats.records_skipped += info.skipped;
+    }
+
+    // --- Lectura segura desde cualquier hilo ---
     Point getLastTagPosition() const;
-    const std::map<uint16_t, DecodedAnchorReport_t>& getAnchorDataMap() const;
+    // Contador monótono: cada alta o cambio de ancla/tag recibe ++version
+    uint32_t getVersion() const;
+    // Secuencias cerradas desde el arranque (AnchorStats::participationAt)
+    uint32_t closedSequences() const { return _closedSequences.load(std::memory_order_acquire); }
+    size_t anchorCount() const;
+    bool readAnchor(size_t index, AnchorEntry& out) const;
+    size_t tagCount() const;
+    bool readTag(size_t index, TagFix& out) const;
+    // Misma casilla que readTag
+    bool readTagTelemetry(size_t index, TagTelemetryEntry& out) const;
+    // Se configura en setup() y no cambia después: lectura libre desde cualquier hilo
+    const std::map<uint16_t, Point>& getAnchorPositions() const;
+    const ManagerStats& stats() const { return _stats; }
+    // Base de tiempo (la escribe solo el manager; offsets y deriva se publican en AnchorStats)
+    const TimeBase& timebase() const { return _timebase; }
 
 private:
-    void calculateTagPosition(uint16_t sequence_id);
+    // Las secuencias se correlacionan por (tag, seq): cada tag numera sus rondas
+    static uint64_t sequenceKey(uint32_t tag_uid, uint16_t seq) {
+        return ((uint64_t)tag_uid << 16) | seq;
+    }
+    bool calculateTagPosition(uint64_t sequence_key, TagFix& fix);
+    bool solveSequence(uint64_t sequence_key, PendingSequence& sequence);
+    void fireDeadlines(uint32_t now);
+    uint32_t expectedAnchors(uint32_t tag_uid);
+    void learnSequence(uint32_t tag_uid, const PendingSequence& sequence);
+    bool orderSequence(uint32_t tag_uid, TagSeqWindows& windows, uint16_t seq, uint32_t now);
+    void ageSequences(uint32_t tag_uid, uint16_t newest);
+    void publishFix(TagFix& fix);
+    int tagSlotFor(uint32_t tag_uid);
+    bool claimTelemetry(TagSeqWindows& windows, uint16_t seq, uint32_t now);
+    void publishTelemetry(int slot, uint16_t seq, const TagTelemetry_t& data, uint32_t rx_ms);
+    void expireSequences(uint32_t now);
+    void countPending();
+    void updateAnchorStats(int slot, const DecodedAnchorReport_t& report);
+    void sweepAnchors(uint32_t now);
+    void closeSequence(uint64_t sequence_key, const PendingSequence& sequence);
+    size_t requiredAnchors() const;
+    static uint32_t sequenceTime(const std::map<uint16_t, DecodedAnchorReport_t>& readings);
 
-    int _minAnchors;
-    Point _lastTagPosition;
+    AnchorPolicy _policy;
+    mutable std::mutex _writerLock;
+    std::atomic<uint32_t> _nextDeadlineMs;   // 0 = ningún plazo armado
+    std::map<uint32_t, TagProfile> _profiles;
+    std::atomic<uint32_t> _version;
+    std::atomic<uint32_t> _closedSequences;
     std::map<uint16_t, Point> _anchorPositions;
-    std::map<uint16_t, DecodedAnchorReport_t> _latestAnchorData;
-    std::map<uint16_t, std::map<uint16_t, DecodedAnchorReport_t>> _sequenceData;
+    std::map<uint64_t, PendingSequence> _sequenceData;
+    size_t _lingering;                       // resueltas de _sequenceData (fuera de MAX_PENDING_SEQUENCES)
+    uint32_t _lastSweepMs;
+    TimeBase _timebase;
+    std::vector<FixListener> _fixListeners;
+
+    // Estado publicado (seqlock por casilla)
+    SeqlockSlot<Point>       _lastTagPosition;
+    SeqlockSlot<AnchorEntry> _anchors[MAX_ANCHORS];
+    SeqlockSlot<TagFix>      _tags[MAX_TAGS];
+    SeqlockSlot<TagTelemetryEntry> _tagTelemetry[MAX_TAGS];
+    std::atomic<uint8_t>     _anchorCount;
+    std::atomic<uint8_t>     _tagCount;
+
+    // Índices clave -> casilla (solo los usa el escritor)
+    std::map<uint16_t, uint8_t> _anchorIndex;
+    std::map<uint32_t, uint8_t> _tagIndex;
+    TagSeqWindows _seqWindows[MAX_TAGS];    // orden de cada tag, por casilla
+    ManagerStats _stats;
 };
 
 #endif // POSITIONING_MANAGER_H
@@ -0,0 +1,175 @@
+#ifndef RAW_BATCH_H
+#define RAW_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================================================
+// Reenvío crudo (modo raw-forward): el concentrador no resuelve y manda los
+// frames ESP-NOW tal como llegaron, agrupados, a un servicio en Linux
+// (tools/solver). Formato little-endian:
+//   batch  = RawBatchHeader_t + count x (RawFrameRecord_t + frame de len bytes)
+// - UDP: un batch por datagrama (a lo sumo RAW_BATCH_MAX bytes).
+// - TCP: batches seguidos; "length" delimita cada uno en el stream.
+// batch_seq es consecutivo por fuente: el receptor cuenta los batches
+// perdidos por los huecos, y "dropped" trae los frames que el concentrador
+// no pudo encolar (acumulado, así que no se pierde con un batch).
+// El mismo sobre lleva también fixes ya resueltos (FIX_BATCH_MAGIC): un
+// concentrador que resuelve en su zona los envía al agregador como
+// count x BinFixRecord_t (StreamCodec.h, el registro del formato "struct").
+// ============================================================================
+#define RAW_BATCH_MAGIC     0xB7
+#define FIX_BATCH_MAGIC     0xB8
+#define RAW_BATCH_VERSION   1
+#define RAW_BATCH_MAX       1400     // cabe en una trama Ethernet/Wi-Fi sin fragmentar
+#define RAW_FORWARD_PORT    9750
+
+#pragma pack(push, 1)
+typedef struct RawBatchHeader_t {
+    uint8_t  magic;          // RAW_BATCH_MAGIC o FIX_BATCH_MAGIC
+    uint8_t  version;        // RAW_BATCH_VERSION
+    uint16_t length;         // bytes del batch, cabecera incluida
+    uint32_t source;         // id del concentrador (últimos 4 bytes de su MAC)
+    uint32_t batch_seq;      // consecutivo por fuente
+    uint32_t sent_ms;        // millis() del concentrador al cerrar el batch
+    uint32_t dropped;        // frames no encolados en el concentrador (acumulado)
+    uint16_t count;          // frames en el batch
+} RawBatchHeader_t;          // 22 bytes
+
+typedef struct RawFrameRecord_t {
+    uint32_t rx_ms;          // millis() del concentrador al recibir el frame
+    uint8_t  mac[6];         // emisor ESP-NOW
+    int8_t   rssi;           // dBm (0 = sin dato)
+    uint8_t  len;            // bytes del frame que sigue
+} RawFrameRecord_t;          // 12 bytes
+#pragma pack(pop)
+
+// Bytes que ocupa un frame de len bytes dentro del batch
+inline size_t raw_record_size(size_t len) { return sizeof(RawFrameRecord_t) + len; }
+
+// ============================================================================
+// Arma un batch en un buffer propio. add() (frames) y addRecord() (fixes)
+// devuelven false si no cabe: el llamador envía el batch (finish +
+// data/size) y empieza otro.
+// ============================================================================
+class RawBatchBuilder {
+public:
+    void begin(uint32_t source, uint32_t batch_seq, uint8_t magic = RAW_BATCH_MAGIC) {
+        RawBatchHeader_t h = {};
+        h.magic     = magic;
+        h.version   = RAW_BATCH_VERSION;
+        h.length    = sizeof(RawBatchHeader_t);
+        h.source    = source;
+        h.batch_seq = batch_seq;
+        memcpy(_buf, &h, sizeof(h));
+        _len = sizeof(RawBatchHeader_t);
+        _count = 0;
+    }
+
+    bool add(const uint8_t* mac, const uint8_t* frame, uint8_t len, int8_t rssi, uint32_t rx_ms) {
+        if (_len + raw_record_size(len) > RAW_BATCH_MAX) return false;
+        RawFrameRecord_t r;
+        r.rx_ms = rx_ms;
+        memcpy(r.mac, mac, 6);
+        r.rssi = rssi;
+        r.len  = len;
+        memcpy(_buf + _len, &r, sizeof(r));
+        memcpy(_buf + _len + sizeof(r), frame, len);
+        _len += raw_record_size(len);
+        _count++;
+        return true;
+    }
+
+    // Registro de largo fijo (batch de fixes)
+    bool addRecord(const void* record, size_t len) {
+        if (_len + len > RAW_BATCH_MAX) return false;
+        memcpy(_buf + _len, record, len);
+        _len += len;
+        _count++;
+        return true;
+    }
+
+    // Completa la cabecera antes de enviar
+    void finish(uint32_t sent_ms, uint32_t dropped) {
+        RawBatchHeader_t h;
+        memcpy(&h, _buf, sizeof(h));
+        h.length  = (uint16_t)_len;
+        h.sent_ms = sent_ms;
+        h.dropped = dropped;
+        h.count   = _count;
+        memcpy(_buf, &h, sizeof(h));
+    }
+
+    bool empty() const { return _count == 0; }
+    uint16_t count() const { return _count; }
+    const uint8_t* data() const { return _buf; }
+    size_t size() const { return _len; }
+
+private:
+    uint8_t  _buf[RAW_BATCH_MAX];
+    size_t   _len = 0;
+    uint16_t _count = 0;
+};
+
+struct RawBatchInfo {
+    bool     ok = false;         // cabecera válida
+    bool     truncated = false;  // los registros no cierran con el largo
+    RawBatchHeader_t header = {};
+};
+
+// Largo del batch (de frames o de fixes) que empieza en data (TCP: cuántos
+// bytes esperar); 0 si la cabecera no es de un batch
+inline size_t raw_batch_length(const uint8_t* data, size_t avail) {
+    if (avail < sizeof(RawBatchHeader_t) || (data[0] != RAW_BATCH_MAGIC && data[0] != FIX_BATCH_MAGIC)
+        || data[1] != RAW_BATCH_VERSION) return 0;
+    RawBatchHeader_t h;
+    memcpy(&h, data, sizeof(h));
+    return h.length >= sizeof(RawBatchHeader_t) ? h.length : 0;
+}
+
+// ============================================================================
+// Recorre un batch entregando cada frame a
+// sink(const RawFrameRecord_t&, const uint8_t* frame). El frame se entrega
+// tal como llegó al concentrador: se decodifica con decode_anchor_frame.
+// ============================================================================
+template <typename Sink>
+RawBatchInfo decode_raw_batch(const uint8_t* data, size_t len, Sink&& sink) {
+    RawBatchInfo info;
+    if (raw_batch_length(data, len) == 0 || data[0] != RAW_BATCH_MAGIC) return info;
+    memcpy(&info.header, data, sizeof(info.header));
+    info.ok = true;
+    const size_t end = info.header.length < len ? info.header.length : len;
+    size_t off = sizeof(RawBatchHeader_t);
+    for (uint16_t i = 0; i < info.header.count; i++) {
+        RawFrameRecord_t r;
+        if (off + sizeof(r) > end) { info.truncated = true; break; }
+        memcpy(&r, data + off, sizeof(r));
+        off += sizeof(r);
+        if (off + r.len > end) { info.truncated = true; break; }
+        sink(r, data + off);
+        off += r.len;
+    }
+    return info;
+}
+
+// Batch de fixes: entrega cada registro a sink(const Record&)
+template <typename Record, typename Sink>
+RawBatchInfo decode_fix_batch(const uint8_t* data, size_t len, Sink&& sink) {
+    RawBatchInfo info;
+    if (raw_batch_length(data, len) == 0 || data[0] != FIX_BATCH_MAGIC) return info;
+    memcpy(&info.header, data, sizeof(info.header));
+    info.ok = true;
+    const size_t end = info.header.length < len ? info.header.length : len;
+    size_t off = sizeof(RawBatchHeader_t);
+    for (uint16_t i = 0; i < info.header.count; i++) {
+        if (off + sizeof(Record) > end) { info.truncated = true; break; }
+        Record r;
+        memcpy(&r, data + off, sizeof(r));
+        off += sizeof(r);
+        sink(r);
+    }
+    return info;
+}
+
+#endif // RAW_BATCH_H
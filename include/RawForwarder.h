@@ -0,0 +1,105 @@
+#ifndef RAW_FORWARDER_H
+#define RAW_FORWARDER_H
+
+#include <atomic>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <ESPAsyncWebServer.h>
+#include "RawBatch.h"
+
+enum ForwardMode : uint8_t {
+    FORWARD_LOCAL = 0,       // resuelve en el ESP32 (comportamiento clásico)
+    FORWARD_RAW   = 1        // reenvía los frames crudos, sin resolver
+};
+
+enum ForwardProto : uint8_t {
+    FORWARD_UDP = 0,
+    FORWARD_TCP = 1
+};
+
+// --- CONFIGURACIÓN DEL REENVÍO CRUDO (redefinibles con -D en build_flags) ---
+#ifndef FORWARD_DEFAULT_MODE
+#define FORWARD_DEFAULT_MODE   FORWARD_LOCAL
+#endif
+#ifndef FORWARD_HOST
+#define FORWARD_HOST           ""             // IP del servicio (vacío: se configura en /forward)
+#endif
+#ifndef FORWARD_PORT
+#define FORWARD_PORT           RAW_FORWARD_PORT
+#endif
+#ifndef FORWARD_PROTO
+#define FORWARD_PROTO          FORWARD_UDP
+#endif
+#ifndef FORWARD_FLUSH_MS
+#define FORWARD_FLUSH_MS       20             // un batch a medio llenar sale tras este tiempo
+#endif
+#define FORWARD_RECONNECT_MS       2000       // TCP: espera entre intentos de conexión...
+#define FORWARD_RECONNECT_MAX_MS   32000      // ...que se duplica con cada fallo hasta este tope
+#define FORWARD_CONNECT_TIMEOUT_MS 200        // TCP: connect() bloquea loop() a lo sumo esto
+
+// ============================================================================
+// Modo raw-forward: para sitios con más tags de los que resuelve el ESP32.
+// - push() corre en la tarea Wi-Fi: copia el frame al batch activo (sección
+//   crítica corta). Al llenarse se sella y se pasa al segundo; si ambos
+//   están ocupados el frame se descarta y se cuenta en "dropped".
+// - loop() envía el batch sellado (o uno a medio llenar tras
+//   FORWARD_FLUSH_MS) por UDP o TCP. Un batch que no se pudo enviar se
+//   pierde: el servicio lo ve como hueco en batch_seq.
+// - El formato (RawBatch.h) lo comparten el servicio tools/solver y el
+//   generador de tráfico del simulador.
+// ============================================================================
+class RawForwarder {
+public:
+    RawForwarder();
+    void begin(const uint8_t mac[6]);
+    void loop();
+    void serve(AsyncWebServer& server);
+
+    // Reenvío activo: modo raw con destino configurado
+    bool active() const { return _mode.load(std::memory_order_relaxed) == FORWARD_RAW && _hasHost; }
+    // Tarea Wi-Fi: encola un frame ESP-NOW tal como llegó
+    void push(const uint8_t* mac, const uint8_t* frame, int len, int8_t rssi, uint32_t rx_ms);
+
+    static const char* modeName(ForwardMode mode) { return mode == FORWARD_RAW ? "raw" : "local"; }
+    static const char* protoName(ForwardProto proto) { return proto == FORWARD_TCP ? "tcp" : "udp"; }
+
+    // Contadores para /metrics
+    uint32_t forwarded() const { return _forwarded; }
+    uint32_t dropped() const { return _dropped; }
+    uint32_t batches() const { return _batches; }
+    uint32_t sendErrors() const { return _sendErrors; }
+    uint32_t bytesSent() const { return _bytesSent; }
+
+private:
+    bool sealActive();
+    bool send(const uint8_t* data, size_t len);
+
+    RawBatchBuilder _batch[2];
+    bool     _sealed[2];      // listo para enviar (lo libera loop())
+    uint8_t  _active;         // batch que recibe frames
+    uint32_t _batchStartMs;   // primer frame del batch activo
+    uint32_t _source;
+    uint32_t _nextSeq;
+    portMUX_TYPE _lock;
+
+    std::atomic<uint8_t> _mode;
+    // Destino: lo cambia la web y lo lee loop() (bajo _lock)
+    IPAddress    _host;
+    uint16_t     _port;
+    ForwardProto _proto;
+    bool         _hasHost;
+    uint8_t      _target;         // cambia con cada destino nuevo
+    WiFiUDP      _udp;
+    WiFiClient   _tcp;
+    uint8_t      _tcpTarget;      // destino de _tcp (solo loop())
+    uint32_t     _lastConnectMs;
+    uint32_t     _reconnectMs;    // espera tras el último fallo (0: conectado o destino nuevo)
+
+    uint32_t _forwarded;
+    uint32_t _dropped;
+    uint32_t _batches;
+    uint32_t _sendErrors;
+    uint32_t _bytesSent;
+};
+
+#endif // RAW_FORWARDER_H
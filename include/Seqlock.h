@@ -0,0 +1,51 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#define SEQLOCK_MAX_RETRIES 64   // lecturas fallidas antes de rendirse
+
+// ============================================================================
+// Casilla publicada con seqlock (un único escritor, N lectores).
+// - El escritor nunca espera: marca la casilla impar, copia y la marca par.
+// - El lector copia y reintenta si el contador era impar o cambió durante la
+//   copia, de modo que nunca observa un valor a medio escribir.
+// T debe ser trivialmente copiable (se copia con memcpy).
+// ============================================================================
+template <typename T>
+class SeqlockSlot {
+public:
+    SeqlockSlot() : _seq(0), _value() {}
+
+    // Solo desde el hilo escritor
+    void write(const T& v) {
+        const uint32_t s = _seq.load(std::memory_order_relaxed);
+        _seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &v, sizeof(T));
+        _seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Lectura desde el hilo escritor (no necesita protección)
+    const T& peek() const { return _value; }
+
+    // Lectura consistente desde cualquier hilo; false si no se logró a tiempo
+    bool read(T& out) const {
+        for (int i = 0; i < SEQLOCK_MAX_RETRIES; i++) {
+            const uint32_t s1 = _seq.load(std::memory_order_acquire);
+            if (s1 & 1) continue;
+            memcpy(&out, &_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == s1) return true;
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> _seq;
+    T _value;
+};
+
+#endif // SEQLOCK_H
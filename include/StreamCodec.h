@@ -0,0 +1,194 @@
+#ifndef STREAM_CODEC_H
+#define STREAM_CODEC_H
+
+#include <ArduinoJson.h>
+#include "PositioningManager.h"
+
+// ============================================================================
+// Eventos del stream de posiciones y sus codificaciones binarias.
+// - FORMAT_JSON:    texto (SSE y clientes WebSocket que no piden binario)
+// - FORMAT_MSGPACK: arreglo MessagePack [tipo, campos...] con ArduinoJson
+// - FORMAT_STRUCT:  struct empaquetado little-endian (el ESP32 es LE), con
+//                   coordenadas cuantizadas a milímetros
+// ============================================================================
+
+enum StreamFormat : uint8_t {
+    FORMAT_JSON    = 0,
+    FORMAT_MSGPACK = 1,
+    FORMAT_STRUCT  = 2
+};
+
+enum StreamEventType : uint8_t {
+    STREAM_EVT_FIX    = 1,
+    STREAM_EVT_ANCHOR = 2
+};
+
+// Estado resumido de un ancla (evento "anchor")
+struct AnchorHealth {
+    uint16_t anchor_saddr = 0;
+    bool     online = false;
+    uint32_t age_ms = 0;       // tiempo desde el último reporte
+    uint32_t tag_uid = 0;      // último tag medido
+    uint16_t seq = 0;
+    float    range_m = 0.0f;
+    uint16_t std_noise = 0;
+    uint16_t cir_pwr = 0;
+};
+
+// Evento retenido en el anillo: id monótono + carga según el tipo
+struct StreamEvent {
+    uint32_t        id = 0;
+    StreamEventType type = STREAM_EVT_FIX;
+    TagFix          fix;
+    AnchorHealth    anchor;
+};
+
+#define STREAM_FLAG_3D      0x01   // fix: solución 3D
+#define STREAM_FLAG_ONLINE  0x01   // anchor: reportando
+
+#pragma pack(push, 1)
+typedef struct BinFixRecord_t {
+    uint8_t  type;           // STREAM_EVT_FIX
+    uint8_t  flags;          // STREAM_FLAG_3D
+    uint32_t tag_uid;
+    uint16_t seq;
+    int32_t  x_mm, y_mm, z_mm;
+    uint16_t rms_mm;
+    uint8_t  anchors;
+    uint32_t t_ms;
+} BinFixRecord_t;            // 27 bytes
+
+typedef struct BinAnchorRecord_t {
+    uint8_t  type;           // STREAM_EVT_ANCHOR
+    uint8_t  flags;          // STREAM_FLAG_ONLINE
+    uint16_t anchor_saddr;
+    uint32_t tag_uid;
+    uint16_t seq;
+    uint32_t range_mm;
+    uint16_t std_noise;
+    uint16_t cir_pwr;
+    uint32_t age_ms;
+} BinAnchorRecord_t;         // 22 bytes
+#pragma pack(pop)
+
+// Tamaño máximo de un evento codificado en cualquier formato binario
+#define STREAM_BIN_MAX 48
+
+static inline int32_t meters_to_mm(float m) {
+    const float mm = m * 1000.0f;
+    if (mm >  2147483000.0f) return  2147483000L;
+    if (mm < -2147483000.0f) return -2147483000L;
+    return (int32_t)lroundf(mm);
+}
+
+// ============================================================================
+// STRUCT: memcpy del registro empaquetado
+// ============================================================================
+inline size_t encode_event_struct(const StreamEvent& ev, uint8_t* out, size_t len) {
+    if (ev.type == STREAM_EVT_FIX) {
+        if (len < sizeof(BinFixRecord_t)) return 0;
+        const TagFix& f = ev.fix;
+        BinFixRecord_t r;
+        r.type    = STREAM_EVT_FIX;
+        r.flags   = f.is3D ? STREAM_FLAG_3D : 0;
+        r.tag_uid = f.tag_uid;
+        r.seq     = f.seq;
+        r.x_mm    = meters_to_mm(f.pos.x);
+        r.y_mm    = meters_to_mm(f.pos.y);
+        r.z_mm    = meters_to_mm(f.pos.z);
+        r.rms_mm  = clamp_u16(f.rms * 1000.0f);
+        r.anchors = f.anchors;
+        r.t_ms    = f.t_ms;
+        memcpy(out, &r, sizeof(r));
+        return sizeof(r);
+    }
+
+    if (len < sizeof(BinAnchorRecord_t)) return 0;
+    const AnchorHealth& a = ev.anchor;
+    BinAnchorRecord_t r;
+    r.type         = STREAM_EVT_ANCHOR;
+    r.flags        = a.online ? STREAM_FLAG_ONLINE : 0;
+    r.anchor_saddr = a.anchor_saddr;
+    r.tag_uid      = a.tag_uid;
+    r.seq          = a.seq;
+    r.range_mm     = (uint32_t)(a.range_m > 0.0f ? meters_to_mm(a.range_m) : 0);
+    r.std_noise    = a.std_noise;
+    r.cir_pwr      = a.cir_pwr;
+    r.age_ms       = a.age_ms;
+    memcpy(out, &r, sizeof(r));
+    return sizeof(r);
+}
+
+// ============================================================================
+// MSGPACK: mismos campos que el struct, como arreglo posicional
+//   fix:    [1, tag_uid, seq, x_mm, y_mm, z_mm, rms_mm, anchors, flags, t_ms]
+//   anchor: [2, anchor_saddr, flags, tag_uid, seq, range_mm, std_noise, cir_pwr, age_ms]
+// ============================================================================
+inline size_t encode_event_msgpack(const StreamEvent& ev, uint8_t* out, size_t len) {
+    StaticJsonDocument<JSON_ARRAY_SIZE(10)> doc;
+    JsonArray arr = doc.to<JsonArray>();
+
+    if (ev.type == STREAM_EVT_FIX) {
+        const TagFix& f = ev.fix;
+        arr.add((uint8_t)STREAM_EVT_FIX);
+        arr.add(f.tag_uid);
+        arr.add(f.seq);
+        arr.add(meters_to_mm(f.pos.x));
+        arr.add(meters_to_mm(f.pos.y));
+        arr.add(meters_to_mm(f.pos.z));
+        arr.add(clamp_u16(f.rms * 1000.0f));
+        arr.add(f.anchors);
+        arr.add((uint8_t)(f.is3D ? STREAM_FLAG_3D : 0));
+        arr.add(f.t_ms);
+    } else {
+        const AnchorHealth& a = ev.anchor;
+        arr.add((uint8_t)STREAM_EVT_ANCHOR);
+        arr.add(a.anchor_saddr);
+        arr.add((uint8_t)(a.online ? STREAM_FLAG_ONLINE : 0));
+        arr.add(a.tag_uid);
+        arr.add(a.seq);
+        arr.add(a.range_m > 0.0f ? meters_to_mm(a.range_m) : 0);
+        arr.add(a.std_noise);
+        arr.add(a.cir_pwr);
+        arr.add(a.age_ms);
+    }
+
+    return serializeMsgPack(doc, out, len);
+}
+
+// ============================================================================
+// JSON: objeto plano (el mismo que viaja por SSE)
+// ============================================================================
+inline size_t encode_event_json(const StreamEvent& ev, char* buf, size_t len) {
+    int n = 0;
+    if (ev.type == STREAM_EVT_FIX) {
+        const TagFix& f = ev.fix;
+        n = snprintf(buf, len,
+            "{\"tag_uid\":%lu,\"seq\":%u,\"x\":%.3f,\"y\":%.3f,\"z\":%.3f,\"rms\":%.3f,\"anchors\":%u,\"is3D\":%s,\"t_ms\":%lu}",
+            (unsigned long)f.tag_uid, f.seq, f.pos.x, f.pos.y, f.pos.z, f.rms,
+            f.anchors, f.is3D ? "true" : "false", (unsigned long)f.t_ms);
+    } else {
+        const AnchorHealth& a = ev.anchor;
+        n = snprintf(buf, len,
+            "{\"anchor_saddr\":%u,\"online\":%s,\"age_ms\":%lu,\"tag_uid\":%lu,\"seq\":%u,\"range_m\":%.3f,\"std_noise\":%u,\"cir_pwr\":%u}",
+            a.anchor_saddr, a.online ? "true" : "false", (unsigned long)a.age_ms,
+            (unsigned long)a.tag_uid, a.seq, a.range_m, a.std_noise, a.cir_pwr);
+    }
+    return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
+
+inline size_t encode_event(StreamFormat fmt, const StreamEvent& ev, uint8_t* out, size_t len) {
+    switch (fmt) {
+        case FORMAT_MSGPACK: return encode_event_msgpack(ev, out, len);
+        case FORMAT_STRUCT:  return encode_event_struct(ev, out, len);
+        default:             return encode_event_json(ev, (char*)out, len);
+    }
+}
+
+inline StreamFormat parse_stream_format(const char* name) {
+    if (name && strcmp(name, "msgpack") == 0) return FORMAT_MSGPACK;
+    if (name && strcmp(name, "struct")  == 0) return FORMAT_STRUCT;
+    return FORMAT_JSON;
+}
+
+#endif // STREAM_CODEC_H
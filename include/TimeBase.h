@@ -0,0 +1,87 @@
+#ifndef TIME_BASE_H
+#define TIME_BASE_H
+
+#include <stdint.h>
+#include "AnchorFrame.h"
+
+// Lo incluye PositioningManager.h después de fijar la capacidad de sus tablas
+#if !defined(MAX_ANCHORS) || !defined(MAX_TAGS)
+#error "incluir PositioningManager.h en lugar de TimeBase.h"
+#endif
+
+// --- BASE DE TIEMPO (redefinibles con -D en build_flags) ---
+#ifndef TIMEBASE_EPOCH_MS
+#define TIMEBASE_EPOCH_MS     10000  // un punto de la regresión por época: el menor retardo visto en ella
+#endif
+#define TIMEBASE_ALPHA        0.1f   // peso de la época nueva (~10 épocas = 100 s de línea de base)
+#define TIMEBASE_RESYNC_MS    1000   // apartamiento mayor: posible reinicio o salto del reloj del ancla...
+#define TIMEBASE_RESYNC_COUNT    3   // ...si se repite en N reportes seguidos (un tardío aislado no cuenta)
+#define TIMEBASE_REBASE_MS    (1UL << 20)   // re-centra x (~17 min) para no perder resolución en float
+
+// ============================================================================
+// Reloj de un ancla frente al del concentrador. Con x = t_ms del ancla desde
+// el origen e y = (rx_ms - origen local) - x, el modelo es y = offset + drift*x.
+// El retardo de entrega solo suma a y, así que cada época aporta un punto:
+// su y mínimo (la entrega más rápida, como hace NTP con el menor RTT). La
+// recta se ajusta con mínimos cuadrados exponenciales (medias y covarianza
+// de West), O(1) por reporte y unos 40 bytes por ancla.
+// ============================================================================
+struct AnchorClock {
+    uint32_t anchor_ref = 0;     // t_ms del ancla en el origen
+    uint32_t local_ref = 0;      // millis() del concentrador en el origen
+    float    mean_x = 0.0f, mean_y = 0.0f;
+    float    var_x = 0.0f, cov_xy = 0.0f;
+    uint16_t epochs = 0;         // épocas cerradas (0 = sin recta todavía)
+    bool     synced = false;
+    uint8_t  outliers = 0;       // reportes seguidos fuera de TIMEBASE_RESYNC_MS
+    int32_t  epoch_x = 0;        // inicio de la época en curso
+    int32_t  min_x = 0, min_y = 0;   // menor retardo de la época en curso
+
+    // Deriva del ancla respecto del concentrador (ms por ms del ancla)
+    float drift() const { return (epochs >= 2 && var_x > 0.0f) ? cov_xy / var_x : 0.0f; }
+    // y esperado para la entrega más rápida en x
+    float offsetAt(float x) const {
+        return epochs ? mean_y + drift() * (x - mean_x) : (float)min_y;
+    }
+};
+
+// Fecha del tag cacheada: el día cambia una vez cada 86 400 000 ms
+struct CalendarCache {
+    uint16_t year = 0;
+    uint8_t  month = 0, day = 0;
+    int64_t  day_ms = 0;         // ms Unix a las 00:00 de esa fecha
+};
+
+// ============================================================================
+// Base de tiempo única del concentrador: lleva el t_ms de cada ancla a
+// millis() del concentrador y la fecha de calendario de cada tag a ms Unix.
+// La usa solo el escritor del PositioningManager (bajo _writerLock); lo que
+// ven los lectores se publica en AnchorStats.
+// ============================================================================
+class TimeBase {
+public:
+    // Momento de la medición en millis() del concentrador (nunca posterior a
+    // rx_ms). Sin t_ms (0) o sin casilla de ancla (-1) devuelve rx_ms.
+    uint32_t toLocal(int anchorSlot, uint32_t anchor_ms, uint32_t rx_ms);
+    // ms Unix del timestamp del tag; 0 si la fecha no es válida
+    uint64_t tagEpochMs(int tagSlot, const TagTelemetry_t& t);
+
+    const AnchorClock& clock(int anchorSlot) const { return _clocks[anchorSlot]; }
+    // offset del ancla: millis() del concentrador - t_ms del ancla (en x = 0 actual)
+    int32_t offsetMs(int anchorSlot) const;
+    // ppm que adelanta el reloj del ancla (la recta baja cuando el ancla adelanta)
+    float driftPpm(int anchorSlot) const { return -_clocks[anchorSlot].drift() * 1e6f; }
+    uint32_t resyncs() const { return _resyncs; }
+
+    static int64_t daysFromCivil(int y, unsigned m, unsigned d);
+
+private:
+    void restart(AnchorClock& c, uint32_t anchor_ms, uint32_t rx_ms);
+    void closeEpoch(AnchorClock& c);
+
+    AnchorClock   _clocks[MAX_ANCHORS];
+    CalendarCache _calendars[MAX_TAGS];
+    uint32_t      _resyncs = 0;
+};
+
+#endif // TIME_BASE_H
@@ -0,0 +1,47 @@
+#ifndef TRAIL_BUFFER_H
+#define TRAIL_BUFFER_H
+
+#include "PositioningManager.h"
+
+// --- CONFIGURACIÓN DE ESTELAS ---
+#define TRAIL_LENGTH 32     // fixes recientes por tag (memoria: 2 * MAX_TAGS * (TRAIL_LENGTH*6 + 12) bytes ≈ 13 KB)
+
+// Punto de estela cuantizado a centímetros (±327 m)
+struct TrailPoint {
+    int16_t x_cm, y_cm, z_cm;
+};
+
+// Últimos TRAIL_LENGTH fixes de un tag en un anillo fijo
+struct TagTrail {
+    uint32_t   tag_uid;
+    uint32_t   last_ms;      // millis() del último fix (para reciclar la casilla)
+    uint8_t    head;         // próxima posición a escribir
+    uint8_t    count;        // puntos válidos (<= TRAIL_LENGTH)
+    TrailPoint points[TRAIL_LENGTH];
+};
+
+// ============================================================================
+// Estelas de posición por tag para el plano de planta.
+// - Se alimenta como FixListener (tarea Wi-Fi o loop(), de a uno con el lock
+//   del manager) y publica cada estela en una casilla SeqlockSlot: los
+//   handlers web la leen sin bloquear al escritor.
+// - Memoria fija: MAX_TAGS estelas; si se llena se recicla la menos reciente.
+// ============================================================================
+class TrailBuffer {
+public:
+    TrailBuffer();
+    void attach(PositioningManager& manager);
+    void addFix(const TagFix& fix);
+
+    size_t count() const;
+    bool read(size_t index, TagTrail& out) const;
+
+private:
+    static int16_t toCm(float m);
+
+    SeqlockSlot<TagTrail> _slots[MAX_TAGS];
+    TagTrail              _work[MAX_TAGS];   // copia del escritor
+    std::atomic<uint8_t>  _count;
+};
+
+#endif // TRAIL_BUFFER_H
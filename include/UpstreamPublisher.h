@@ -0,0 +1,172 @@
+#ifndef UPSTREAM_PUBLISHER_H
+#define UPSTREAM_PUBLISHER_H
+
+#include <atomic>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <ESPAsyncWebServer.h>
+#include "PositioningManager.h"
+#include "StreamCodec.h"
+#include "RawBatch.h"
+
+enum UpstreamProto : uint8_t {
+    UPSTREAM_UDP  = 0,
+    UPSTREAM_MQTT = 1        // MQTT 3.1.1, QoS 0, sobre TCP
+};
+
+enum UpstreamFormat : uint8_t {
+    UPSTREAM_BIN  = 0,       // sobre RawBatch con FIX_BATCH_MAGIC (lo lee tools/solver)
+    UPSTREAM_JSON = 1        // {"source":..,"batch":..,"fixes":[...]} con los objetos del SSE
+};
+
+// --- CONFIGURACIÓN DEL PUBLICADOR (redefinibles con -D en build_flags) ---
+#ifndef UPSTREAM_HOST
+#define UPSTREAM_HOST          ""             // IP del colector (vacío: se configura en /upstream)
+#endif
+#ifndef UPSTREAM_PORT
+#define UPSTREAM_PORT          9751           // UDP; MQTT usa 1883
+#endif
+#ifndef UPSTREAM_PROTO
+#define UPSTREAM_PROTO         UPSTREAM_UDP
+#endif
+#ifndef UPSTREAM_FORMAT
+#define UPSTREAM_FORMAT        UPSTREAM_BIN
+#endif
+#ifndef UPSTREAM_BATCH_FIXES
+#define UPSTREAM_BATCH_FIXES   32             // un batch sale al juntar tantos fixes...
+#endif
+#ifndef UPSTREAM_FLUSH_MS
+#define UPSTREAM_FLUSH_MS      100            // ...o cuando el más antiguo esperó esto
+#endif
+#ifndef UPSTREAM_QUEUE_LEN
+#define UPSTREAM_QUEUE_LEN     256            // fixes en espera (potencia de dos)
+#endif
+#ifndef UPSTREAM_MQTT_PREFIX
+#define UPSTREAM_MQTT_PREFIX   "uwb"          // tópico: <prefijo>/<source>/fixes
+#endif
+#define UPSTREAM_BATCH_MAX          ((RAW_BATCH_MAX - sizeof(RawBatchHeader_t)) / sizeof(BinFixRecord_t))
+#define UPSTREAM_JSON_BATCH_MAX     10        // fixes JSON (~120 B) por batch; si no caben sale con menos
+#define UPSTREAM_BATCHES_PER_LOOP   4         // envíos por llamada a loop() como mucho
+#define UPSTREAM_RETRY_MS           250       // pausa tras un envío fallido (los fixes siguen en cola)
+#define UPSTREAM_RECONNECT_MS       2000      // MQTT: espera entre intentos de conexión
+#define UPSTREAM_CONNECT_TIMEOUT_MS 200       // MQTT: plazo único de connect() + CONNACK (bloquea loop())
+#define UPSTREAM_MQTT_KEEPALIVE_S   30
+#define UPSTREAM_HEADROOM           48        // cabecera PUBLISH delante de la carga (tópico < 40)
+
+#if (UPSTREAM_QUEUE_LEN & (UPSTREAM_QUEUE_LEN - 1)) != 0
+#error "UPSTREAM_QUEUE_LEN debe ser potencia de dos"
+#endif
+
+// ============================================================================
+// Publicador de fixes hacia un colector por la interfaz STA (el AP queda
+// para el portal). Sin él los fixes solo salen con un navegador en /data.
+// - El fix listener encola el fix ya codificado (BinFixRecord_t) con su
+//   hora de encolado; corre en el contexto del escritor del manager, así
+//   que es una copia en sección crítica. Con la cola llena se descarta el
+//   más antiguo (un colector quiere la posición actual, no la vieja).
+// - loop() arma un batch cuando hay UPSTREAM_BATCH_FIXES fixes o el más
+//   antiguo esperó UPSTREAM_FLUSH_MS, y lo envía por UDP (un datagrama) o
+//   como PUBLISH MQTT. Sin STA o con el envío fallido los fixes quedan en
+//   cola: la presión vuelve como descartes de los más antiguos.
+// - Un batch nunca pasa de RAW_BATCH_MAX bytes (sin fragmentar): el binario
+//   lleva hasta UPSTREAM_BATCH_MAX fixes y el JSON UPSTREAM_JSON_BATCH_MAX;
+//   lo que no entra queda para el siguiente.
+// - Latencia de publicación = encolado -> enviado (media exponencial y
+//   máximo). Eficiencia = bytes de fixes (27 por fix) / bytes en el aire
+//   (carga + cabeceras IP/UDP o IP/TCP estimadas, una trama por envío).
+// ============================================================================
+class UpstreamPublisher {
+public:
+    UpstreamPublisher();
+    void begin(PositioningManager& manager, const uint8_t mac[6]);
+    void loop();
+    void serve(AsyncWebServer& server);
+
+    // Publicación activa: habilitada y con destino
+    bool active() const { return _enabled.load(std::memory_order_relaxed) && _hasHost; }
+
+    // Contexto del escritor del manager (fix listener): encola un fix
+    void push(const TagFix& fix);
+
+    // Destino y formato (la web o UPSTREAM_* al compilar)
+    void setTarget(const IPAddress& host, uint16_t port, UpstreamProto proto);
+    void setFormat(UpstreamFormat format);
+    // Destino vigente; false si no hay (LinkProbe sondea este host)
+    bool target(IPAddress& host) const;
+
+    // Tamaño de batch e intervalo de flush (la web o el ajuste por enlace)
+    void setBatching(uint16_t batch_fixes, uint16_t flush_ms);
+    uint16_t batchFixes() const { return _batchFixes; }
+    uint16_t flushMs() const { return _flushMs; }
+
+    static const char* protoName(UpstreamProto proto) { return proto == UPSTREAM_MQTT ? "mqtt" : "udp"; }
+    static const char* formatName(UpstreamFormat format) { return format == UPSTREAM_JSON ? "json" : "bin"; }
+
+    // Contadores para /metrics
+    uint32_t queued() const { return _queued; }
+    uint32_t dropped() const { return _dropped; }
+    uint32_t published() const { return _published; }
+    uint32_t batches() const { return _batches; }
+    uint32_t sendErrors() const { return _sendErrors; }
+    uint32_t bytesSent() const { return _bytesSent; }
+    uint32_t depth() const;
+    float    latencyMs() const { return _latencyMs; }
+    uint32_t latencyMaxMs() const { return _latencyMaxMs; }
+    float    fixesPerBatch() const { return _batches ? (float)_published / _batches : 0.0f; }
+    float    efficiency() const;
+
+private:
+    struct Item {
+        BinFixRecord_t fix;
+        uint32_t       queued_ms;
+    };
+
+    uint16_t encode(uint16_t n, UpstreamFormat format, uint32_t now);
+    size_t send(size_t len, const IPAddress& host, uint16_t port, UpstreamProto proto);
+    bool mqttConnect(const IPAddress& host, uint16_t port);
+    size_t mqttPublish(size_t len);
+    void mqttKeepAlive();
+
+    // Cola circular con índices absolutos: tail - head = fixes en espera
+    Item     _queue[UPSTREAM_QUEUE_LEN];
+    uint32_t _head;           // más antiguo (lo avanzan loop() y los descartes)
+    uint32_t _tail;           // próximo a escribir (el listener)
+    mutable portMUX_TYPE _lock;
+
+    Item     _out[UPSTREAM_BATCH_MAX];   // copia del batch en armado (solo loop())
+    uint8_t  _buf[UPSTREAM_HEADROOM + RAW_BATCH_MAX];   // cabecera MQTT + carga
+    size_t   _len;            // carga en _buf + UPSTREAM_HEADROOM
+    RawBatchBuilder _batch;
+    uint32_t _source;
+    uint32_t _nextSeq;
+    char     _topic[40];
+
+    std::atomic<bool> _enabled;
+    // Destino y batching: los cambia la web y los lee loop() (bajo _lock)
+    IPAddress      _host;
+    uint16_t       _port;
+    UpstreamProto  _proto;
+    UpstreamFormat _format;
+    bool           _hasHost;
+    uint16_t       _batchFixes;
+    uint16_t       _flushMs;
+    WiFiUDP        _udp;
+    WiFiClient     _tcp;
+    uint32_t       _lastConnectMs;
+    uint32_t       _lastTxMs;     // MQTT: último paquete enviado (keepalive)
+    uint32_t       _retryMs;      // no reintentar antes de esto tras un fallo
+    bool           _retrying;
+    std::atomic<bool> _restart;   // destino cambiado: cerrar la conexión MQTT en loop()
+
+    uint32_t _queued;
+    uint32_t _dropped;
+    uint32_t _published;
+    uint32_t _batches;
+    uint32_t _sendErrors;
+    uint32_t _bytesSent;
+    uint32_t _wireBytes;          // carga + cabeceras estimadas
+    float    _latencyMs;
+    uint32_t _latencyMaxMs;
+};
+
+#endif // UPSTREAM_PUBLISHER_H
@@ -0,0 +1,162 @@
+#include "AnchorRegistry.h"
+#include "AsyncLog.h"
+
+AnchorRegistry::AnchorRegistry()
+    : _count(0), _mode(REGISTRY_LEARN), _clearRequested(false), _changedMs(0),
+      _unknown(0), _mismatch(0), _rejected(0), _learned(0) {}
+
+bool AnchorRegistry::begin() {
+    if (!LittleFS.begin(true)) {
+        DEBUG_PRINTLN("[REG] No se pudo montar LittleFS; registro de anclas solo en RAM.");
+        return false;
+    }
+    const bool loaded = load();
+    setMode(loaded && count() > 0 ? REGISTRY_ENFORCE : REGISTRY_LEARN);
+    DEBUG_PRINTF("[REG] Registro de anclas: %u MAC, modo %s\n", (unsigned)count(), modeName(mode()));
+    return loaded;
+}
+
+bool AnchorRegistry::read(size_t index, RegistryEntry& out) const {
+    if (index >= count()) return false;
+    return _entries[index].read(out);
+}
+
+void AnchorRegistry::markDirty() {
+    uint32_t now = millis();
+    if (now == 0) now = 1;
+    _changedMs.store(now, std::memory_order_release);
+}
+
+RegistryVerdict AnchorRegistry::check(const uint8_t* mac, uint16_t saddr) {
+    if (_clearRequested.load(std::memory_order_acquire)) {
+        _clearRequested.store(false, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_release);
+        markDirty();
+    }
+
+    const uint32_t hi = (uint32_t)mac[0] | ((uint32_t)mac[1] << 8) | ((uint32_t)mac[2] << 16) | ((uint32_t)mac[3] << 24);
+    const uint16_t lo = (uint16_t)(mac[4] | (mac[5] << 8));
+    const RegistryMode mode = this->mode();
+    const uint8_t n = _count.load(std::memory_order_relaxed);
+
+    for (uint8_t i = 0; i < n; i++) {
+        const RegistryEntry& e = _entries[i].peek();
+        if (e.mac_hi != hi || e.mac_lo != lo) continue;
+        if (e.saddr == saddr) return REGISTRY_ACCEPT;
+
+        // Ancla mal configurada o MAC reutilizada
+        _mismatch++;
+        if (mode == REGISTRY_LEARN) {
+            _entries[i].write({ hi, lo, saddr });
+            markDirty();
+            return REGISTRY_ACCEPT;
+        }
+        if (mode == REGISTRY_OPEN) return REGISTRY_ACCEPT;
+        _rejected++;
+        return REGISTRY_MISMATCH;
+    }
+
+    _unknown++;
+    if (mode == REGISTRY_LEARN && n < REGISTRY_MAX) {
+        _entries[n].write({ hi, lo, saddr });
+        _count.store(n + 1, std::memory_order_release);
+        _learned++;
+        markDirty();
+        // AsyncLog admite 6 argumentos: basta la parte de la MAC propia del equipo
+        LOG_I("[REG] Ancla 0x%X registrada (MAC ..:%02X:%02X:%02X:%02X)\n",
+              saddr, mac[2], mac[3], mac[4], mac[5]);
+        return REGISTRY_ACCEPT;
+    }
+    if (mode == REGISTRY_OPEN) return REGISTRY_ACCEPT;
+    _rejected++;
+    return REGISTRY_UNKNOWN;
+}
+
+// Escribe el registro cuando dejó de cambiar (fuera de la tarea Wi-Fi)
+void AnchorRegistry::loop() {
+    const uint32_t changed = _changedMs.load(std::memory_order_acquire);
+    if (changed == 0 || millis() - changed < REGISTRY_SAVE_MS) return;
+    // Si hubo otro cambio mientras se escribía, queda pendiente
+    uint32_t expected = changed;
+    if (save()) _changedMs.compare_exchange_strong(expected, 0);
+}
+
+bool AnchorRegistry::load() {
+    File f = LittleFS.open(REGISTRY_PATH, "r");
+    if (!f) return false;
+    RegistryFileHeader_t h;
+    bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == REGISTRY_MAGIC && h.count <= REGISTRY_MAX;
+    uint8_t n = 0;
+    while (ok && n < h.count) {
+        RegistryEntry e;
+        if (f.read((uint8_t*)&e, sizeof(e)) != sizeof(e)) break;
+        _entries[n++].write(e);
+    }
+    f.close();
+    _count.store(n, std::memory_order_release);
+    return ok;
+}
+
+bool AnchorRegistry::save() {
+    File f = LittleFS.open(REGISTRY_PATH, "w");
+    if (!f) return false;
+    RegistryFileHeader_t h = { REGISTRY_MAGIC, 0 };
+    RegistryEntry entries[REGISTRY_MAX];
+    const size_t n = count();
+    for (size_t i = 0; i < n; i++) {
+        if (read(i, entries[h.count])) h.count++;
+    }
+    bool ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    ok = ok && f.write((const uint8_t*)entries, h.count * sizeof(RegistryEntry)) == h.count * sizeof(RegistryEntry);
+    f.close();
+    return ok;
+}
+
+const char* AnchorRegistry::modeName(RegistryMode mode) {
+    switch (mode) {
+        case REGISTRY_OPEN:    return "open";
+        case REGISTRY_LEARN:   return "learn";
+        default:               return "enforce";
+    }
+}
+
+bool AnchorRegistry::parseMode(const char* name, RegistryMode& out) {
+    static const RegistryMode modes[] = { REGISTRY_OPEN, REGISTRY_LEARN, REGISTRY_ENFORCE };
+    for (RegistryMode m : modes) {
+        if (strcmp(name, modeName(m)) == 0) { out = m; return true; }
+    }
+    return false;
+}
+
+void AnchorRegistry::serve(AsyncWebServer& server) {
+    // /registry?mode=open|learn|enforce&clear=1: consulta o cambia el registro
+    server.on("/registry", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("mode")) {
+            RegistryMode m;
+            if (!parseMode(request->getParam("mode")->value().c_str(), m)) {
+                return request->send(400, "text/plain", "Modo desconocido");
+            }
+            setMode(m);
+        }
+        const bool clearing = request->hasParam("clear") && request->getParam("clear")->value().toInt() != 0;
+        if (clearing) requestClear();
+
+        AsyncResponseStream* response = request->beginResponseStream("application/json");
+        response->printf("{\"mode\":\"%s\",\"clear_pending\":%s,\"learned\":%lu,\"unknown\":%lu,"
+                         "\"mismatch\":%lu,\"rejected\":%lu,\"anchors\":[",
+                         modeName(mode()), clearing ? "true" : "false", (unsigned long)_learned,
+                         (unsigned long)_unknown, (unsigned long)_mismatch, (unsigned long)_rejected);
+        RegistryEntry e;
+        bool first = true;
+        for (size_t i = 0; i < count(); i++) {
+            if (!read(i, e)) continue;
+            response->printf("%s{\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"saddr\":\"%x\"}", first ? "" : ",",
+                             (unsigned)(e.mac_hi & 0xFF), (unsigned)((e.mac_hi >> 8) & 0xFF),
+                             (unsigned)((e.mac_hi >> 16) & 0xFF), (unsigned)(e.mac_hi >> 24),
+                             (unsigned)(e.mac_lo & 0xFF), (unsigned)(e.mac_lo >> 8), e.saddr);
+            first = false;
+        }
+        response->print("]}");
+        request->send(response);
+    });
+}
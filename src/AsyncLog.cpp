@@ -0,0 +1,187 @@
+#include "AsyncLog.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static inline uint32_t log_now_ms() { return millis(); }
+static inline void log_write(const char* s, size_t n) { Serial.write((const uint8_t*)s, n); }
+#else
+#include <chrono>
+static inline uint32_t log_now_ms() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline void log_write(const char* s, size_t n) { fwrite(s, 1, n, stdout); }
+#endif
+
+AsyncLog asyncLog;
+
+AsyncLog::AsyncLog()
+    : _enqueuePos(0), _dequeuePos(0), _level(ASYNCLOG_MAX_LEVEL), _overruns(0), _reportedOverruns(0) {
+    for (uint32_t i = 0; i < ASYNCLOG_RING_SIZE; i++) _cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+void AsyncLog::begin() {
+#ifdef ARDUINO
+    xTaskCreatePinnedToCore(taskMain, "asynclog", ASYNCLOG_TASK_STACK, this, ASYNCLOG_TASK_PRIO, nullptr, ARDUINO_RUNNING_CORE);
+#endif
+}
+
+void AsyncLog::taskMain(void* arg) {
+#ifdef ARDUINO
+    AsyncLog* self = (AsyncLog*)arg;
+    for (;;) {
+        if (self->drain() == 0) vTaskDelay(pdMS_TO_TICKS(10));
+    }
+#else
+    (void)arg;
+#endif
+}
+
+// Productor: reserva una celda con CAS sobre _enqueuePos. Una celda está
+// libre cuando su seq coincide con la posición; si va atrasada, el anillo
+// está lleno y el mensaje se descarta.
+void AsyncLog::push(LogEntry& e) {
+    e.t_ms = log_now_ms();
+    uint32_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = _cells[pos & (ASYNCLOG_RING_SIZE - 1)];
+        const uint32_t seq = cell.seq.load(std::memory_order_acquire);
+        const int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.entry = e;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        } else if (diff < 0) {
+            _overruns.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Consumidor único (la tarea de drenado)
+bool AsyncLog::pop(LogEntry& out) {
+    Cell& cell = _cells[_dequeuePos & (ASYNCLOG_RING_SIZE - 1)];
+    const uint32_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq != _dequeuePos + 1) return false;
+    out = cell.entry;
+    cell.seq.store(_dequeuePos + ASYNCLOG_RING_SIZE, std::memory_order_release);
+    _dequeuePos++;
+    return true;
+}
+
+size_t AsyncLog::drain() {
+    char line[ASYNCLOG_LINE_MAX];
+    size_t count = 0;
+
+    const uint32_t overruns = _overruns.load(std::memory_order_relaxed);
+    if (overruns != _reportedOverruns) {
+        const int n = snprintf(line, sizeof(line), "[LOG] %lu mensajes descartados (anillo lleno)\n",
+                               (unsigned long)(overruns - _reportedOverruns));
+        if (n > 0) log_write(line, (size_t)n < sizeof(line) ? n : sizeof(line) - 1);
+        _reportedOverruns = overruns;
+    }
+
+    LogEntry e;
+    while (pop(e)) {
+        const size_t n = format(e, line, sizeof(line));
+        log_write(line, n);
+        count++;
+    }
+    return count;
+}
+
+// Recorre el formato y aplica cada conversión con snprintf sobre el
+// argumento guardado. Los modificadores de largo del original se ignoran:
+// el tipo real viene de LogEntry::types.
+size_t AsyncLog::format(const LogEntry& e, char* out, size_t len) const {
+    size_t used = 0;
+    uint8_t arg = 0;
+    const char* p = e.fmt;
+
+    auto put = [&](int n) {
+        if (n > 0) used += ((size_t)n < len - used) ? (size_t)n : len - used - 1;
+    };
+
+    while (*p && used + 1 < len) {
+        if (*p != '%') { out[used++] = *p++; continue; }
+        if (p[1] == '%') { out[used++] = '%'; p += 2; continue; }
+
+        // %[flags][ancho][.precisión][largo]conversión
+        char spec[16];
+        size_t s = 0;
+        spec[s++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && s < sizeof(spec) - 4) spec[s++] = *p++;
+        while (*p && strchr("hlLzjt", *p)) p++;
+        const char conv = *p ? *p++ : 'd';
+
+        if (arg >= e.nargs) break;
+        const uint8_t type = e.types[arg];
+        const LogValue& v = e.args[arg++];
+
+        switch (conv) {
+        case 'd': case 'i': {
+            spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            long long x;
+            switch (type) {
+                case LOG_ARG_I32: x = (int32_t)v.i; break;
+                case LOG_ARG_U32: x = (uint32_t)v.u; break;
+                case LOG_ARG_U64: x = (long long)v.u; break;
+                case LOG_ARG_F64: x = (long long)v.d; break;
+                default:          x = v.i; break;
+            }
+            put(snprintf(out + used, len - used, spec, x));
+            break;
+        }
+        case 'u': case 'x': case 'X': case 'o': case 'c': {
+            if (conv == 'c') { spec[s++] = 'c'; spec[s] = '\0'; put(snprintf(out + used, len - used, spec, (int)v.i)); break; }
+            spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            // Un int negativo impreso con %u/%x se ve como en printf (32 bits)
+            unsigned long long x = (type == LOG_ARG_I32 || type == LOG_ARG_U32) ? (uint32_t)v.u : v.u;
+            put(snprintf(out + used, len - used, spec, x));
+            break;
+        }
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+            spec[s++] = conv; spec[s] = '\0';
+            const double x = (type == LOG_ARG_F64) ? v.d : (double)v.i;
+            put(snprintf(out + used, len - used, spec, x));
+            break;
+        }
+        case 's':
+            spec[s++] = 's'; spec[s] = '\0';
+            put(snprintf(out + used, len - used, spec, type == LOG_ARG_STR && v.p ? (const char*)v.p : "(null)"));
+            break;
+        case 'p':
+            spec[s++] = 'p'; spec[s] = '\0';
+            put(snprintf(out + used, len - used, spec, v.p));
+            break;
+        default:
+            break;
+        }
+    }
+    out[used] = '\0';
+    return used;
+}
+
+const char* AsyncLog::levelName(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR: return "error";
+        case LOG_LEVEL_WARN:  return "warn";
+        case LOG_LEVEL_INFO:  return "info";
+        case LOG_LEVEL_DEBUG: return "debug";
+        default:              return "off";
+    }
+}
+
+bool AsyncLog::parseLevel(const char* name, LogLevel& out) {
+    static const LogLevel levels[] = { LOG_LEVEL_OFF, LOG_LEVEL_ERROR, LOG_LEVEL_WARN, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG };
+    for (LogLevel l : levels) {
+        if (strcmp(name, levelName(l)) == 0) { out = l; return true; }
+    }
+    return false;
+}
@@ -0,0 +1,261 @@
+#include "DataJsonWriter.h"
+#include <cmath>
+
+DataJsonWriter::DataJsonWriter(const PositioningManager& manager, uint32_t since, uint32_t boot)
+    : _manager(manager), _since(since), _boot(boot), _version(0), _skipped(false), _phase(PH_HEAD), _first(true),
+      _nextKey(0), _now(0) {}
+
+// Prepara en _piece el siguiente fragmento del documento
+bool DataJsonWriter::nextPiece() {
+    int n = 0;
+
+    switch (_phase) {
+    case PH_HEAD: {
+        // La versión se toma antes de recorrer las casillas (nada posterior se
+        // pierde) pero se emite al final, cuando se sabe si hubo que saltear alguna
+        _version = _manager.getVersion();
+        const Point pos = _manager.getLastTagPosition();
+        n = snprintf(_piece, sizeof(_piece),
+            "{\"boot\":%lu,\"since\":%lu,\"tag_position\":{\"x\":%.3f,\"y\":%.3f,\"z\":%.3f},\"anchors\":{",
+            (unsigned long)_boot, (unsigned long)_since, pos.x, pos.y, pos.z);
+        _phase = PH_ANCHORS;
+        _first = true;
+        _nextKey = 0;
+        _now = millis();
+        break;
+    }
+    case PH_ANCHORS: {
+        AnchorEntry e;
+        bool found = false;
+        while (_nextKey < _manager.anchorCount()) {
+            if (!_manager.readAnchor(_nextKey++, e)) { _skipped = true; continue; }
+            if (e.version > _since) { found = true; break; }
+        }
+        if (!found) {
+            _phase = PH_TAGS_OPEN;
+            return nextPiece();
+        }
+        const DecodedAnchorReport_t& d = e.report;
+        n = snprintf(_piece, sizeof(_piece),
+            "%s\"%x\":{\"anchor_saddr\":%u,\"tag_uid\":%lu,\"seq\":%u,\"range_m\":%.3f,"
+            "\"temp\":%.2f,\"aSQ\":%.3f,\"rxpacc\":%u,\"std_noise\":%u,\"cir_pwr\":%u",
+            _first ? "" : ",", d.anchor_saddr, d.anchor_saddr, (unsigned long)d.tag_uid, d.seq,
+            d.range_m, d.temp, d.aSQ, d.rxpacc, d.std_noise, d.cir_pwr);
+        _first = false;
+        _anchor = e;
+        _phase = PH_ANCHOR_STATS;
+        break;
+    }
+    case PH_ANCHOR_STATS: {
+        // Segunda mitad del objeto: salud del ancla (no cabe en un fragmento)
+        const AnchorStats& st = _anchor.stats;
+        n = snprintf(_piece, sizeof(_piece),
+            ",\"online\":%s,\"age_ms\":%lu,\"rate_hz\":%.2f,\"participation\":%.3f,\"range_mean\":%.3f,"
+            "\"range_std\":%.3f,\"noise_mean\":%.1f,\"cir_mean\":%.1f,\"rssi\":%.1f,"
+            "\"latency_ms\":%.1f,\"clock_offset_ms\":%ld,\"drift_ppm\":%.1f}",
+            _anchor.staleAt(_now) ? "false" : "true", (unsigned long)(_now - _anchor.report.rx_ms),
+            st.rateHz(), st.participationAt(_manager.closedSequences()), st.range_mean, sqrtf(st.range_var),
+            st.noise_mean, st.cir_mean, st.rssi_dbm,
+            st.latency_ms, (long)st.clock_offset_ms, st.clock_drift_ppm);
+        _phase = PH_ANCHORS;
+        break;
+    }
+    case PH_TAGS_OPEN:
+        n = snprintf(_piece, sizeof(_piece), "},\"tags\":{");
+        _phase = PH_TAGS;
+        _first = true;
+        _nextKey = 0;
+        break;
+    case PH_TAGS: {
+        // Un tag figura desde su primer fix; cambia si cambió el fix o la telemetría
+        TagFix f;
+        bool found = false;
+        while (_nextKey < _manager.tagCount()) {
+            const size_t index = _nextKey++;
+            if (!_manager.readTag(index, f)) { _skipped = true; continue; }
+            if (f.version == 0) continue;
+            if (!_manager.readTagTelemetry(index, _telemetry)) {
+                _skipped = true;
+                _telemetry = TagTelemetryEntry();
+            }
+            if (f.version > _since || _telemetry.version > _since) { found = true; break; }
+        }
+        if (!found) {
+            _phase = PH_TAIL;
+            return nextPiece();
+        }
+        n = snprintf(_piece, sizeof(_piece),
+            "%s\"%lx\":{\"tag_uid\":%lu,\"seq\":%u,\"x\":%.3f,\"y\":%.3f,\"z\":%.3f,"
+            "\"rms\":%.3f,\"anchors\":%u,\"is3D\":%s,\"t_ms\":%lu",
+            _first ? "" : ",", (unsigned long)f.tag_uid, (unsigned long)f.tag_uid, f.seq,
+            f.pos.x, f.pos.y, f.pos.z, f.rms, f.anchors, f.is3D ? "true" : "false",
+            (unsigned long)f.t_ms);
+        _first = false;
+        _phase = PH_TAG_TELEMETRY;
+        break;
+    }
+    case PH_TAG_TELEMETRY: {
+        _phase = PH_TAGS;
+        if (_telemetry.version == 0) {
+            n = snprintf(_piece, sizeof(_piece), "}");
+            break;
+        }
+        DecodedAnchorReport_t d = {};
+        unpack_tag_telemetry(_telemetry.data, d);
+        for (char* c = d.etiqueta; *c; c++) if (*c == '"' || *c == '\\' || (uint8_t)*c < 0x20) *c = '?';
+        n = snprintf(_piece, sizeof(_piece),
+            ",\"telemetry\":{\"seq\":%u,\"age_ms\":%lu,\"ts\":\"%04u-%02u-%02uT%02u:%02u:%02u.%03u\","
+            "\"epoch_ms\":%llu,\"temp\":%.2f,\"hum\":%.2f,\"aSQ\":%.3f,\"mDir\":%.1f,\"etiqueta\":\"%s\"}}",
+            _telemetry.seq, (unsigned long)((int32_t)(_now - _telemetry.rx_ms) > 0 ? _now - _telemetry.rx_ms : 0),
+            d.year, d.month, d.day, d.hour, d.minute, d.second, d.millis,
+            (unsigned long long)_telemetry.epoch_ms, d.temp, d.hum, d.aSQ, d.mDir, d.etiqueta);
+        break;
+    }
+    case PH_TAIL:
+        // Una casilla que el lector no pudo leer (el seqlock se rindió) quedó
+        // fuera: se devuelve since para que el cliente la vuelva a pedir
+        n = snprintf(_piece, sizeof(_piece), "},\"version\":%lu}", (unsigned long)(_skipped ? _since : _version));
+        _phase = PH_DONE;
+        break;
+    case PH_DONE:
+        return false;
+    }
+
+    return setPiece(n);
+}
+
+TrailJsonWriter::TrailJsonWriter(const TrailBuffer& trails)
+    : _trails(trails), _phase(PH_HEAD), _first(true), _index(0), _point(0), _trail() {}
+
+bool TrailJsonWriter::nextPiece() {
+    int n = 0;
+
+    switch (_phase) {
+    case PH_HEAD:
+        n = snprintf(_piece, sizeof(_piece), "{\"length\":%u,\"tags\":{", (unsigned)TRAIL_LENGTH);
+        _phase = PH_TAG;
+        break;
+    case PH_TAG: {
+        bool found = false;
+        while (_index < _trails.count()) {
+            if (_trails.read(_index++, _trail) && _trail.count > 0) { found = true; break; }
+        }
+        if (!found) {
+            _phase = PH_TAIL;
+            return nextPiece();
+        }
+        n = snprintf(_piece, sizeof(_piece), "%s\"%lx\":[",
+                     _first ? "" : ",", (unsigned long)_trail.tag_uid);
+        _first = false;
+        _point = 0;
+        _phase = PH_POINTS;
+        break;
+    }
+    case PH_POINTS: {
+        // Varios puntos por fragmento; el más antiguo está en head - count.
+        // Siempre queda lugar para el "]" de cierre: un punto que no entra
+        // entero se descarta del fragmento y va al siguiente.
+        size_t used = 0;
+        while (_point < _trail.count) {
+            const uint8_t idx = (uint8_t)((_trail.head + TRAIL_LENGTH - _trail.count + _point) % TRAIL_LENGTH);
+            const TrailPoint& p = _trail.points[idx];
+            const size_t room = sizeof(_piece) - used - 1;
+            const int w = snprintf(_piece + used, room, "%s[%d,%d,%d]", _point ? "," : "", p.x_cm, p.y_cm, p.z_cm);
+            if (w < 0 || (size_t)w >= room) {
+                _piece[used] = '\0';
+                break;
+            }
+            used += (size_t)w;
+            _point++;
+        }
+        if (_point >= _trail.count) {
+            used += snprintf(_piece + used, sizeof(_piece) - used, "]");
+            _phase = PH_TAG;
+        }
+        n = (int)used;
+        break;
+    }
+    case PH_TAIL:
+        n = snprintf(_piece, sizeof(_piece), "}}");
+        _phase = PH_DONE;
+        break;
+    case PH_DONE:
+        return false;
+    }
+
+    return setPiece(n);
+}
+
+HistoryJsonWriter::HistoryJsonWriter(const FixHistory& history, uint32_t tag_uid, uint32_t from_ms, uint32_t to_ms)
+    : _history(history), _tag(tag_uid), _from(from_ms), _to(to_ms), _phase(PH_HEAD), _first(true),
+      _slot(-1), _index(0), _end(0), _q(0), _atBase(true), _lost(0) {}
+
+// Vuelve a la base publicada tras una sobrescritura; false si la casilla ya
+// pertenece a otro tag
+bool HistoryJsonWriter::resync() {
+    HistoryHeader h;
+    if (!_history.readHeader(_slot, h) || h.tag_uid != _tag) return false;
+    if (h.first > _index) {
+        _lost += h.first - _index;
+        _index = h.first;
+    }
+    _q = h.base_q;
+    _atBase = true;
+    return true;
+}
+
+bool HistoryJsonWriter::nextPiece() {
+    int n = 0;
+
+    switch (_phase) {
+    case PH_HEAD: {
+        HistoryHeader h;
+        _slot = _history.findTag(_tag, h);
+        if (_slot >= 0) {
+            _index  = h.first;
+            _end    = h.next;
+            _q      = h.base_q;
+            _atBase = true;
+        }
+        n = snprintf(_piece, sizeof(_piece),
+            "{\"tag\":\"%lx\",\"from\":%lu,\"to\":%lu,\"resolution_ms\":%u,\"fixes\":[",
+            (unsigned long)_tag, (unsigned long)_from, (unsigned long)_to, (unsigned)HISTORY_TIME_RES_MS);
+        _phase = (_slot >= 0) ? PH_FIXES : PH_TAIL;
+        break;
+    }
+    case PH_FIXES: {
+        // Varios fixes por fragmento; los anteriores a "from" se saltan
+        size_t used = 0;
+        HistoryRecord_t r;
+        while (_index < _end && used + 56 < sizeof(_piece)) {
+            if (!_history.readRecord(_slot, _index, r)) {
+                if (!resync()) { _index = _end; break; }
+                continue;
+            }
+            if (!_atBase) _q += r.dt;
+            _atBase = false;
+            _index++;
+
+            const uint32_t t = _q * HISTORY_TIME_RES_MS;
+            if (t < _from) continue;
+            if (t > _to) { _index = _end; break; }
+            used += snprintf(_piece + used, sizeof(_piece) - used, "%s[%lu,%d,%d,%d,%u,%u,%u]",
+                             _first ? "" : ",", (unsigned long)t, r.x_cm, r.y_cm, r.z_cm, r.rms_cm,
+                             r.info & 0x7F, (r.info & HISTORY_INFO_3D) ? 1 : 0);
+            _first = false;
+        }
+        if (_index >= _end) _phase = PH_TAIL;
+        if (used == 0) return nextPiece();
+        n = (int)used;
+        break;
+    }
+    case PH_TAIL:
+        n = snprintf(_piece, sizeof(_piece), "],\"lost\":%lu}", (unsigned long)_lost);
+        _phase = PH_DONE;
+        break;
+    case PH_DONE:
+        return false;
+    }
+
+    return setPiece(n);
+}
@@ -0,0 +1,101 @@
+#include "FixHistory.h"
+
+FixHistory::FixHistory() : _ring(), _work(), _lastMs(), _count(0) {
+    for (auto& h : _head) h.store(0, std::memory_order_relaxed);
+}
+
+void FixHistory::attach(PositioningManager& manager) {
+    manager.addFixListener([this](const TagFix& fix) { addFix(fix); });
+}
+
+void FixHistory::addFix(const TagFix& fix) {
+    const uint8_t n = _count.load(std::memory_order_relaxed);
+
+    // Casilla del tag; si no existe, una libre o la menos reciente
+    int slot = -1;
+    for (uint8_t i = 0; i < n; i++) {
+        if (_work[i].tag_uid == fix.tag_uid) { slot = i; break; }
+    }
+    if (slot < 0) {
+        if (n < HISTORY_TAGS) {
+            slot = n;
+        } else {
+            slot = 0;
+            for (uint8_t i = 1; i < HISTORY_TAGS; i++) {
+                if ((int32_t)(_lastMs[i] - _lastMs[slot]) < 0) slot = i;
+            }
+        }
+        // Los índices siguen desde donde quedaron: un lector del tag anterior
+        // nunca confunde sus registros con los del nuevo
+        HistoryHeader& h = _work[slot];
+        h.tag_uid = fix.tag_uid;
+        h.first   = h.next;
+    }
+
+    HistoryHeader& h = _work[slot];
+    uint32_t q = fix.t_ms / HISTORY_TIME_RES_MS;
+    uint32_t dt = 0;
+    if (h.next == h.first) {
+        h.base_q = q;
+    } else {
+        // t_ms es el momento de la medición: una secuencia resuelta fuera de
+        // orden queda con el tiempo de la anterior (los deltas no retroceden)
+        if ((int32_t)(q - h.last_q) < 0) q = h.last_q;
+        dt = q - h.last_q;
+        if (dt > 0xFFFF) {
+            h.base_q += dt - 0xFFFF;
+            dt = 0xFFFF;
+        }
+    }
+
+    HistoryRecord_t r;
+    r.x_cm   = clamp_i16(fix.pos.x * 100.0f);
+    r.y_cm   = clamp_i16(fix.pos.y * 100.0f);
+    r.z_cm   = clamp_i16(fix.pos.z * 100.0f);
+    r.dt     = (uint16_t)dt;
+    r.rms_cm = (uint8_t)((fix.rms * 100.0f) < 255.0f ? lroundf(fix.rms * 100.0f) : 255);
+    r.info   = (uint8_t)((fix.anchors & 0x7F) | (fix.is3D ? HISTORY_INFO_3D : 0));
+
+    // Anillo lleno: se descarta el más antiguo y su sucesor pasa a ser la base
+    if (h.next - h.first == HISTORY_DEPTH) {
+        h.first++;
+        h.base_q += _ring[slot][h.first % HISTORY_DEPTH].dt;
+    }
+
+    // Se anuncia el registro antes de escribirlo para que un lector que
+    // esté copiando esa posición detecte la sobrescritura
+    _head[slot].store(h.next + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&_ring[slot][h.next % HISTORY_DEPTH], &r, sizeof(r));
+    h.next++;
+    h.last_q = q;
+    _lastMs[slot] = fix.t_ms;
+
+    _headers[slot].write(h);
+    if (slot == n) _count.store((uint8_t)(n + 1), std::memory_order_release);
+}
+
+size_t FixHistory::count() const {
+    return _count.load(std::memory_order_acquire);
+}
+
+bool FixHistory::readHeader(size_t slot, HistoryHeader& out) const {
+    if (slot >= count()) return false;
+    return _headers[slot].read(out);
+}
+
+int FixHistory::findTag(uint32_t tag_uid, HistoryHeader& out) const {
+    for (size_t i = 0; i < count(); i++) {
+        if (readHeader(i, out) && out.tag_uid == tag_uid) return (int)i;
+    }
+    return -1;
+}
+
+// Copia el registro "index"; false si el escritor lo sobrescribió (el
+// lector se atrasó más de HISTORY_DEPTH fixes) y hay que releer la cabecera
+bool FixHistory::readRecord(size_t slot, uint32_t index, HistoryRecord_t& out) const {
+    memcpy(&out, &_ring[slot][index % HISTORY_DEPTH], sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t head = _head[slot].load(std::memory_order_relaxed);
+    return (head - index) <= HISTORY_DEPTH;
+}
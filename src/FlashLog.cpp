@@ -0,0 +1,239 @@
+#include "FlashLog.h"
+#include <memory>
+#include <esp_rom_crc.h>
+#include "StreamCodec.h"
+
+FlashLog::FlashLog()
+    : _len(), _sealed(), _active(0), _blockStartMs(0), _ready(false),
+      _logReports(FLASHLOG_RAW_REPORTS), _segmentSize(0), _firstSegment(0), _nextSegment(0),
+      _bytesWritten(0), _blocksWritten(0), _dropped(0), _writeErrors(0), _maxWriteUs(0),
+      _stagedHighWater(0) {
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool FlashLog::begin(PositioningManager& manager) {
+    if (!LittleFS.begin(true)) {
+        DEBUG_PRINTLN("[LOG] No se pudo montar LittleFS; log en flash desactivado.");
+        return false;
+    }
+    if (!LittleFS.exists(FLASHLOG_DIR)) LittleFS.mkdir(FLASHLOG_DIR);
+
+    // Continúa la numeración de los segmentos existentes
+    bool found = false;
+    File dir = LittleFS.open(FLASHLOG_DIR);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        const char* name = strrchr(f.name(), '/');
+        name = name ? name + 1 : f.name();
+        const uint32_t n = strtoul(name, nullptr, 10);
+        if (!found || n < _firstSegment) _firstSegment = n;
+        if (!found || n >= _nextSegment) _nextSegment = n + 1;
+        found = true;
+    }
+    dir.close();
+
+    if (!openSegment()) return false;
+    _ready = true;
+    manager.addFixListener([this](const TagFix& fix) { logFix(fix); });
+    DEBUG_PRINTF("[LOG] Log en flash: segmentos %lu..%lu\n",
+                 (unsigned long)_firstSegment, (unsigned long)(_nextSegment - 1));
+    return true;
+}
+
+String FlashLog::segmentPath(uint32_t segment) const {
+    char path[32];
+    snprintf(path, sizeof(path), FLASHLOG_DIR "/%08lu.bin", (unsigned long)segment);
+    return String(path);
+}
+
+void FlashLog::logFix(const TagFix& fix) {
+    LogFixRecord_t r;
+    r.t_ms    = fix.t_ms;
+    r.tag_uid = fix.tag_uid;
+    r.seq     = fix.seq;
+    r.x_mm    = meters_to_mm(fix.pos.x);
+    r.y_mm    = meters_to_mm(fix.pos.y);
+    r.z_mm    = meters_to_mm(fix.pos.z);
+    r.rms_mm  = clamp_u16(fix.rms * 1000.0f);
+    r.anchors = fix.anchors;
+    r.flags   = fix.is3D ? 0x01 : 0;
+    append(LOG_REC_FIX, &r, sizeof(r));
+}
+
+void FlashLog::logReport(const AnchorRangeReport_t& report, uint32_t rx_ms) {
+    if (!_logReports) return;
+    LogReportRecord_t r;
+    r.rx_ms  = rx_ms;
+    r.report = report;
+    append(LOG_REC_REPORT, &r, sizeof(r));
+}
+
+// Tarea Wi-Fi: copia el registro al buffer activo
+void FlashLog::append(LogRecordType type, const void* payload, uint8_t len) {
+    if (!_ready) return;
+    const size_t need = 2 + len;
+
+    portENTER_CRITICAL(&_lock);
+    if (_len[_active] + need > FLASHLOG_BLOCK_SIZE && !sealActive()) {
+        _dropped++;
+        portEXIT_CRITICAL(&_lock);
+        return;
+    }
+    if (_len[_active] == 0) _blockStartMs = millis();
+    uint8_t* p = _buf[_active] + _len[_active];
+    p[0] = type;
+    p[1] = len;
+    memcpy(p + 2, payload, len);
+    _len[_active] += need;
+    if (_len[0] + _len[1] > _stagedHighWater) _stagedHighWater = _len[0] + _len[1];
+    portEXIT_CRITICAL(&_lock);
+}
+
+// Con _lock tomado: sella el buffer activo y pasa al otro si está libre
+bool FlashLog::sealActive() {
+    const uint8_t other = _active ^ 1;
+    if (_sealed[other]) return false;
+    _sealed[_active] = true;
+    _active = other;
+    return true;
+}
+
+void FlashLog::loop() {
+    if (!_ready) return;
+
+    int pending = -1;
+    portENTER_CRITICAL(&_lock);
+    // Un bloque a medio llenar no se retiene indefinidamente en RAM
+    if (_len[_active] > 0 && millis() - _blockStartMs >= FLASHLOG_FLUSH_MS) sealActive();
+    for (uint8_t i = 0; i < 2; i++) {
+        if (_sealed[i]) pending = i;
+    }
+    portEXIT_CRITICAL(&_lock);
+    if (pending < 0) return;
+
+    // Solo un buffer puede estar sellado a la vez: la tarea Wi-Fi no lo toca
+    writeBlock(_buf[pending], _len[pending]);
+
+    portENTER_CRITICAL(&_lock);
+    _len[pending] = 0;
+    _sealed[pending] = false;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void FlashLog::writeBlock(const uint8_t* data, size_t len) {
+    if (_segmentSize + len > FLASHLOG_SEGMENT_SIZE && !openSegment()) {
+        _writeErrors++;
+        return;
+    }
+
+    const uint32_t t0 = micros();
+    const size_t n = _file.write(data, len);
+    _file.flush();
+    const uint32_t dt = micros() - t0;
+    if (dt > _maxWriteUs) _maxWriteUs = dt;
+
+    if (n != len) _writeErrors++;
+    _segmentSize   += n;
+    _bytesWritten  += n;
+    _blocksWritten++;
+}
+
+// Cierra el segmento actual y abre el siguiente con su cabecera confirmada
+bool FlashLog::openSegment() {
+    if (_file) _file.close();
+
+    _file = LittleFS.open(segmentPath(_nextSegment), "w");
+    if (!_file) {
+        DEBUG_PRINTLN("[LOG] No se pudo crear el segmento.");
+        _ready = false;
+        return false;
+    }
+
+    LogSegmentHeader_t h;
+    h.magic      = FLASHLOG_MAGIC;
+    h.version    = FLASHLOG_VERSION;
+    h.header_len = sizeof(LogSegmentHeader_t);
+    h.segment    = _nextSegment;
+    h.created_ms = millis();
+    h.block_size = FLASHLOG_BLOCK_SIZE;
+    h.crc32      = esp_rom_crc32_le(0, (const uint8_t*)&h, offsetof(LogSegmentHeader_t, crc32));
+    _file.write((const uint8_t*)&h, sizeof(h));
+    _file.flush();
+
+    _segmentSize = sizeof(h);
+    _nextSegment++;
+    pruneSegments();
+    return true;
+}
+
+// Respeta FLASHLOG_MAX_SEGMENTS y deja espacio para un segmento más
+void FlashLog::pruneSegments() {
+    while (_nextSegment - _firstSegment > 1 &&
+           (_nextSegment - _firstSegment > FLASHLOG_MAX_SEGMENTS ||
+            LittleFS.totalBytes() - LittleFS.usedBytes() < FLASHLOG_SEGMENT_SIZE)) {
+        LittleFS.remove(segmentPath(_firstSegment));
+        _firstSegment++;
+    }
+}
+
+// Descarga secuencial de todos los segmentos, un archivo tras otro
+struct FlashLogReader {
+    uint32_t segment;
+    uint32_t end;
+    File     file;
+};
+
+void FlashLog::serve(AsyncWebServer& server) {
+    // /log/download?seg=<n>: un segmento; sin "seg", todos concatenados.
+    // Se registra antes que /log, que también atendería este prefijo.
+    server.on("/log/download", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("seg")) {
+            const String path = segmentPath(strtoul(request->getParam("seg")->value().c_str(), nullptr, 10));
+            if (!LittleFS.exists(path)) return request->send(404, "text/plain", "Segmento inexistente");
+            return request->send(LittleFS, path, "application/octet-stream", true);
+        }
+
+        auto reader = std::make_shared<FlashLogReader>();
+        reader->segment = _firstSegment;
+        reader->end     = _nextSegment;
+        AsyncWebServerResponse* response = request->beginChunkedResponse("application/octet-stream",
+            [this, reader](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                while (reader->segment < reader->end) {
+                    if (!reader->file) {
+                        reader->file = LittleFS.open(segmentPath(reader->segment), "r");
+                        if (!reader->file) { reader->segment++; continue; }
+                    }
+                    const size_t n = reader->file.read(buffer, maxLen);
+                    if (n > 0) return n;
+                    reader->file.close();
+                    reader->file = File();
+                    reader->segment++;
+                }
+                return 0;
+            });
+        response->addHeader("Content-Disposition", "attachment; filename=\"fixes.log\"");
+        request->send(response);
+    });
+
+    // Estado del log y segmentos disponibles; /log?raw=0|1 activa los reportes crudos
+    server.on("/log", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("raw")) _logReports = request->getParam("raw")->value().toInt() != 0;
+
+        AsyncResponseStream* response = request->beginResponseStream("application/json");
+        response->printf("{\"ready\":%s,\"raw\":%s,\"bytes_written\":%lu,\"blocks_written\":%lu,"
+                         "\"dropped\":%lu,\"write_errors\":%lu,\"max_write_us\":%lu,\"segments\":[",
+                         _ready ? "true" : "false", _logReports ? "true" : "false",
+                         (unsigned long)_bytesWritten, (unsigned long)_blocksWritten,
+                         (unsigned long)_dropped, (unsigned long)_writeErrors, (unsigned long)_maxWriteUs);
+        bool first = true;
+        for (uint32_t s = _firstSegment; s < _nextSegment; s++) {
+            File f = LittleFS.open(segmentPath(s), "r");
+            if (!f) continue;
+            response->printf("%s{\"seg\":%lu,\"size\":%u}", first ? "" : ",",
+                             (unsigned long)s, (unsigned)f.size());
+            f.close();
+            first = false;
+        }
+        response->print("]}");
+        request->send(response);
+    });
+}
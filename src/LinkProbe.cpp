@@ -0,0 +1,161 @@
+#include "LinkProbe.h"
+#include <ESP32Ping.h>
+#include "AsyncLog.h"
+
+static const float LINK_RTT_LE[]  = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+static const float LINK_LOSS_LE[] = { 0, 0.05f, 0.1f, 0.2f, 0.5f };
+
+// Batching del publicador por nivel (UNKNOWN y FAIR: los valores de compilación)
+struct LinkBatching {
+    uint16_t batch_fixes;
+    uint16_t flush_ms;
+};
+static const LinkBatching LINK_BATCHING[] = {
+    { UPSTREAM_BATCH_FIXES, UPSTREAM_FLUSH_MS },   // LINK_UNKNOWN
+    { 8,                    50 },                  // LINK_GOOD
+    { UPSTREAM_BATCH_FIXES, UPSTREAM_FLUSH_MS },   // LINK_FAIR
+    { UPSTREAM_BATCH_MAX,   250 },                 // LINK_POOR
+    { UPSTREAM_BATCH_MAX,   1000 },                // LINK_DOWN
+};
+
+LinkProbe::LinkProbe()
+    : _publisher(nullptr), _enabled(true), _adapt(LINKPROBE_ADAPT), _intervalMs(LINKPROBE_INTERVAL_MS),
+      _level(LINK_UNKNOWN), _candidate(LINK_UNKNOWN), _hold(0), _misses(0), _windowSent(0), _windowLost(0),
+      _rttMs(0.0f), _loss(0.0f), _ok(0), _lost(0), _changes(0), _rttHist(), _lossHist() {
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+    _rttHist.le = LINK_RTT_LE;
+    _rttHist.n = sizeof(LINK_RTT_LE) / sizeof(LINK_RTT_LE[0]);
+    _lossHist.le = LINK_LOSS_LE;
+    _lossHist.n = sizeof(LINK_LOSS_LE) / sizeof(LINK_LOSS_LE[0]);
+}
+
+void LinkProbe::begin(UpstreamPublisher& publisher) {
+    _publisher = &publisher;
+    xTaskCreatePinnedToCore(taskMain, "linkprobe", LINKPROBE_TASK_STACK, this, LINKPROBE_TASK_PRIO, nullptr,
+                            ARDUINO_RUNNING_CORE);
+}
+
+void LinkProbe::setEnabled(bool on) {
+    _enabled.store(on, std::memory_order_relaxed);
+}
+
+// Al volver a adapt, el batching del nivel actual; sin adapt queda el último
+void LinkProbe::setAdapt(bool on) {
+    _adapt.store(on, std::memory_order_relaxed);
+    if (on && _publisher) {
+        const LinkBatching& b = LINK_BATCHING[_level];
+        _publisher->setBatching(b.batch_fixes, b.flush_ms);
+    }
+}
+
+void LinkProbe::setIntervalMs(uint32_t ms) {
+    _intervalMs.store(ms, std::memory_order_relaxed);
+}
+
+const char* LinkProbe::levelName(LinkLevel level) {
+    switch (level) {
+        case LINK_GOOD: return "good";
+        case LINK_FAIR: return "fair";
+        case LINK_POOR: return "poor";
+        case LINK_DOWN: return "down";
+        default:        return "unknown";
+    }
+}
+
+void LinkProbe::taskMain(void* arg) {
+    LinkProbe* self = (LinkProbe*)arg;
+    for (;;) {
+        const uint32_t start = millis();
+        IPAddress host;
+        if (self->_enabled.load(std::memory_order_relaxed) && self->_publisher->active() && WiFi.isConnected()
+            && self->_publisher->target(host)) {
+            self->probe(host);
+        }
+        // Intervalo entre comienzos: un eco perdido ya esperó su timeout
+        const uint32_t spent = millis() - start;
+        const uint32_t interval = self->_intervalMs.load(std::memory_order_relaxed);
+        vTaskDelay(pdMS_TO_TICKS(spent < interval ? interval - spent : 1));
+    }
+}
+
+void LinkProbe::probe(const IPAddress& host) {
+    const bool ok = Ping.ping(host, 1);              // bloquea esta tarea: RTT o 1 s
+    const float rtt = ok ? Ping.averageTime() : 0.0f;
+
+    portENTER_CRITICAL(&_lock);
+    const bool first = (_ok + _lost) == 0;
+    if (ok) {
+        _ok++;
+        _misses = 0;
+        _rttHist.add(rtt);
+        _rttMs = (_ok > 1) ? _rttMs + ANCHOR_EMA_ALPHA * (rtt - _rttMs) : rtt;
+    } else {
+        _lost++;
+        if (_misses < 255) _misses++;
+        _windowLost++;
+    }
+    _loss = first ? (ok ? 0.0f : 1.0f) : _loss + ANCHOR_EMA_ALPHA * ((ok ? 0.0f : 1.0f) - _loss);
+    if (++_windowSent >= LINKPROBE_WINDOW) {
+        _lossHist.add((float)_windowLost / _windowSent);
+        _windowSent = 0;
+        _windowLost = 0;
+    }
+
+    LinkLevel suggested;
+    if (_misses >= LINKPROBE_DOWN_MISSES) suggested = LINK_DOWN;
+    else if (_ok == 0) suggested = LINK_UNKNOWN;
+    else if (_loss >= LINK_POOR_LOSS || _rttMs >= LINK_POOR_RTT_MS) suggested = LINK_POOR;
+    else if (_loss <= LINK_GOOD_LOSS && _rttMs <= LINK_GOOD_RTT_MS) suggested = LINK_GOOD;
+    else suggested = LINK_FAIR;
+    portEXIT_CRITICAL(&_lock);
+
+    adapt(suggested);
+}
+
+// Histéresis: LINKPROBE_HOLD ecos seguidos con el mismo nivel nuevo
+void LinkProbe::adapt(LinkLevel suggested) {
+    if (suggested == _level) {
+        _hold = 0;
+        return;
+    }
+    if (suggested != _candidate) {
+        _candidate = suggested;
+        _hold = 0;
+    }
+    if (++_hold < LINKPROBE_HOLD) return;
+    _hold = 0;
+    LOG_I("[LINK] Enlace %s -> %s (rtt %d ms)\n", levelName(_level), levelName(suggested), (int)_rttMs);
+    _level = suggested;
+    _changes++;
+    if (_adapt.load(std::memory_order_relaxed)) {
+        const LinkBatching& b = LINK_BATCHING[_level];
+        _publisher->setBatching(b.batch_fixes, b.flush_ms);
+    }
+}
+
+void LinkProbe::serve(AsyncWebServer& server) {
+    // /link?enable=0|1&adapt=0|1&interval_ms=<n>: consulta o cambia el sondeo
+    server.on("/link", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("interval_ms")) {
+            const long interval = request->getParam("interval_ms")->value().toInt();
+            if (interval < 100 || interval > 600000) return request->send(400, "text/plain", "interval_ms inválido");
+            setIntervalMs((uint32_t)interval);
+        }
+        if (request->hasParam("adapt")) setAdapt(request->getParam("adapt")->value().toInt() != 0);
+        if (request->hasParam("enable")) setEnabled(request->getParam("enable")->value().toInt() != 0);
+
+        portENTER_CRITICAL(&_lock);
+        const float rtt = _rttMs;
+        const float loss = _loss;
+        portEXIT_CRITICAL(&_lock);
+        char json[256];
+        snprintf(json, sizeof(json),
+                 "{\"enabled\":%s,\"adapt\":%s,\"interval_ms\":%lu,\"level\":\"%s\",\"rtt_ms\":%.2f,\"loss\":%.3f,"
+                 "\"probes_ok\":%lu,\"probes_lost\":%lu,\"level_changes\":%lu,\"batch\":%u,\"flush_ms\":%u}",
+                 _enabled.load() ? "true" : "false", _adapt.load() ? "true" : "false",
+                 (unsigned long)_intervalMs.load(), levelName(_level), rtt, loss, (unsigned long)_ok,
+                 (unsigned long)_lost, (unsigned long)_changes, _publisher ? _publisher->batchFixes() : 0,
+                 _publisher ? _publisher->flushMs() : 0);
+        request->send(200, "application/json", json);
+    });
+}
@@ -0,0 +1,326 @@
+#include "MetricsWriter.h"
+#include <stdio.h>
+#include <cmath>
+#include "PositionStream.h"
+#include "FlashLog.h"
+#include "AnchorRegistry.h"
+#include "RawForwarder.h"
+#include "UpstreamPublisher.h"
+#include "LinkProbe.h"
+#include "AsyncLog.h"
+
+MetricsWriter::MetricsWriter(const PositioningManager& manager, const PositionStream* stream, const FlashLog* log,
+                             const AnchorRegistry* registry, const RawForwarder* forwarder,
+                             const UpstreamPublisher* upstream, const LinkProbe* link)
+    : _manager(manager), _stream(stream), _log(log), _registry(registry), _forwarder(forwarder), _upstream(upstream),
+      _link(link),
+      _phase(PH_SCALARS), _item(0), _nextKey(0), _familyOpen(false),
+      _stage(0), _bit(0), _bucket(0), _cum(0), _hz(1) {}
+
+// Muestras escalares en orden; las de una misma familia van contiguas y solo
+// la primera lleva help/type. name == nullptr: muestra omitida (módulo ausente)
+bool MetricsWriter::scalarAt(uint8_t item, Sample& out) const {
+    const ManagerStats& st = _manager.stats();
+    switch (item) {
+    case 0:  out = { "concentrator_reports_received_total", "counter", "Reportes de ancla con tamaño válido.", nullptr, (double)st.reports_received }; return true;
+    case 1:  out = { "concentrator_reports_wrong_size_total", "counter", "Paquetes ESP-NOW descartados por tamaño.", nullptr, (double)st.reports_wrong_size }; return true;
+    case 2:  out = { "concentrator_reports_dropped_total", "counter", "Reportes que no aportaron a un fix (secuencia expirada o tabla llena).", nullptr, (double)st.reports_dropped }; return true;
+    case 3:  out = { "concentrator_anchor_table_full_total", "counter", "Reportes de anclas sin casilla libre.", nullptr, (double)st.anchor_table_full }; return true;
+    case 4:  out = { "concentrator_sequences_completed_total", "counter", "Secuencias (tag, seq) que reunieron las anclas mínimas.", nullptr, (double)st.sequences_completed }; return true;
+    case 5:  out = { "concentrator_sequences_expired_total", "counter", "Secuencias incompletas descartadas por SEQUENCE_TIMEOUT_MS.", nullptr, (double)st.sequences_expired }; return true;
+    case 6:  out = { "concentrator_sequences_pending", "gauge", "Secuencias sin resolver a la espera de anclas.", nullptr, (double)st.pending_sequences }; return true;
+    case 7:  out = { "concentrator_solves_total", "counter", "Trilateraciones por resultado.", "result=\"ok\"", (double)st.solves_ok }; return true;
+    case 8:  out = { "concentrator_solves_total", nullptr, nullptr, "result=\"ill_conditioned\"", (double)st.solves_ill_conditioned }; return true;
+    case 9:  out = { "concentrator_solves_total", nullptr, nullptr, "result=\"unknown_anchor\"", (double)st.solves_unknown_anchor }; return true;
+    case 10: out = { "concentrator_heap_free_bytes", "gauge", "Heap libre.", nullptr, (double)ESP.getFreeHeap() }; return true;
+    case 11: out = { "concentrator_heap_min_free_bytes", "gauge", "Mínimo de heap libre desde el arranque.", nullptr, (double)ESP.getMinFreeHeap() }; return true;
+    case 12: out = { "concentrator_heap_max_alloc_bytes", "gauge", "Mayor bloque asignable del heap.", nullptr, (double)ESP.getMaxAllocHeap() }; return true;
+    case 13: out = { "concentrator_queue_high_water", "gauge", "Ocupación máxima observada de cada cola.", "queue=\"pending_sequences\"", (double)st.pending_high_water }; return true;
+    case 14: if (!_stream) { out.name = nullptr; return true; }
+             out = { "concentrator_queue_high_water", nullptr, nullptr, "queue=\"stream_ring\"", (double)_stream->pendingHighWater() }; return true;
+    case 15: if (!_log) { out.name = nullptr; return true; }
+             out = { "concentrator_queue_high_water", nullptr, nullptr, "queue=\"flashlog_bytes\"", (double)_log->stagedHighWater() }; return true;
+    case 16: out = { "concentrator_stream_coalesced_total", "counter", "Fixes omitidos por coalescencia en el stream.", nullptr, _stream ? (double)_stream->coalesced() : 0.0 }; return true;
+    case 17: out = { "concentrator_stream_overrun_total", "counter", "Eventos sobrescritos en el anillo antes de difundirse.", nullptr, _stream ? (double)_stream->overrun() : 0.0 }; return true;
+    case 18: out = { "concentrator_flashlog_bytes_written_total", "counter", "Bytes escritos en el log de flash.", nullptr, _log ? (double)_log->bytesWritten() : 0.0 }; return true;
+    case 19: out = { "concentrator_flashlog_dropped_total", "counter", "Registros descartados por buffers del log ocupados.", nullptr, _log ? (double)_log->dropped() : 0.0 }; return true;
+    case 20: out = { "concentrator_log_overrun_total", "counter", "Mensajes de depuración descartados con el anillo del log lleno.", nullptr, (double)asyncLog.overruns() }; return true;
+    case 21: out = { "concentrator_sequences_short_total", "counter", "Secuencias cerradas sin esperar a anclas caídas.", nullptr, (double)st.sequences_short }; return true;
+    case 22: out = { "concentrator_anchors_live", "gauge", "Anclas que reportan (no caídas).", nullptr, (double)st.anchors_live }; return true;
+    case 23: out = { "concentrator_solves_by_trigger_total", "counter", "Secuencias resueltas por la política según el disparo.", "trigger=\"all_expected\"", (double)st.solves_early }; return true;
+    case 24: out = { "concentrator_solves_by_trigger_total", nullptr, nullptr, "trigger=\"deadline\"", (double)st.solves_deadline }; return true;
+    case 25: out = { "concentrator_reports_late_total", "counter", "Reportes llegados con la secuencia ya resuelta (solo aprendizaje).", nullptr, (double)st.reports_late }; return true;
+    case 26: out = { "concentrator_frames_total", "counter", "Frames ESP-NOW aceptados por versión de protocolo.", "version=\"1\"", (double)st.frames_v1 }; return true;
+    case 27: out = { "concentrator_frames_total", nullptr, nullptr, "version=\"2\"", (double)st.frames_v2 }; return true;
+    case 28: out = { "concentrator_frames_truncated_total", "counter", "Frames v2 cuyos registros no cierran con el largo recibido.", nullptr, (double)st.frames_truncated }; return true;
+    case 29: out = { "concentrator_records_skipped_total", "counter", "Registros v2 de tipo desconocido.", nullptr, (double)st.records_skipped }; return true;
+    case 30: out = { "concentrator_tag_telemetry_total", "counter", "Bloques de timestamp+sensores de tag por resultado.", "result=\"merged\"", (double)st.telemetry_updates }; return true;
+    case 31: out = { "concentrator_tag_telemetry_total", nullptr, nullptr, "result=\"redundant\"", (double)st.telemetry_redundant }; return true;
+    case 32: out = { "concentrator_reports_duplicate_total", "counter", "Reportes (ancla, tag, seq) repetidos descartados (retransmisiones).", nullptr, (double)st.reports_duplicate }; return true;
+    case 33: out = { "concentrator_reports_stale_total", "counter", "Reportes llegados más de SEQ_REORDER_WINDOW secuencias detrás del tag.", nullptr, (double)st.reports_stale }; return true;
+    case 34: out = { "concentrator_sequences_aged_total", "counter", "Secuencias incompletas cerradas al quedar fuera de la ventana de reorden.", nullptr, (double)st.sequences_aged }; return true;
+    case 35: if (!_registry) { out.name = nullptr; return true; }
+             out = { "concentrator_registry_frames_total", "counter", "Frames ESP-NOW según el registro MAC -> ancla (descartados solo en modo enforce).", "result=\"unknown_sender\"", (double)_registry->unknown() }; return true;
+    case 36: if (!_registry) { out.name = nullptr; return true; }
+             out = { "concentrator_registry_frames_total", nullptr, nullptr, "result=\"saddr_mismatch\"", (double)_registry->mismatch() }; return true;
+    case 37: if (!_registry) { out.name = nullptr; return true; }
+             out = { "concentrator_registry_frames_total", nullptr, nullptr, "result=\"rejected\"", (double)_registry->rejected() }; return true;
+    case 38: if (!_registry) { out.name = nullptr; return true; }
+             out = { "concentrator_registry_anchors", "gauge", "MAC registradas como anclas.", nullptr, (double)_registry->count() }; return true;
+    case 39: out = { "concentrator_fix_latency_ms", "gauge", "Medición en las anclas -> fix publicado (media exponencial).", nullptr, (double)st.fix_latency_ms }; return true;
+    case 40: out = { "concentrator_fix_latency_max_ms", "gauge", "Mayor latencia medición -> fix desde el arranque.", nullptr, (double)st.fix_latency_max_ms }; return true;
+    case 41: out = { "concentrator_anchor_clock_resyncs_total", "counter", "Relojes de ancla resincronizados (reinicio o salto del t_ms).", nullptr, (double)st.clock_resyncs }; return true;
+    case 42: if (!_forwarder) { out.name = nullptr; return true; }
+             out = { "concentrator_forward_frames_total", "counter", "Frames ESP-NOW del modo raw-forward por resultado.", "result=\"queued\"", (double)_forwarder->forwarded() }; return true;
+    case 43: if (!_forwarder) { out.name = nullptr; return true; }
+             out = { "concentrator_forward_frames_total", nullptr, nullptr, "result=\"dropped\"", (double)_forwarder->dropped() }; return true;
+    case 44: if (!_forwarder) { out.name = nullptr; return true; }
+             out = { "concentrator_forward_batches_total", "counter", "Batches reenviados por resultado del envío.", "result=\"sent\"", (double)_forwarder->batches() }; return true;
+    case 45: if (!_forwarder) { out.name = nullptr; return true; }
+             out = { "concentrator_forward_batches_total", nullptr, nullptr, "result=\"error\"", (double)_forwarder->sendErrors() }; return true;
+    case 46: if (!_forwarder) { out.name = nullptr; return true; }
+             out = { "concentrator_forward_bytes_total", "counter", "Bytes de batches reenviados.", nullptr, (double)_forwarder->bytesSent() }; return true;
+    case 47: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_fixes_total", "counter", "Fixes hacia el colector por resultado.", "result=\"queued\"", (double)_upstream->queued() }; return true;
+    case 48: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_fixes_total", nullptr, nullptr, "result=\"dropped\"", (double)_upstream->dropped() }; return true;
+    case 49: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_fixes_total", nullptr, nullptr, "result=\"published\"", (double)_upstream->published() }; return true;
+    case 50: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_batches_total", "counter", "Batches de fixes por resultado del envío.", "result=\"sent\"", (double)_upstream->batches() }; return true;
+    case 51: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_batches_total", nullptr, nullptr, "result=\"error\"", (double)_upstream->sendErrors() }; return true;
+    case 52: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_bytes_total", "counter", "Bytes enviados al colector (con la cabecera MQTT).", nullptr, (double)_upstream->bytesSent() }; return true;
+    case 53: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_queue_depth", "gauge", "Fixes en espera de publicarse.", nullptr, (double)_upstream->depth() }; return true;
+    case 54: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_latency_ms", "gauge", "Fix encolado -> enviado al colector (media exponencial).", nullptr, (double)_upstream->latencyMs() }; return true;
+    case 55: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_latency_max_ms", "gauge", "Mayor latencia encolado -> enviado desde el arranque.", nullptr, (double)_upstream->latencyMaxMs() }; return true;
+    case 56: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_fixes_per_batch", "gauge", "Fixes por batch enviado (media desde el arranque).", nullptr, (double)_upstream->fixesPerBatch() }; return true;
+    case 57: if (!_upstream) { out.name = nullptr; return true; }
+             out = { "concentrator_upstream_efficiency", "gauge", "Bytes de fixes (27 por fix) sobre bytes en el aire con cabeceras IP estimadas.", nullptr, (double)_upstream->efficiency() }; return true;
+    case 58: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_probes_total", "counter", "Ecos ICMP al colector por resultado.", "result=\"ok\"", (double)_link->probesOk() }; return true;
+    case 59: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_probes_total", nullptr, nullptr, "result=\"lost\"", (double)_link->probesLost() }; return true;
+    case 60: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_rtt_ema_ms", "gauge", "RTT al colector (media exponencial).", nullptr, (double)_link->rttMs() }; return true;
+    case 61: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_loss_ema_ratio", "gauge", "Fracción de ecos perdidos (media exponencial).", nullptr, (double)_link->lossRatio() }; return true;
+    case 62: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_level", "gauge", "Nivel del enlace: 0 sin datos, 1 bueno, 2 regular, 3 malo, 4 caído.", nullptr, (double)_link->level() }; return true;
+    case 63: if (!_link) { out.name = nullptr; return true; }
+             out = { "concentrator_link_level_changes_total", "counter", "Cambios de nivel del enlace (y del batching del publicador).", nullptr, (double)_link->levelChanges() }; return true;
+    case 64: out = { "concentrator_sequences_lingering", "gauge", "Secuencias resueltas a la espera de reportes tardíos.", nullptr, (double)st.lingering_sequences }; return true;
+    case 65: out = { "concentrator_sequences_lingering_full_total", "counter", "Secuencias resueltas cerradas sin esperar tardíos por falta de cupo.", nullptr, (double)st.lingering_full }; return true;
+    case 66: out = { "concentrator_seq_resyncs_total", "counter", "Órdenes de tag reiniciados tras SEQ_RESYNC_STALE reportes atrasados seguidos.", nullptr, (double)st.seq_resyncs }; return true;
+    default: return false;
+    }
+}
+
+int MetricsWriter::printSample(const Sample& s) {
+    int n = 0;
+    if (s.help) {
+        n = snprintf(_piece, sizeof(_piece), "# HELP %s %s\n# TYPE %s %s\n", s.name, s.help, s.name, s.type);
+        if (n < 0 || (size_t)n >= sizeof(_piece)) return n;
+    }
+    const int m = snprintf(_piece + n, sizeof(_piece) - n, s.label ? "%s{%s} %.10g\n" : "%s%s %.10g\n",
+                           s.name, s.label ? s.label : "", s.value);
+    return (m < 0) ? m : n + m;
+}
+
+void MetricsWriter::startStage(uint8_t stage) {
+    _stage  = stage;
+    _bit    = PERF_LE_MIN_BITS;
+    _bucket = 0;
+    _cum    = 0;
+}
+
+bool MetricsWriter::nextPiece() {
+    int n = 0;
+
+    switch (_phase) {
+    case PH_SCALARS: {
+        Sample sample;
+        if (!scalarAt(_item++, sample)) {
+            _phase = PH_ANCHORS;
+            _item = 0;
+            _nextKey = 0;
+            _familyOpen = false;
+            return nextPiece();
+        }
+        if (!sample.name) return nextPiece();
+        n = printSample(sample);
+        break;
+    }
+    case PH_ANCHORS: {
+        // Familias por ancla, cada una recorriendo todas las casillas
+        static const Sample families[] = {
+            { "concentrator_anchor_reports_total", "counter", "Reportes recibidos por ancla.", nullptr, 0 },
+            { "concentrator_anchor_range_meters_sum", "counter", "Suma de rangos medidos por ancla.", nullptr, 0 },
+            { "concentrator_anchor_range_mean_meters", "gauge", "Rango medio por ancla desde el arranque.", nullptr, 0 },
+            { "concentrator_anchor_range_ema_meters", "gauge", "Rango medio reciente por ancla (media móvil exponencial).", nullptr, 0 },
+            { "concentrator_anchor_range_stddev_meters", "gauge", "Desvío del rango por ancla (exponencial).", nullptr, 0 },
+            { "concentrator_anchor_report_rate_hz", "gauge", "Reportes por segundo de cada ancla.", nullptr, 0 },
+            { "concentrator_anchor_participation_ratio", "gauge", "Fracción de secuencias cerradas en que reportó el ancla.", nullptr, 0 },
+            { "concentrator_anchor_std_noise", "gauge", "std_noise medio por ancla.", nullptr, 0 },
+            { "concentrator_anchor_cir_power", "gauge", "cir_pwr medio por ancla.", nullptr, 0 },
+            { "concentrator_anchor_rssi_dbm", "gauge", "RSSI medio del enlace ESP-NOW por ancla.", nullptr, 0 },
+            { "concentrator_anchor_latency_ms", "gauge", "Recepción - medición por ancla (retardo en el ancla y en el aire).", nullptr, 0 },
+            { "concentrator_anchor_clock_offset_ms", "gauge", "millis() del concentrador - t_ms del ancla.", nullptr, 0 },
+            { "concentrator_anchor_clock_drift_ppm", "gauge", "Deriva del reloj del ancla respecto del concentrador (positiva si adelanta).", nullptr, 0 },
+            { "concentrator_anchor_up", "gauge", "1 si el ancla reporta, 0 si se la considera caída.", nullptr, 0 },
+        };
+        const uint8_t familyCount = sizeof(families) / sizeof(families[0]);
+        AnchorEntry e;
+        bool found = false;
+        while (_item < familyCount && !found) {
+            while (_nextKey < _manager.anchorCount()) {
+                if (_manager.readAnchor(_nextKey++, e)) { found = true; break; }
+            }
+            if (!found) { _item++; _nextKey = 0; _familyOpen = false; }
+        }
+        if (!found) {
+            _phase = PH_LINK;
+            _stage = 0;
+            _bucket = 0;
+            _cum = 0;
+            return nextPiece();
+        }
+        char label[24];
+        snprintf(label, sizeof(label), "anchor=\"%x\"", e.report.anchor_saddr);
+        Sample sample = families[_item];
+        sample.label = label;
+        if (_familyOpen) sample.help = nullptr;
+        _familyOpen = true;
+        const AnchorStats& st = e.stats;
+        switch (_item) {
+            case 0:  sample.value = (double)e.reports; break;
+            case 1:  sample.value = e.range_sum; break;
+            case 2:  sample.value = e.reports ? e.range_sum / e.reports : 0.0; break;
+            case 3:  sample.value = st.range_mean; break;
+            case 4:  sample.value = sqrt(st.range_var); break;
+            case 5:  sample.value = st.rateHz(); break;
+            case 6:  sample.value = st.participationAt(_manager.closedSequences()); break;
+            case 7:  sample.value = st.noise_mean; break;
+            case 8:  sample.value = st.cir_mean; break;
+            case 9:  sample.value = st.rssi_dbm; break;
+            case 10: sample.value = st.latency_ms; break;
+            case 11: sample.value = st.clock_offset_ms; break;
+            case 12: sample.value = st.clock_drift_ppm; break;
+            default: sample.value = e.staleAt(millis()) ? 0.0 : 1.0; break;
+        }
+        n = printSample(sample);
+        break;
+    }
+    case PH_LINK: {
+        // Histogramas del sondeo del enlace: RTT y pérdida por ventana
+        static const char* const names[] = { "concentrator_link_rtt_ms", "concentrator_link_window_loss_ratio" };
+        static const char* const helps[] = { "RTT de los ecos ICMP al colector.",
+                                             "Fracción de ecos perdidos por ventana de LINKPROBE_WINDOW." };
+        if (!_link || _stage >= 2) {
+            _phase = PH_PERF_HEAD;
+            return nextPiece();
+        }
+        const LinkHistogram& h = _stage == 0 ? _link->rttHistogram() : _link->lossHistogram();
+        if (_bucket == 0) {
+            n = snprintf(_piece, sizeof(_piece), "# HELP %s %s\n# TYPE %s histogram\n", names[_stage], helps[_stage],
+                         names[_stage]);
+            if (n < 0 || (size_t)n >= sizeof(_piece)) break;
+        }
+        int m;
+        if (_bucket <= h.n) {
+            _cum += h.buckets[_bucket];
+            if (_bucket < h.n) {
+                m = snprintf(_piece + n, sizeof(_piece) - n, "%s_bucket{le=\"%g\"} %lu\n", names[_stage],
+                             (double)h.le[_bucket], (unsigned long)_cum);
+            } else {
+                m = snprintf(_piece + n, sizeof(_piece) - n, "%s_bucket{le=\"+Inf\"} %lu\n", names[_stage],
+                             (unsigned long)_cum);
+            }
+            _bucket++;
+        } else {
+            // _count es la suma de los buckets leídos, coherente con +Inf
+            m = snprintf(_piece + n, sizeof(_piece) - n, "%s_sum %.6g\n%s_count %lu\n", names[_stage], h.sum,
+                         names[_stage], (unsigned long)_cum);
+            _stage++;
+            _bucket = 0;
+            _cum = 0;
+        }
+        n = (m < 0) ? m : n + m;
+        break;
+    }
+#if PERF_PROBES
+    case PH_PERF_HEAD:
+        _hz = perf_ticks_per_sec();
+        n = snprintf(_piece, sizeof(_piece),
+            "# HELP concentrator_stage_seconds Latencia por etapa del pipeline (inclusiva).\n"
+            "# TYPE concentrator_stage_seconds histogram\n");
+        startStage(0);
+        _phase = PH_PERF_BUCKET;
+        break;
+    case PH_PERF_BUCKET: {
+        // Límites hasta la primera potencia de dos mayor que el máximo observado
+        const PerfHistogram& h = g_perf[_stage];
+        uint8_t lastBit = h.max ? (uint8_t)(32 - __builtin_clz(h.max)) : 0;
+        if (lastBit < PERF_LE_MIN_BITS) lastBit = PERF_LE_MIN_BITS;
+        if (lastBit > 31) lastBit = 31;
+        if (_bit > lastBit) {
+            _phase = PH_PERF_INF;
+            return nextPiece();
+        }
+        const uint8_t limit = PerfHistogram::bucketOf(1u << _bit);
+        while (_bucket < limit) _cum += h.buckets[_bucket++];
+        n = snprintf(_piece, sizeof(_piece), "concentrator_stage_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %lu\n",
+                     PERF_STAGE_NAMES[_stage], (double)(1u << _bit) / _hz, (unsigned long)_cum);
+        _bit++;
+        break;
+    }
+    case PH_PERF_INF: {
+        const PerfHistogram& h = g_perf[_stage];
+        while (_bucket < PERF_BUCKETS) _cum += h.buckets[_bucket++];
+        n = snprintf(_piece, sizeof(_piece), "concentrator_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n",
+                     PERF_STAGE_NAMES[_stage], (unsigned long)_cum);
+        _phase = PH_PERF_SUM;
+        break;
+    }
+    case PH_PERF_SUM:
+        // _count es la suma de los buckets leídos, coherente con +Inf
+        n = snprintf(_piece, sizeof(_piece),
+            "concentrator_stage_seconds_sum{stage=\"%s\"} %.9g\n"
+            "concentrator_stage_seconds_count{stage=\"%s\"} %lu\n",
+            PERF_STAGE_NAMES[_stage], (double)g_perf[_stage].sum / _hz,
+            PERF_STAGE_NAMES[_stage], (unsigned long)_cum);
+        if (_stage + 1 < PERF_STAGE_COUNT) {
+            startStage(_stage + 1);
+            _phase = PH_PERF_BUCKET;
+        } else {
+            _stage = 0;
+            _phase = PH_PERF_MAX;
+        }
+        break;
+    case PH_PERF_MAX:
+        n = snprintf(_piece, sizeof(_piece), "%sconcentrator_stage_max_seconds{stage=\"%s\"} %.9g\n",
+                     _stage == 0 ? "# HELP concentrator_stage_max_seconds Peor latencia observada por etapa.\n"
+                                   "# TYPE concentrator_stage_max_seconds gauge\n" : "",
+                     PERF_STAGE_NAMES[_stage], (double)g_perf[_stage].max / _hz);
+        if (++_stage >= PERF_STAGE_COUNT) _phase = PH_DONE;
+        break;
+#else
+    case PH_PERF_HEAD:
+    case PH_PERF_BUCKET:
+    case PH_PERF_INF:
+    case PH_PERF_SUM:
+    case PH_PERF_MAX:
+        _phase = PH_DONE;
+        return nextPiece();
+#endif
+    case PH_DONE:
+        return false;
+    }
+
+    return setPiece(n);
+}
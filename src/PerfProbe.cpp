@@ -0,0 +1,11 @@
+#include "PerfProbe.h"
+
+#if PERF_PROBES
+
+PerfHistogram g_perf[PERF_STAGE_COUNT] = {};
+
+const char* const PERF_STAGE_NAMES[PERF_STAGE_COUNT] = {
+    "receive", "decode", "correlate", "solve", "filter", "publish"
+};
+
+#endif // PERF_PROBES
@@ -1,92 +1,57 @@
 #include "PortalWeb.h"
 #include <WiFi.h>
-#include <ArduinoJson.h>
-
-const char htmlContent[] PROGMEM = R"rawliteral(
-<!DOCTYPE html>
-<html lang="es">
-<head>
-    <meta charset="UTF-8">
-    <meta name="viewport" content="width=device-width, initial-scale=1.0">
-    <title>Concentrador UWB - TWR</title>
-    <style>
-        body { font-family: -apple-system, BlinkMacSystemFont, "Segoe UI", Roboto, "Helvetica Neue", Arial, sans-serif; background-color: #f0f2f5; margin: 0; padding: 20px; color: #333; }
-        .container { max-width: 1200px; margin: 0 auto; }
-        h1, h2 { color: #0056b3; text-align: center; }
-        .card { background-color: #fff; border: 1px solid #ddd; border-radius: 8px; padding: 20px; margin-bottom: 20px; box-shadow: 0 4px 6px rgba(0,0,0,0.1); }
-        .card-title { font-weight: bold; font-size: 1.2em; color: #0056b3; margin-bottom: 15px; border-bottom: 2px solid #0056b3; padding-bottom: 10px;}
-        .position-display { text-align: center; font-size: 1.5em; font-weight: bold; margin: 20px 0; }
-        table { width: 100%; border-collapse: collapse; font-size: 0.9em; } 
-        th, td { padding: 8px 12px; border: 1px solid #ddd; text-align: left; } 
-        th { background-color: #e9ecef; white-space: nowrap; } 
-        tbody tr:nth-child(odd) { background-color: #f9f9f9; }
-        td { white-space: nowrap; }
-    </style>
-</head>
-<body>
-    <div class="container">
-        <h1>Concentrador UWB - Trilateración</h1>
-        <div class="card">
-            <div class="card-title">Posición Calculada del Tag</div>
-            <div id="tag-position" class="position-display">X: N/A, Y: N/A, Z: N/A</div>
-        </div>
-        <div class="card">
-            <div class="card-title">Reportes de Rango de Anclas</div>
-            <div style="overflow-x:auto;">
-                <table id="anchor-table">
-                    <thead>
-                        <tr><th>Ancla SAddr</th><th>Tag UID</th><th>Seq</th><th>Rango (m)</th><th>Temp (°C)</th><th>Accel SQ (g)</th><th>RXPACC</th><th>Ruido Std</th><th>Potencia CIR</th></tr>
-                    </thead>
-                    <tbody>
-                        <tr><td colspan="9" style="text-align:center;">Esperando datos...</td></tr>
-                    </tbody>
-                </table>
-            </div>
-        </div>
-    </div>
-
-    <script>
-        function updateTable(anchorData) {
-            const tableBody = document.querySelector("#anchor-table tbody");
-            tableBody.innerHTML = '';
-            if (Object.keys(anchorData).length === 0) {
-                tableBody.innerHTML = '<tr><td colspan="9" style="text-align:center;">Esperando datos...</td></tr>';
-                return;
-            }
-            for (const id in anchorData) {
-                const data = anchorData[id];
-                const row = `<tr>
-                    <td>0x${data.anchor_saddr.toString(16).toUpperCase()}</td>
-                    <td>0x${data.tag_uid.toString(16).toUpperCase()}</td>
-                    <td>${data.seq}</td>
-                    <td>${data.range_m.toFixed(3)}</td>
-                    <td>${data.temp.toFixed(2)}</td>
-                    <td>${data.aSQ.toFixed(3)}</td>
-                    <td>${data.rxpacc}</td>
-                    <td>${data.std_noise}</td>
-                    <td>${data.cir_pwr}</td>
-                </tr>`;
-                tableBody.innerHTML += row;
-            }
-        }
+#include <memory>
+#include "DataJsonWriter.h"
+#include "MetricsWriter.h"
+#include "AsyncLog.h"
+#include "WebAssets.h"
+
+// Respuesta chunked alimentada por un serializador reanudable
+static void sendWriter(AsyncWebServerRequest *request, const char* contentType, std::shared_ptr<ChunkedWriter> writer) {
+    request->sendChunked(contentType, [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return writer->fill(buffer, maxLen);
+    });
+}
+
+// Sirve un recurso precomprimido. index.html se revalida siempre (no-cache) y
+// responde 304 si el ETag coincide; los recursos versionados son inmutables.
+static void sendWebAsset(AsyncWebServerRequest *request, const WebAsset& asset) {
+    const char* cacheControl = asset.immutable ? "public, max-age=31536000, immutable" : "no-cache";
 
-        setInterval(() => {
-            fetch('/data').then(r => r.json()).then(data => {
-                const pos = data.tag_position;
-                document.getElementById('tag-position').textContent = `X: ${pos.x.toFixed(2)}, Y: ${pos.y.toFixed(2)}, Z: ${pos.z.toFixed(2)}`;
-                updateTable(data.anchors);
-            }).catch(console.error);
-        }, 2000);
-    </script>
-</body>
-</html>
-)rawliteral";
+    // If-None-Match puede traer una lista de ETags
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value().indexOf(asset.etag) >= 0) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", cacheControl);
+        return request->send(response);
+    }
+
+    AsyncWebServerResponse *response = request->beginResponse_P(200, asset.contentType, asset.gzData, asset.gzLen);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+}
+
+// Entero decimal sin signo dentro de [lo, hi]; false si no es un número o
+// queda fuera de rango (toInt() devolvería 0 o un valor truncado)
+static bool rangeParam(AsyncWebServerRequest *request, const char* name, long lo, long hi, long& out) {
+    const String& value = request->getParam(name)->value();
+    if (value.length() == 0 || value.length() > 9) return false;
+    for (size_t i = 0; i < value.length(); i++) {
+        if (!isdigit((unsigned char)value[i])) return false;
+    }
+    out = value.toInt();
+    return out >= lo && out <= hi;
+}
 
 PortalWeb::PortalWeb(const char* ssid, const char* password) 
-    : _server(80), _manager(nullptr), _ssid(ssid), _password(password) {}
+    : _server(80), _stream("/events"), _manager(nullptr), _bootId(0), _ssid(ssid), _password(password) {}
 
-void PortalWeb::begin(String mac, PositioningManager& manager) {
+void PortalWeb::begin(String mac, PositioningManager& manager, FlashLog* log, AnchorRegistry* registry,
+                      RawForwarder* forwarder, UpstreamPublisher* upstream, LinkProbe* link) {
     _manager = &manager;
+    _bootId = esp_random() | 1;
 
     WiFi.softAP(_ssid, _password);
     IPAddress apIP = WiFi.softAPIP();
@@ -95,44 +60,143 @@ void PortalWeb::begin(String mac, PositioningManager& manager) {
     DEBUG_PRINT("IP para acceder al portal: http://"); DEBUG_PRINTLN(apIP);
     DEBUG_PRINTLN("-----------------------------------");
 
-    _server.on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        request->send_P(200, "text/html", htmlContent);
-    });
+    // Panel: recursos gzip embebidos por tools/embed_web_assets.py
+    for (size_t i = 0; i < WEB_ASSET_COUNT; i++) {
+        const WebAsset* asset = &WEB_ASSETS[i];
+        _server.on(asset->url, HTTP_GET, [asset](AsyncWebServerRequest *request) {
+            sendWebAsset(request, *asset);
+        });
+    }
 
     _server.on("/data", HTTP_GET, [this](AsyncWebServerRequest *request) {
         if (!_manager) return request->send(500, "text/plain", "Manager no inicializado");
 
-        StaticJsonDocument<2048> doc;
-        
-        Point pos = _manager->getLastTagPosition();
-        doc["tag_position"]["x"] = pos.x;
-        doc["tag_position"]["y"] = pos.y;
-        doc["tag_position"]["z"] = pos.z;
-
-        JsonVariant anchors = doc.createNestedObject("anchors");
-        const auto& anchorMap = _manager->getAnchorDataMap();
-        for (auto const& [saddr, data] : anchorMap) {
-            JsonObject anchorObj = anchors.createNestedObject(String(saddr, HEX));
-            anchorObj["anchor_saddr"] = data.anchor_saddr;
-            anchorObj["tag_uid"] = data.tag_uid;
-            anchorObj["seq"] = data.seq;
-            anchorObj["range_m"] = data.range_m;
-            // Añadir datos de diagnóstico y sensores al JSON
-            anchorObj["temp"] = data.temp;
-            anchorObj["aSQ"] = data.aSQ;
-            anchorObj["rxpacc"] = data.rxpacc;
-            anchorObj["std_noise"] = data.std_noise;
-            anchorObj["cir_pwr"] = data.cir_pwr;
+        // /data?since=<version>&boot=<id>: solo entradas cambiadas; 304 si no hubo
+        // cambios. La versión vuelve a 0 en cada arranque: si boot no es el de
+        // este arranque (o falta), o since supera la versión actual, va todo.
+        uint32_t since = 0;
+        if (request->hasParam("since")) since = strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+        const uint32_t boot =
+            request->hasParam("boot") ? strtoul(request->getParam("boot")->value().c_str(), nullptr, 10) : 0;
+        const uint32_t version = _manager->getVersion();
+        if (boot != _bootId || since > version) since = 0;
+        if (since > 0 && since == version) return request->send(304);
+
+        // Respuesta chunked: el JSON se genera por fragmentos al ritmo del envío TCP
+        sendWriter(request, "application/json", std::make_shared<DataJsonWriter>(*_manager, since, _bootId));
+    });
+
+    // Estelas recientes por tag: el panel las pide una vez y luego las
+    // prolonga con los fixes del stream
+    _trails.attach(manager);
+    _server.on("/trails", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        sendWriter(request, "application/json", std::make_shared<TrailJsonWriter>(_trails));
+    });
+
+    // Historial de un tag: /history?tag=<uid hex>&from=<ms>&to=<ms>
+    // (tiempos en millis() del concentrador, como t_ms en /data)
+    _history.attach(manager);
+    _server.on("/history", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!request->hasParam("tag")) return request->send(400, "text/plain", "Falta el parámetro tag");
+        const uint32_t tag = strtoul(request->getParam("tag")->value().c_str(), nullptr, 16);
+        uint32_t from = 0, to = UINT32_MAX;
+        if (request->hasParam("from")) from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+        if (request->hasParam("to"))   to   = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+        sendWriter(request, "application/json", std::make_shared<HistoryJsonWriter>(_history, tag, from, to));
+    });
+
+    // Posiciones configuradas de las anclas (plano de planta del panel)
+    _server.on("/layout", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!_manager) return request->send(500, "text/plain", "Manager no inicializado");
+
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->print("{\"anchors\":[");
+        bool first = true;
+        for (auto const& [saddr, p] : _manager->getAnchorPositions()) {
+            response->printf("%s{\"saddr\":%u,\"x\":%.3f,\"y\":%.3f,\"z\":%.3f}",
+                             first ? "" : ",", saddr, p.x, p.y, p.z);
+            first = false;
         }
+        response->print("]}");
+        request->send(response);
+    });
 
-        String jsonResponse;
-        serializeJson(doc, jsonResponse);
-        request->send(200, "application/json", jsonResponse);
+    // Métricas en formato de texto de Prometheus
+    _server.on("/metrics", HTTP_GET, [this, log, registry, forwarder, upstream, link](AsyncWebServerRequest *request) {
+        if (!_manager) return request->send(500, "text/plain", "Manager no inicializado");
+        sendWriter(request, "text/plain; version=0.0.4",
+                   std::make_shared<MetricsWriter>(*_manager, &_stream, log, registry, forwarder, upstream, link));
     });
 
+    // Nivel del log diferido: /loglevel?level=off|error|warn|info|debug
+    _server.on("/loglevel", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (request->hasParam("level")) {
+            LogLevel level;
+            if (!AsyncLog::parseLevel(request->getParam("level")->value().c_str(), level)) {
+                return request->send(400, "text/plain", "Nivel desconocido");
+            }
+            asyncLog.setLevel(level);
+        }
+        request->send(200, "text/plain", AsyncLog::levelName(asyncLog.level()));
+    });
+
+    // Política de cierre de secuencias: /policy?mode=latency|accuracy&wait_ms=N&min=N
+    _server.on("/policy", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!_manager) return request->send(500, "text/plain", "Manager no inicializado");
+        AnchorPolicy policy = _manager->policy();
+        if (request->hasParam("mode")) {
+            if (!PositioningManager::parsePolicyMode(request->getParam("mode")->value().c_str(), policy.mode)) {
+                return request->send(400, "text/plain", "Modo desconocido");
+            }
+        }
+        long value;
+        if (request->hasParam("wait_ms")) {
+            // Más allá de SEQUENCE_TIMEOUT_MS la secuencia expira antes del plazo
+            if (!rangeParam(request, "wait_ms", 0, SEQUENCE_TIMEOUT_MS, value)) {
+                return request->send(400, "text/plain", "wait_ms fuera de rango");
+            }
+            policy.wait_ms = (uint16_t)value;
+        }
+        if (request->hasParam("min")) {
+            if (!rangeParam(request, "min", ANCHORS_MIN_SOLVE, MAX_ANCHORS, value)) {
+                return request->send(400, "text/plain", "min fuera de rango");
+            }
+            policy.min_anchors = (uint8_t)value;
+        }
+        _manager->setPolicy(policy);
+
+        policy = _manager->policy();
+        char json[96];
+        snprintf(json, sizeof(json), "{\"mode\":\"%s\",\"min_anchors\":%u,\"wait_ms\":%u}",
+                 PositioningManager::policyModeName(policy.mode), policy.min_anchors, policy.wait_ms);
+        request->send(200, "application/json", json);
+    });
+
+    // Stream SSE de fixes por tag y salud de anclas
+    _stream.begin(_server, manager);
+
+    // Estado y descarga del log persistente
+    if (log) log->serve(_server);
+
+    // Registro MAC -> ancla (puesta en marcha)
+    if (registry) registry->serve(_server);
+
+    // Modo raw-forward (resolución en un servicio externo)
+    if (forwarder) forwarder->serve(_server);
+
+    // Publicación de fixes a un colector por la STA
+    if (upstream) upstream->serve(_server);
+
+    // Sondeo ICMP del enlace con el colector
+    if (link) link->serve(_server);
+
     _server.onNotFound([](AsyncWebServerRequest *request) {
         request->send(404, "text/plain", "Página no encontrada");
     });
 
     _server.begin();
-}
\ No newline at end of file
+}
+
+void PortalWeb::loop() {
+    _stream.loop();
+}
@@ -0,0 +1,285 @@
+#include "PositionStream.h"
+
+PositionStream::PositionStream(const char* url, const char* wsUrl)
+    : _events(url), _ws(wsUrl), _manager(nullptr), _nextId(1), _sentId(0),
+      _coalesced(0), _overrun(0), _pendingHighWater(0), _lastHealthMs(0) {
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void PositionStream::begin(AsyncWebServer& server, PositioningManager& manager) {
+    _manager = &manager;
+
+    _events.onConnect([this](AsyncEventSourceClient* client) {
+        replay(client);
+    });
+    server.addHandler(&_events);
+
+    _ws.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                       void* arg, uint8_t* data, size_t len) {
+        onWsEvent(client, type, arg, data, len);
+    });
+    server.addHandler(&_ws);
+
+    // Bytes por fix y µs de serialización de cada formato. Corre dentro del
+    // handler: ?n= se acota a STREAM_BENCH_MAX para no frenar a los demás clientes
+    server.on("/stream/bench", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        uint32_t iterations = STREAM_BENCH_ITERATIONS;
+        if (request->hasParam("n")) {
+            const long n = request->getParam("n")->value().toInt();
+            if (n < 1 || n > STREAM_BENCH_MAX) return request->send(400, "text/plain", "n fuera de rango");
+            iterations = (uint32_t)n;
+        }
+        AsyncResponseStream* response = request->beginResponseStream("text/plain");
+        benchmark(*response, iterations);
+        request->send(response);
+    });
+
+    manager.addFixListener([this](const TagFix& fix) { publishFix(fix); });
+}
+
+void PositionStream::publishFix(const TagFix& fix) {
+    StreamEvent ev;
+    ev.type = STREAM_EVT_FIX;
+    ev.fix  = fix;
+    push(ev);
+}
+
+// Reserva id y copia el evento en su casilla del anillo (id % STREAM_RING_SIZE)
+void PositionStream::push(StreamEvent& ev) {
+    portENTER_CRITICAL(&_lock);
+    ev.id = _nextId++;
+    _ring[ev.id % STREAM_RING_SIZE] = ev;
+    portEXIT_CRITICAL(&_lock);
+}
+
+// Copia el evento "id" si aún no fue sobrescrito
+bool PositionStream::eventAt(uint32_t id, StreamEvent& out) {
+    bool found = false;
+    portENTER_CRITICAL(&_lock);
+    const StreamEvent& slot = _ring[id % STREAM_RING_SIZE];
+    if (slot.id == id) {
+        out = slot;
+        found = true;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return found;
+}
+
+void PositionStream::loop() {
+    checkAnchors();
+
+    portENTER_CRITICAL(&_lock);
+    const uint32_t last = _nextId - 1;
+    portEXIT_CRITICAL(&_lock);
+
+    uint32_t first = _sentId.load(std::memory_order_relaxed) + 1;
+    if (first > last) return;
+    if (last - first + 1 > _pendingHighWater) _pendingHighWater = last - first + 1;
+    if (last - first + 1 > STREAM_RING_SIZE) {
+        _overrun += (last - first + 1) - STREAM_RING_SIZE;
+        first = last - STREAM_RING_SIZE + 1;
+    }
+    _sentId.store(last, std::memory_order_release);
+
+    WsSubscriber subs[DEFAULT_MAX_WS_CLIENTS];
+    size_t nSubs = 0;
+    portENTER_CRITICAL(&_lock);
+    for (const auto& sub : _wsSubs) {
+        if (sub.id != 0) subs[nSubs++] = sub;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    const bool sseActive = _events.count() > 0;
+    if (!sseActive && nSubs == 0) return;
+
+    // Si la cola media de los clientes más lo pendiente no cabe en
+    // SSE_MAX_QUEUED_MESSAGES (o algún WebSocket tiene la cola llena),
+    // solo se envía el fix más reciente de cada tag.
+    const size_t pending = last - first + 1;
+    const bool behind =
+        (sseActive && _events.avgPacketsWaiting() + pending + STREAM_COALESCE_MARGIN > SSE_MAX_QUEUED_MESSAGES) ||
+        (nSubs > 0 && !_ws.availableForWriteAll());
+
+    StreamEvent batch[STREAM_RING_SIZE];
+    size_t n = 0;
+    for (uint32_t id = first; id <= last; id++) {
+        if (eventAt(id, batch[n])) n++;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (behind && batch[i].type == STREAM_EVT_FIX) {
+            bool superseded = false;
+            for (size_t j = i + 1; j < n; j++) {
+                if (batch[j].type == STREAM_EVT_FIX && batch[j].fix.tag_uid == batch[i].fix.tag_uid) {
+                    superseded = true;
+                    break;
+                }
+            }
+            if (superseded) { _coalesced++; continue; }
+        }
+        if (sseActive) sendEvent(nullptr, batch[i]);
+        if (nSubs > 0) sendWs(batch[i], subs, nSubs);
+    }
+
+    _ws.cleanupClients();
+}
+
+// Reenvía a un cliente que reconecta los eventos posteriores a su Last-Event-ID.
+// Se le indica con "reset" que pida /data completo si ese id ya salió del
+// anillo, si es posterior a _sentId (reinicio) o si lo pendiente no cabe en
+// su cola. Esta última cota no se puede quitar: con SSE_MAX_QUEUED_MESSAGES
+// mensajes en cola, AsyncEventSourceClient::_queueMessage no cierra la
+// conexión, descarta el mensaje nuevo en silencio. El cliente vería un hueco
+// en los ids que no tiene cómo detectar (sus Last-Event-ID siguen avanzando).
+void PositionStream::replay(AsyncEventSourceClient* client) {
+    const uint32_t lastId = client->lastId();
+    const uint32_t sent = _sentId.load(std::memory_order_acquire);
+
+    client->send("hello", "hello", 0, STREAM_RECONNECT_MS);
+    if (lastId == 0 || lastId == sent) return;
+
+    const size_t waiting = client->packetsWaiting() + STREAM_COALESCE_MARGIN;
+    const size_t room = (waiting < SSE_MAX_QUEUED_MESSAGES) ? SSE_MAX_QUEUED_MESSAGES - waiting : 0;
+    StreamEvent ev;
+    if (lastId > sent || sent - lastId > room || !eventAt(lastId + 1, ev)) {
+        client->send("{}", "reset", sent);
+        return;
+    }
+    for (uint32_t id = lastId + 1; id <= sent; id++) {
+        if (eventAt(id, ev)) sendEvent(client, ev);
+    }
+}
+
+void PositionStream::sendEvent(AsyncEventSourceClient* client, const StreamEvent& ev) {
+    char buf[224];
+    if (encode_event_json(ev, buf, sizeof(buf)) == 0) return;
+    const char* name = (ev.type == STREAM_EVT_FIX) ? "fix" : "anchor";
+    if (client) client->send(buf, name, ev.id);
+    else        _events.send(buf, name, ev.id);
+}
+
+// Codifica el evento una vez por formato en uso y lo envía a cada suscriptor
+void PositionStream::sendWs(const StreamEvent& ev, const WsSubscriber* subs, size_t nSubs) {
+    uint8_t bufs[3][224];
+    size_t  lens[3] = { 0, 0, 0 };
+    bool    done[3] = { false, false, false };
+
+    for (size_t i = 0; i < nSubs; i++) {
+        const uint8_t f = subs[i].fmt;
+        if (!done[f]) {
+            lens[f] = encode_event((StreamFormat)f, ev, bufs[f], sizeof(bufs[f]));
+            done[f] = true;
+        }
+        if (lens[f] == 0) continue;
+        if (f == FORMAT_JSON) _ws.text(subs[i].id, bufs[f], lens[f]);
+        else                  _ws.binary(subs[i].id, bufs[f], lens[f]);
+    }
+}
+
+void PositionStream::onWsEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+    if (type == WS_EVT_CONNECT) {
+        // En la conexión "arg" es la petición HTTP de upgrade
+        AsyncWebServerRequest* request = (AsyncWebServerRequest*)arg;
+        StreamFormat fmt = FORMAT_JSON;
+        if (request && request->hasParam("fmt")) fmt = parse_stream_format(request->getParam("fmt")->value().c_str());
+        setWsFormat(client->id(), fmt);
+    } else if (type == WS_EVT_DISCONNECT) {
+        removeWs(client->id());
+    } else if (type == WS_EVT_DATA) {
+        // Cambio de codificación: mensaje de texto completo "fmt=<nombre>"
+        AwsFrameInfo* info = (AwsFrameInfo*)arg;
+        if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT &&
+            len > 4 && len < 16 && memcmp(data, "fmt=", 4) == 0) {
+            char name[16];
+            memcpy(name, data + 4, len - 4);
+            name[len - 4] = '\0';
+            setWsFormat(client->id(), parse_stream_format(name));
+        }
+    }
+}
+
+void PositionStream::setWsFormat(uint32_t id, StreamFormat fmt) {
+    portENTER_CRITICAL(&_lock);
+    WsSubscriber* freeSlot = nullptr;
+    WsSubscriber* slot = nullptr;
+    for (auto& sub : _wsSubs) {
+        if (sub.id == id) { slot = &sub; break; }
+        if (sub.id == 0 && !freeSlot) freeSlot = &sub;
+    }
+    if (!slot) slot = freeSlot;
+    if (slot) {
+        slot->id  = id;
+        slot->fmt = fmt;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+void PositionStream::removeWs(uint32_t id) {
+    portENTER_CRITICAL(&_lock);
+    for (auto& sub : _wsSubs) {
+        if (sub.id == id) sub.id = 0;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+// Serializa un fix sintético en cada formato y reporta bytes/fix y µs/fix
+void PositionStream::benchmark(Print& out, uint32_t iterations) {
+    StreamEvent ev;
+    ev.id = 1;
+    ev.type = STREAM_EVT_FIX;
+    ev.fix.tag_uid = 0x0A0B0C0D;
+    ev.fix.pos = { 12.345f, 6.789f, 1.234f };
+    ev.fix.rms = 0.042f;
+    ev.fix.anchors = 4;
+    ev.fix.is3D = true;
+    ev.fix.t_ms = millis();
+
+    static const char* const names[3] = { "json", "msgpack", "struct" };
+    uint8_t buf[224];
+    out.printf("# formato bytes_por_fix us_por_fix (n=%lu)\n", (unsigned long)iterations);
+    for (uint8_t f = FORMAT_JSON; f <= FORMAT_STRUCT; f++) {
+        size_t bytes = 0;
+        const uint32_t t0 = micros();
+        for (uint32_t i = 0; i < iterations; i++) {
+            ev.fix.seq = (uint16_t)i;
+            bytes = encode_event((StreamFormat)f, ev, buf, sizeof(buf));
+        }
+        const uint32_t dt = micros() - t0;
+        out.printf("%s %u %.2f\n", names[f], (unsigned)bytes, (float)dt / iterations);
+    }
+}
+
+// Emite "anchor" en cada transición online/caída y como latido periódico
+void PositionStream::checkAnchors() {
+    if (!_manager) return;
+    const uint32_t now = millis();
+    const bool heartbeat = (now - _lastHealthMs) >= ANCHOR_HEALTH_PERIOD_MS;
+    if (heartbeat) _lastHealthMs = now;
+
+    AnchorEntry entry;
+    for (size_t i = 0; i < _manager->anchorCount(); i++) {
+        if (!_manager->readAnchor(i, entry)) continue;
+        const DecodedAnchorReport_t& data = entry.report;
+        const uint16_t saddr = data.anchor_saddr;
+        AnchorHealth h;
+        h.anchor_saddr = saddr;
+        h.age_ms       = now - data.rx_ms;
+        h.online       = !entry.staleAt(now);
+        h.tag_uid      = data.tag_uid;
+        h.seq          = data.seq;
+        h.range_m      = data.range_m;
+        h.std_noise    = data.std_noise;
+        h.cir_pwr      = data.cir_pwr;
+
+        auto it = _anchorOnline.find(saddr);
+        const bool changed = (it == _anchorOnline.end()) || (it->second != h.online);
+        _anchorOnline[saddr] = h.online;
+
+        if (changed || heartbeat) {
+            StreamEvent ev;
+            ev.type   = STREAM_EVT_ANCHOR;
+            ev.anchor = h;
+            push(ev);
+        }
+    }
+}
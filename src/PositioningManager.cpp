@@ -1,41 +1,581 @@
 #include "PositioningManager.h"
 #include <cmath> // Para fabs y sqrt
-
-PositioningManager::PositioningManager(int minAnchors) : _minAnchors(minAnchors) {}
+#include <string.h>
+#include <algorithm>
+#include "PerfProbe.h"
+#include "AsyncLog.h"
+
+PositioningManager::PositioningManager(int minAnchors)
+    : _nextDeadlineMs(0), _version(0), _closedSequences(0), _lingering(0), _lastSweepMs(0), _anchorCount(0), _tagCount(0) {
+    _policy.min_anchors = (uint8_t)minAnchors;
+}
 
 void PositioningManager::setAnchorPosition(uint16_t anchor_saddr, float x, float y, float z) {
     _anchorPositions[anchor_saddr] = {x, y, z};
 }
 
 Point PositioningManager::getLastTagPosition() const {
-    return _lastTagPosition;
+    Point p;
+    _lastTagPosition.read(p);
+    return p;
+}
+
+uint32_t PositioningManager::getVersion() const {
+    return _version.load(std::memory_order_acquire);
+}
+
+size_t PositioningManager::anchorCount() const {
+    return _anchorCount.load(std::memory_order_acquire);
+}
+
+bool PositioningManager::readAnchor(size_t index, AnchorEntry& out) const {
+    if (index >= anchorCount()) return false;
+    return _anchors[index].read(out);
+}
+
+size_t PositioningManager::tagCount() const {
+    return _tagCount.load(std::memory_order_acquire);
+}
+
+bool PositioningManager::readTag(size_t index, TagFix& out) const {
+    if (index >= tagCount()) return false;
+    return _tags[index].read(out);
+}
+
+bool PositioningManager::readTagTelemetry(size_t index, TagTelemetryEntry& out) const {
+    if (index >= tagCount()) return false;
+    return _tagTelemetry[index].read(out);
+}
+
+const std::map<uint16_t, Point>& PositioningManager::getAnchorPositions() const {
+    return _anchorPositions;
+}
+
+void PositioningManager::addFixListener(FixListener listener) {
+    _fixListeners.push_back(listener);
+}
+
+void PositioningManager::setPolicy(const AnchorPolicy& policy) {
+    std::lock_guard<std::mutex> lock(_writerLock);
+    _policy = policy;
+    if (_policy.min_anchors < ANCHORS_MIN_SOLVE) _policy.min_anchors = ANCHORS_MIN_SOLVE;
+    if (_policy.min_anchors > MAX_ANCHORS) _policy.min_anchors = MAX_ANCHORS;
+}
+
+AnchorPolicy PositioningManager::policy() const {
+    std::lock_guard<std::mutex> lock(_writerLock);
+    return _policy;
+}
+
+const char* PositioningManager::policyModeName(AnchorPolicyMode mode) {
+    return mode == POLICY_LATENCY_FIRST ? "latency" : "accuracy";
+}
+
+bool PositioningManager::parsePolicyMode(const char* name, AnchorPolicyMode& out) {
+    if (strcmp(name, "latency") == 0)  { out = POLICY_LATENCY_FIRST;  return true; }
+    if (strcmp(name, "accuracy") == 0) { out = POLICY_ACCURACY_FIRST; return true; }
+    return false;
+}
+
+// Sin plazos vencidos no toma el lock: loop() no compite con la tarea Wi-Fi
+void PositioningManager::poll() {
+    const uint32_t deadline = _nextDeadlineMs.load(std::memory_order_acquire);
+    if (deadline == 0) return;
+    const uint32_t now = millis();
+    if ((int32_t)(now - deadline) < 0) return;
+    std::lock_guard<std::mutex> lock(_writerLock);
+    fireDeadlines(now);
+}
+
+void PositioningManager::addAnchorReport(const DecodedAnchorReport_t& received) {
+    std::lock_guard<std::mutex> lock(_writerLock);
+    DecodedAnchorReport_t report = received;
+    const uint64_t key = sequenceKey(report.tag_uid, report.seq);
+    PendingSequence* sequence = nullptr;
+    {
+        PERF_SCOPE(PERF_CORRELATE);
+        _stats.reports_received++;
+
+        const uint32_t now = millis();
+        if (now - _lastSweepMs >= SEQUENCE_SWEEP_MS) {
+            _lastSweepMs = now;
+            sweepAnchors(now);
+            expireSequences(now);
+        }
+        const uint32_t deadline = _nextDeadlineMs.load(std::memory_order_relaxed);
+        if (deadline != 0 && (int32_t)(now - deadline) >= 0) fireDeadlines(now);
+
+        // Casilla del ancla. Una nueva recibe la siguiente libre, pero solo se
+        // registra en _anchorIndex si el reporte pasa los filtros de abajo:
+        // _anchorCount avanza en updateAnchorStats y, si no, la próxima ancla
+        // nueva recibiría la misma casilla.
+        auto itIdx = _anchorIndex.find(report.anchor_saddr);
+        int slot = -1;
+        const bool newAnchor = itIdx == _anchorIndex.end();
+        if (!newAnchor) {
+            slot = itIdx->second;
+        } else if (_anchorCount.load(std::memory_order_relaxed) < MAX_ANCHORS) {
+            slot = _anchorCount.load(std::memory_order_relaxed);
+        } else {
+            _stats.anchor_table_full++;
+        }
+        // Un reporte muy atrasado ya no completa su secuencia (o es de una
+        // vuelta anterior del contador); una retransmisión no debe contar dos
+        // veces ni pisar la lectura guardada
+        const int tagSlot = tagSlotFor(report.tag_uid);
+        TagSeqWindows& windows = _seqWindows[tagSlot];
+        if (!orderSequence(report.tag_uid, windows, report.seq, now)) {
+            _stats.reports_stale++;
+            return;
+        }
+        if (slot >= 0 && !windows.anchors[slot].accept(report.seq)) {
+            _stats.reports_duplicate++;
+            return;
+        }
+        if (newAnchor && slot >= 0) _anchorIndex[report.anchor_saddr] = (uint8_t)slot;
+        // Un solo reloj desde acá: la medición en millis() del concentrador
+        report.meas_ms = _timebase.toLocal(slot, report.t_ms, report.rx_ms);
+        _stats.clock_resyncs = _timebase.resyncs();
+        if (slot >= 0) updateAnchorStats(slot, report);
+
+        // v1 y RANGE_FULL: el bloque del tag se empaqueta solo la primera vez por seq
+        if (report.has_telemetry && claimTelemetry(windows, report.seq, now)) {
+            publishTelemetry(tagSlot, report.seq, pack_tag_telemetry(report), report.rx_ms);
+        }
+
+        auto itSeq = _sequenceData.find(key);
+        if (itSeq == _sequenceData.end()) {
+            if (_sequenceData.size() - _lingering >= MAX_PENDING_SEQUENCES) {
+                _stats.reports_dropped++;
+                return;
+            }
+            itSeq = _sequenceData.emplace(key, PendingSequence()).first;
+            itSeq->second.first_ms = report.meas_ms;
+            itSeq->second.expected = expectedAnchors(report.tag_uid);
+            countPending();
+        }
+        PendingSequence& seq = itSeq->second;
+        if (slot >= 0) seq.present |= (1UL << slot);
+        seq.readings[report.anchor_saddr] = report;
+        if (seq.solved) {
+            // Tardío: no cambia el fix ya publicado, pero enseña qué anclas oyen al tag
+            _stats.reports_late++;
+            return;
+        }
+
+        const size_t n = seq.readings.size();
+        if (n >= requiredAnchors()) {
+            const bool allExpected = (seq.present & seq.expected) == seq.expected;
+            if (_policy.mode == POLICY_LATENCY_FIRST || allExpected || _policy.wait_ms == 0) {
+                if (seq.deadline_ms != 0 && allExpected) _stats.solves_early++;
+                sequence = &seq;
+            } else if (seq.deadline_ms == 0) {
+                // Mínimo alcanzado: se espera un poco a las anclas que faltan
+                seq.deadline_ms = now + _policy.wait_ms;
+                if (seq.deadline_ms == 0) seq.deadline_ms = 1;
+                const uint32_t next = _nextDeadlineMs.load(std::memory_order_relaxed);
+                if (next == 0 || (int32_t)(seq.deadline_ms - next) < 0) {
+                    _nextDeadlineMs.store(seq.deadline_ms, std::memory_order_release);
+                }
+            }
+        } else if (_stats.anchors_live < anchorCount() && n >= _stats.anchors_live) {
+            // Hay anclas caídas, ya reportaron todas las vivas y no alcanzan:
+            // no tiene sentido esperar a SEQUENCE_TIMEOUT_MS
+            _stats.sequences_short++;
+            _stats.reports_dropped += n;
+            closeSequence(key, seq);
+            _sequenceData.erase(itSeq);
+            countPending();
+            return;
+        }
+    }
+
+    if (sequence && !solveSequence(key, *sequence)) {
+        closeSequence(key, *sequence);
+        _sequenceData.erase(key);
+    }
+}
+
+void PositioningManager::addTagTelemetry(const TagTelemetryRecord_t& record, uint32_t rx_ms) {
+    std::lock_guard<std::mutex> lock(_writerLock);
+    const int slot = tagSlotFor(record.tag_uid);
+    if (claimTelemetry(_seqWindows[slot], record.seq, millis())) {
+        publishTelemetry(slot, record.seq, record.telemetry, rx_ms);
+    }
+}
+
+// true si el bloque de esta seq es nuevo (posterior al último incorporado,
+// en aritmética de 16 bits); false si es una copia o llegó tarde. Tras un
+// reinicio del orden del tag, o SEQ_RESTART_MS sin reportes aceptados,
+// cualquier seq vale: el tag pudo reiniciar su contador.
+bool PositioningManager::claimTelemetry(TagSeqWindows& windows, uint16_t seq, uint32_t now) {
+    if (windows.telemetry_seen && now - windows.last_ms < SEQ_RESTART_MS &&
+        (int16_t)(seq - windows.telemetry_seq) <= 0) {
+        _stats.telemetry_redundant++;
+        return false;
+    }
+    windows.telemetry_seq = seq;
+    windows.telemetry_seen = true;
+    return true;
+}
+
+void PositioningManager::publishTelemetry(int slot, uint16_t seq, const TagTelemetry_t& data, uint32_t rx_ms) {
+    TagTelemetryEntry entry;
+    entry.data    = data;
+    entry.seq     = seq;
+    entry.rx_ms   = rx_ms;
+    entry.epoch_ms = _timebase.tagEpochMs(slot, data);
+    entry.version = _version.load(std::memory_order_relaxed) + 1;
+    _tagTelemetry[slot].write(entry);
+    _version.store(entry.version, std::memory_order_release);
+    _stats.telemetry_updates++;
+}
+
+// Resuelve y publica. La secuencia queda en la tabla como resuelta durante
+// POLICY_LINGER_MS para registrar los reportes tardíos, si hay cupo entre
+// las MAX_LINGER_SEQUENCES; si no, devuelve false y el llamador la cierra ya.
+bool PositioningManager::solveSequence(uint64_t sequence_key, PendingSequence& sequence) {
+    _stats.sequences_completed++;
+    LOG_D("[POS] Tag 0x%X secuencia %u completa con %u anclas. Calculando posición...\n",
+          (uint32_t)(sequence_key >> 16), (unsigned)(sequence_key & 0xFFFF), sequence.readings.size());
+
+    TagFix fix;
+    bool solved;
+    {
+        PERF_SCOPE(PERF_SOLVE);
+        solved = calculateTagPosition(sequence_key, fix);
+    }
+    sequence.solved = true;
+    sequence.solved_ms = millis();
+    sequence.deadline_ms = 0;
+    if (solved) {
+        PERF_SCOPE(PERF_PUBLISH);
+        publishFix(fix);
+    }
+    if (_lingering >= MAX_LINGER_SEQUENCES) {
+        _stats.lingering_full++;
+        return false;
+    }
+    _lingering++;
+    return true;
 }
 
-const std::map<uint16_t, DecodedAnchorReport_t>& PositioningManager::getAnchorDataMap() const {
-    return _latestAnchorData;
+// Resuelve las secuencias con plazo vencido y recalcula el próximo plazo
+void PositioningManager::fireDeadlines(uint32_t now) {
+    uint32_t next = 0;
+    for (auto it = _sequenceData.begin(); it != _sequenceData.end(); ) {
+        PendingSequence& seq = it->second;
+        if (seq.deadline_ms != 0 && (int32_t)(now - seq.deadline_ms) >= 0) {
+            _stats.solves_deadline++;
+            if (!solveSequence(it->first, seq)) {
+                closeSequence(it->first, seq);
+                it = _sequenceData.erase(it);
+                continue;
+            }
+        } else if (seq.deadline_ms != 0 && (next == 0 || (int32_t)(seq.deadline_ms - next) < 0)) {
+            next = seq.deadline_ms;
+        }
+        ++it;
+    }
+    _nextDeadlineMs.store(next, std::memory_order_release);
+    countPending();
+}
+
+// Cierra las secuencias resueltas tras POLICY_LINGER_MS y descarta las que
+// no completaron anclas a tiempo (reportes perdidos)
+void PositioningManager::expireSequences(uint32_t now) {
+    for (auto it = _sequenceData.begin(); it != _sequenceData.end(); ) {
+        const PendingSequence& seq = it->second;
+        if (seq.solved) {
+            if (now - seq.solved_ms < POLICY_LINGER_MS) { ++it; continue; }
+            _lingering--;
+        } else if (now - seq.first_ms >= SEQUENCE_TIMEOUT_MS) {
+            _stats.sequences_expired++;
+            _stats.reports_dropped += seq.readings.size();
+        } else {
+            ++it;
+            continue;
+        }
+        closeSequence(it->first, seq);
+        it = _sequenceData.erase(it);
+    }
+    countPending();
+}
+
+// Secuencias sin resolver: las que ocupan MAX_PENDING_SEQUENCES
+void PositioningManager::countPending() {
+    _stats.pending_sequences = _sequenceData.size() - _lingering;
+    _stats.lingering_sequences = _lingering;
+    if (_stats.pending_sequences > _stats.pending_high_water) {
+        _stats.pending_high_water = _stats.pending_sequences;
+    }
+}
+
+// Anclas que suelen oír al tag (y no están caídas). Un tag sin historial no
+// espera a nadie: se resuelve con el mínimo mientras se aprende.
+uint32_t PositioningManager::expectedAnchors(uint32_t tag_uid) {
+    auto it = _profiles.find(tag_uid);
+    if (it == _profiles.end()) return 0;
+    uint32_t mask = 0;
+    const uint8_t count = _anchorCount.load(std::memory_order_relaxed);
+    for (uint8_t i = 0; i < count; i++) {
+        if (it->second.hear[i] >= POLICY_EXPECT_THRESHOLD && !_anchors[i].peek().stats.stale) mask |= (1UL << i);
+    }
+    return mask;
+}
+
+// Actualiza el perfil del tag con las anclas que reportaron (incluidos los
+// tardíos). Las anclas caídas no se penalizan: no pudieron oírlo.
+void PositioningManager::learnSequence(uint32_t tag_uid, const PendingSequence& sequence) {
+    auto it = _profiles.find(tag_uid);
+    if (it == _profiles.end()) {
+        if (_profiles.size() >= POLICY_MAX_PROFILES) {
+            auto oldest = _profiles.begin();
+            for (auto p = _profiles.begin(); p != _profiles.end(); ++p) {
+                if ((int32_t)(p->second.last_ms - oldest->second.last_ms) < 0) oldest = p;
+            }
+            _profiles.erase(oldest);
+        }
+        it = _profiles.emplace(tag_uid, TagProfile()).first;
+    }
+    TagProfile& profile = it->second;
+    profile.last_ms = sequence.first_ms;
+    const uint8_t count = _anchorCount.load(std::memory_order_relaxed);
+    for (uint8_t i = 0; i < count; i++) {
+        const bool heard = sequence.present & (1UL << i);
+        if (!heard && _anchors[i].peek().stats.stale) continue;
+        const int h = profile.hear[i];
+        profile.hear[i] = (uint8_t)(h + (((heard ? 255 : 0) - h) >> POLICY_LEARN_SHIFT));
+    }
+}
+
+// Ordena el seq contra el más nuevo del tag con aritmética de 16 bits
+// (RFC 1982): adelante hasta 32767 es más nuevo, aunque haya dado la vuelta.
+// Acepta hasta SEQ_REORDER_WINDOW seqs de atraso. Se acepta cualquier seq y
+// se reinicia el orden (el tag pudo reiniciar su contador) si no hubo
+// reportes aceptados en SEQ_RESTART_MS o si llegan SEQ_RESYNC_STALE
+// atrasados seguidos: un tag que reinició rápido no calla lo suficiente.
+bool PositioningManager::orderSequence(uint32_t tag_uid, TagSeqWindows& windows, uint16_t seq, uint32_t now) {
+    bool restart = !windows.seen || now - windows.last_ms >= SEQ_RESTART_MS;
+    const int16_t d = (int16_t)(seq - windows.newest);
+    if (!restart && d < -SEQ_REORDER_WINDOW) {
+        if (++windows.stale_run < SEQ_RESYNC_STALE) return false;
+        _stats.seq_resyncs++;
+        restart = true;
+    }
+    windows.last_ms = now;
+    windows.stale_run = 0;
+    if (restart) {
+        for (SeqWindow& w : windows.anchors) w = SeqWindow();
+        windows.newest = seq;
+        windows.seen = true;
+        windows.telemetry_seen = false;
+        return true;
+    }
+    if (d > 0) {
+        windows.newest = seq;
+        ageSequences(tag_uid, seq);
+    }
+    return true;
+}
+
+// Las secuencias del tag sin resolver que quedaron más de
+// SEQ_REORDER_WINDOW detrás de la más nueva ya no pueden completarse: se
+// cierran sin esperar a SEQUENCE_TIMEOUT_MS. Las claves de un tag son
+// contiguas en el mapa; el orden entre ellas es el de seq crudo, por eso se
+// comparan todas con aritmética de serie.
+void PositioningManager::ageSequences(uint32_t tag_uid, uint16_t newest) {
+    auto it = _sequenceData.lower_bound(sequenceKey(tag_uid, 0));
+    const auto end = _sequenceData.upper_bound(sequenceKey(tag_uid, 0xFFFF));
+    while (it != end) {
+        const PendingSequence& seq = it->second;
+        const uint16_t s = (uint16_t)(it->first & 0xFFFF);
+        if (seq.solved || (int16_t)(newest - s) <= SEQ_REORDER_WINDOW) {
+            ++it;
+            continue;
+        }
+        _stats.sequences_aged++;
+        _stats.reports_dropped += seq.readings.size();
+        closeSequence(it->first, seq);
+        it = _sequenceData.erase(it);
+    }
+    countPending();
+}
+
+// Incorpora el reporte a la casilla del ancla y actualiza sus medias
+// móviles: O(1) por reporte, sin historial.
+void PositioningManager::updateAnchorStats(int slot, const DecodedAnchorReport_t& report) {
+    AnchorEntry entry = _anchors[slot].peek();
+    AnchorStats& st = entry.stats;
+    const float a = ANCHOR_EMA_ALPHA;
+
+    if (entry.reports == 0) {
+        st.range_mean = report.range_m;
+        st.noise_mean = report.std_noise;
+        st.cir_mean   = report.cir_pwr;
+        st.participation = 1.0f;   // se supone presente hasta que falte
+        st.participation_at = _closedSequences.load(std::memory_order_relaxed);
+        _stats.anchors_live++;
+    } else {
+        // Tras una caída el silencio no cuenta como intervalo
+        if (!st.stale) {
+            const float dt = (float)(report.rx_ms - entry.report.rx_ms);
+            st.interval_ms = (st.interval_ms > 0.0f) ? st.interval_ms + a * (dt - st.interval_ms) : dt;
+        } else {
+            st.stale = false;
+            _stats.anchors_live++;
+        }
+        // Media y varianza exponenciales (West): var = (1-a)(var + a*d²)
+        const float d = report.range_m - st.range_mean;
+        st.range_mean += a * d;
+        st.range_var   = (1.0f - a) * (st.range_var + a * d * d);
+        st.noise_mean += a * ((float)report.std_noise - st.noise_mean);
+        st.cir_mean   += a * ((float)report.cir_pwr - st.cir_mean);
+    }
+    // Retardo de entrega y reloj del ancla según la base de tiempo
+    const float latency = (float)(report.rx_ms - report.meas_ms);
+    st.latency_ms = (entry.reports > 0) ? st.latency_ms + a * (latency - st.latency_ms) : latency;
+    st.clock_offset_ms = _timebase.offsetMs(slot);
+    st.clock_drift_ppm = _timebase.driftPpm(slot);
+    if (report.rx_rssi != 0) {
+        st.rssi_dbm = (st.rssi_dbm != 0.0f) ? st.rssi_dbm + a * ((float)report.rx_rssi - st.rssi_dbm)
+                                            : (float)report.rx_rssi;
+    }
+
+    entry.report     = report;
+    entry.version    = _version.load(std::memory_order_relaxed) + 1;
+    entry.reports   += 1;
+    entry.range_sum += report.range_m;
+    _anchors[slot].write(entry);
+    // El contador se publica después de escribir la casilla nueva
+    if (slot == _anchorCount.load(std::memory_order_relaxed)) {
+        _anchorCount.store((uint8_t)(slot + 1), std::memory_order_release);
+    }
+    _version.store(entry.version, std::memory_order_release);
+}
+
+// Marca como caídas las anclas que dejaron de reportar (y publica el cambio)
+void PositioningManager::sweepAnchors(uint32_t now) {
+    const uint8_t count = _anchorCount.load(std::memory_order_relaxed);
+    uint32_t live = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const AnchorEntry& cur = _anchors[i].peek();
+        const bool stale = cur.staleAt(now);
+        if (!stale) live++;
+        if (stale == cur.stats.stale) continue;
+        AnchorEntry entry = cur;
+        entry.stats.stale = stale;
+        entry.version = _version.load(std::memory_order_relaxed) + 1;
+        _anchors[i].write(entry);
+        _version.store(entry.version, std::memory_order_release);
+        if (stale) LOG_I("[POS] Ancla 0x%X sin reportes, se deja de esperar.\n", entry.report.anchor_saddr);
+    }
+    _stats.anchors_live = live;
+}
+
+// Al cerrar una secuencia (resuelta, corta o expirada) se aprende qué anclas
+// oyen al tag y se actualiza la participación: 1 a las que reportaron. Solo
+// se escriben sus casillas; para el resto el 0 se aplica al leer
+// (participationAt), con la cuenta de secuencias cerradas.
+void PositioningManager::closeSequence(uint64_t sequence_key, const PendingSequence& sequence) {
+    learnSequence((uint32_t)(sequence_key >> 16), sequence);
+    const uint32_t closed = _closedSequences.load(std::memory_order_relaxed) + 1;
+    for (uint32_t present = sequence.present; present != 0; present &= present - 1) {
+        const int i = __builtin_ctz(present);
+        AnchorEntry entry = _anchors[i].peek();
+        AnchorStats& st = entry.stats;
+        const float p = st.participationAt(closed - 1);
+        st.participation = p + ANCHOR_EMA_ALPHA * (1.0f - p);
+        st.participation_at = closed;
+        _anchors[i].write(entry);
+    }
+    // Después de las casillas: un lector con la cuenta vieja no decae de más
+    _closedSequences.store(closed, std::memory_order_release);
+}
+
+// Anclas necesarias para resolver: min_anchors de la política, descontando
+// las caídas (no se las espera) hasta el mínimo que admite el solver
+size_t PositioningManager::requiredAnchors() const {
+    const size_t minAnchors = _policy.min_anchors;
+    const uint32_t stale = _anchorCount.load(std::memory_order_relaxed) - _stats.anchors_live;
+    const size_t floor = (minAnchors < ANCHORS_MIN_SOLVE) ? minAnchors : ANCHORS_MIN_SOLVE;
+    const size_t required = (minAnchors > stale) ? minAnchors - stale : 0;
+    return required > floor ? required : floor;
+}
+
+// Casilla del tag; si la tabla está llena se recicla la del tag que hace
+// más tiempo no reporta. Un tag nuevo la abre ya en su primer reporte (su
+// estado de orden vive ahí) con un TagFix en versión 0, que /data no lista
+// hasta el primer fix.
+int PositioningManager::tagSlotFor(uint32_t tag_uid) {
+    auto it = _tagIndex.find(tag_uid);
+    if (it != _tagIndex.end()) return it->second;
+
+    const uint8_t count = _tagCount.load(std::memory_order_relaxed);
+    uint8_t slot = count;
+    if (count == MAX_TAGS) {
+        slot = 0;
+        for (uint8_t i = 1; i < MAX_TAGS; i++) {
+            if ((int32_t)(_seqWindows[i].last_ms - _seqWindows[slot].last_ms) < 0) slot = i;
+        }
+        _tagIndex.erase(_tags[slot].peek().tag_uid);
+        _tagTelemetry[slot].write(TagTelemetryEntry());
+    }
+    _tagIndex[tag_uid] = slot;
+    _seqWindows[slot] = TagSeqWindows();
+    _seqWindows[slot].last_ms = millis();
+    TagFix empty;
+    empty.tag_uid = tag_uid;
+    _tags[slot].write(empty);
+    if (slot == count) _tagCount.store((uint8_t)(count + 1), std::memory_order_release);
+    return slot;
 }
 
-void PositioningManager::addAnchorReport(const DecodedAnchorReport_t& report) {
-    _latestAnchorData[report.anchor_saddr] = report;
-    _sequenceData[report.seq][report.anchor_saddr] = report;
+// Momento de la secuencia: mediana de las mediciones de sus anclas (un
+// reporte con el reloj recién reiniciado no la mueve)
+uint32_t PositioningManager::sequenceTime(const std::map<uint16_t, DecodedAnchorReport_t>& readings) {
+    int32_t rel[MAX_ANCHORS];
+    size_t n = 0;
+    const uint32_t base = readings.begin()->second.meas_ms;
+    for (const auto& kv : readings) {
+        if (n == MAX_ANCHORS) break;
+        rel[n++] = (int32_t)(kv.second.meas_ms - base);
+    }
+    std::nth_element(rel, rel + n / 2, rel + n);
+    return base + (uint32_t)rel[n / 2];
+}
 
-    if (_sequenceData[report.seq].size() >= _minAnchors) {
-        DEBUG_PRINTF("\n[POS] Secuencia %u completa con %d anclas. Calculando posición...\n", report.seq, _sequenceData[report.seq].size());
-        calculateTagPosition(report.seq);
-        _sequenceData.erase(report.seq);
+void PositioningManager::publishFix(TagFix& fix) {
+    fix.version = _version.load(std::memory_order_relaxed) + 1;
+    // Latencia de punta a punta: desde la medición en las anclas
+    const int32_t latency = (int32_t)(millis() - fix.t_ms);
+    if (latency >= 0) {
+        _stats.fix_latency_ms = (_stats.solves_ok > 1)
+            ? _stats.fix_latency_ms + ANCHOR_EMA_ALPHA * ((float)latency - _stats.fix_latency_ms) : (float)latency;
+        if ((uint32_t)latency > _stats.fix_latency_max_ms) _stats.fix_latency_max_ms = (uint32_t)latency;
     }
+
+    _tags[tagSlotFor(fix.tag_uid)].write(fix);
+    _lastTagPosition.write(fix.pos);
+    _version.store(fix.version, std::memory_order_release);
+
+    for (auto& listener : _fixListeners) listener(fix);
 }
 
-void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
+bool PositioningManager::calculateTagPosition(uint64_t sequence_key, TagFix& fix) {
     // Reúne los reportes de esta secuencia
-    auto itSeq = _sequenceData.find(sequence_id);
-    if (itSeq == _sequenceData.end()) return;
+    auto itSeq = _sequenceData.find(sequence_key);
+    if (itSeq == _sequenceData.end()) return false;
 
-    const auto& anchorReadings = itSeq->second;
+    const auto& anchorReadings = itSeq->second.readings;
     const size_t M = anchorReadings.size();
-    if (M < _minAnchors) {
-        DEBUG_PRINTF("[POS] Faltan anclas: %u/%u.\n", (unsigned)M, (unsigned)_minAnchors);
-        return;
+
+    fix.tag_uid = (uint32_t)(sequence_key >> 16);
+    fix.seq     = (uint16_t)(sequence_key & 0xFFFF);
+    fix.anchors = (uint8_t)M;
+    if (M < requiredAnchors()) {
+        LOG_D("[POS] Faltan anclas: %u/%u.\n", (unsigned)M, (unsigned)requiredAnchors());
+        return false;
     }
 
     // 1) Verificar que conocemos posiciones de TODAS las anclas del conjunto
@@ -43,8 +583,9 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
     for (auto const& kv : anchorReadings) {
         uint16_t saddr = kv.first;
         if (_anchorPositions.find(saddr) == _anchorPositions.end()) {
-            DEBUG_PRINTF("[POS] Error: No se conoce la posición del ancla 0x%X\n", saddr);
-            return;
+            LOG_W("[POS] Error: No se conoce la posición del ancla 0x%X\n", saddr);
+            _stats.solves_unknown_anchor++;
+            return false;
         }
         saddrList.push_back(saddr);
     }
@@ -72,12 +613,12 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
 
     // 5) Construir A y b para el sistema lineal (N-1 ecuaciones)
     const size_t rows = (M >= 2 ? M-1 : 0);
-    if (rows == 0) { DEBUG_PRINTLN("[POS] Conjunto insuficiente."); return; }
+    if (rows == 0) { LOG_D("[POS] Conjunto insuficiente.\n"); return false; }
 
     // Matrices pequeñas; resolvemos con normales e inversión cerrada 2x2 o 3x3
     if (almost2D) {
         // ----- Caso 2D: A es (rows)x2, p=[x,y]
-        // A_i = 2*(Ai - A0) en x,y ; b_i = (||Ai||^2-||A0||^2) + (ri^2 - r0^2)
+        // A_i = 2*(Ai - A0) en x,y ; b_i = (||Ai||^2-||A0||^2) - (ri^2 - r0^2)
         double JTJ[2][2] = {{0,0},{0,0}};
         double JTb[2]    = {0,0};
 
@@ -87,7 +628,7 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
             // Ignoramos z en 2D, pero ojo: los rangos incluyen z real; esta es la aproximación estándar en planta.
             const double Ai2 = Apos[i].x*Apos[i].x + Apos[i].y*Apos[i].y;  // ||Ai||^2 en 2D
             const double A02 = x0*x0 + y0*y0;                              // ||A0||^2 en 2D
-            const double bi  = (Ai2 - A02) + (range[i]*range[i] - r0*r0);
+            const double bi  = (Ai2 - A02) - (range[i]*range[i] - r0*r0);
 
             const double a0 = 2.0*dxi;
             const double a1 = 2.0*dyi;
@@ -100,7 +641,11 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
 
         // Resolver (JTJ) p = JTb (2x2)
         const double det = JTJ[0][0]*JTJ[1][1] - JTJ[0][1]*JTJ[1][0];
-        if (fabs(det) < 1e-18) { DEBUG_PRINTLN("[POS] Geometría 2D mal condicionada."); return; }
+        if (fabs(det) < 1e-18) {
+            LOG_W("[POS] Geometría 2D mal condicionada.\n");
+            _stats.solves_ill_conditioned++;
+            return false;
+        }
 
         const double inv00 =  JTJ[1][1]/det;
         const double inv01 = -JTJ[0][1]/det;
@@ -111,18 +656,23 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
         const double y = inv10*JTb[0] + inv11*JTb[1];
         const double z = 0.0; // planta
 
-        _lastTagPosition = { (float)x, (float)y, (float)z };
-
         // RMS de residuo (opcional)
-        double rss=0; 
-        for (size_t i=0;i<M;i++) {
-            const double dx=x - Apos[i].x, dy=y - Apos[i].y;
-            const double Ri = sqrt(dx*dx + dy*dy);
-            const double res = Ri - range[i];
-            rss += res*res;
+        double rss=0;
+        {
+            PERF_SCOPE(PERF_FILTER);
+            for (size_t i=0;i<M;i++) {
+                const double dx=x - Apos[i].x, dy=y - Apos[i].y;
+                const double Ri = sqrt(dx*dx + dy*dy);
+                const double res = Ri - range[i];
+                rss += res*res;
+            }
         }
         const double rms = sqrt(rss / M);
-        DEBUG_PRINTF("[POS] 2D OK (N=%u). Pos=(%.3f, %.3f) RMS=%.3f m\n", (unsigned)M, x, y, rms);
+        LOG_D("[POS] 2D OK (N=%u). Pos=(%.3f, %.3f) RMS=%.3f m\n", (unsigned)M, x, y, rms);
+
+        fix.pos  = { (float)x, (float)y, (float)z };
+        fix.rms  = (float)rms;
+        fix.is3D = false;
     } else {
         // ----- Caso 3D: A es (rows)x3, p=[x,y,z]
         double JTJ[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
@@ -136,7 +686,7 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
             const double dzi = Apos[i].z - z0r;
 
             const double Ai2 = Apos[i].x*Apos[i].x + Apos[i].y*Apos[i].y + Apos[i].z*Apos[i].z;
-            const double bi  = (Ai2 - A02) + (range[i]*range[i] - r0*r0);
+            const double bi  = (Ai2 - A02) - (range[i]*range[i] - r0*r0);
 
             const double a0 = 2.0*dxi;
             const double a1 = 2.0*dyi;
@@ -166,11 +716,15 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
         const double A33 =  (a*e - b*d);
 
         const double det = a*A11 + b*A21 + c*A31;
-        if (fabs(det) < 1e-18) { DEBUG_PRINTLN("[POS] Geometría 3D mal condicionada."); return; }
+        if (fabs(det) < 1e-18) {
+            LOG_W("[POS] Geometría 3D mal condicionada.\n");
+            _stats.solves_ill_conditioned++;
+            return false;
+        }
 
         const double inv[3][3] = {
             { A11/det, A12/det, A13/det },
-            { A21/det, A22/det, A33/det },
+            { A21/det, A22/det, A23/det },
             { A31/det, A32/det, A33/det }
         };
 
@@ -178,17 +732,26 @@ void PositioningManager::calculateTagPosition(uint16_t sequence_id) {
         const double y = inv[1][0]*JTb[0] + inv[1][1]*JTb[1] + inv[1][2]*JTb[2];
         const double z = inv[2][0]*JTb[0] + inv[2][1]*JTb[1] + inv[2][2]*JTb[2];
 
-        _lastTagPosition = { (float)x, (float)y, (float)z };
-
         // RMS de residuo (opcional)
         double rss=0;
-        for (size_t k=0;k<M;k++) {
-            const double dx=x - Apos[k].x, dy=y - Apos[k].y, dz=z - Apos[k].z;
-            const double Ri = sqrt(dx*dx + dy*dy + dz*dz);
-            const double res = Ri - range[k];
-            rss += res*res;
+        {
+            PERF_SCOPE(PERF_FILTER);
+            for (size_t k=0;k<M;k++) {
+                const double dx=x - Apos[k].x, dy=y - Apos[k].y, dz=z - Apos[k].z;
+                const double Ri = sqrt(dx*dx + dy*dy + dz*dz);
+                const double res = Ri - range[k];
+                rss += res*res;
+            }
         }
         const double rms = sqrt(rss / M);
-        DEBUG_PRINTF("[POS] 3D OK (N=%u). Pos=(%.3f, %.3f, %.3f) RMS=%.3f m\n", (unsigned)M, x, y, z, rms);
+        LOG_D("[POS] 3D OK (N=%u). Pos=(%.3f, %.3f, %.3f) RMS=%.3f m\n", (unsigned)M, x, y, z, rms);
+
+        fix.pos  = { (float)x, (float)y, (float)z };
+        fix.rms  = (float)rms;
+        fix.is3D = true;
     }
+
+    fix.t_ms = sequenceTime(anchorReadings);
+    _stats.solves_ok++;
+    return true;
 }
@@ -0,0 +1,170 @@
+#include "RawForwarder.h"
+#include "AsyncLog.h"
+
+RawForwarder::RawForwarder()
+    : _sealed(), _active(0), _batchStartMs(0), _source(0), _nextSeq(0), _mode(FORWARD_DEFAULT_MODE),
+      _port(FORWARD_PORT), _proto(FORWARD_PROTO), _hasHost(false), _target(0),
+      _tcpTarget(0), _lastConnectMs(0), _reconnectMs(0),
+      _forwarded(0), _dropped(0), _batches(0), _sendErrors(0), _bytesSent(0) {
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void RawForwarder::begin(const uint8_t mac[6]) {
+    _source = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+    _batch[0].begin(_source, _nextSeq++);
+    _hasHost = _host.fromString(FORWARD_HOST);
+    DEBUG_PRINTF("[FWD] Modo %s, destino %s:%u (%s)\n", modeName((ForwardMode)_mode.load()),
+                 _hasHost ? _host.toString().c_str() : "-", _port, protoName(_proto));
+}
+
+// Tarea Wi-Fi: copia el frame al batch activo
+void RawForwarder::push(const uint8_t* mac, const uint8_t* frame, int len, int8_t rssi, uint32_t rx_ms) {
+    if (len <= 0 || len > 255) return;
+    portENTER_CRITICAL(&_lock);
+    if (_batch[_active].empty()) _batchStartMs = rx_ms;
+    if (!_batch[_active].add(mac, frame, (uint8_t)len, rssi, rx_ms)) {
+        if (!sealActive()) {
+            _dropped++;
+            portEXIT_CRITICAL(&_lock);
+            return;
+        }
+        _batchStartMs = rx_ms;
+        _batch[_active].add(mac, frame, (uint8_t)len, rssi, rx_ms);
+    }
+    _forwarded++;
+    portEXIT_CRITICAL(&_lock);
+}
+
+// Con _lock tomado: sella el batch activo y abre el otro si está libre
+bool RawForwarder::sealActive() {
+    const uint8_t other = _active ^ 1;
+    if (_sealed[other]) return false;
+    _sealed[_active] = true;
+    _active = other;
+    _batch[_active].begin(_source, _nextSeq++);
+    return true;
+}
+
+void RawForwarder::loop() {
+    if (!active()) return;
+
+    int pending = -1;
+    portENTER_CRITICAL(&_lock);
+    if (!_batch[_active].empty() && millis() - _batchStartMs >= FORWARD_FLUSH_MS) sealActive();
+    for (uint8_t i = 0; i < 2; i++) {
+        if (_sealed[i]) pending = i;
+    }
+    portEXIT_CRITICAL(&_lock);
+    if (pending < 0) return;
+
+    // Solo un batch puede estar sellado a la vez: la tarea Wi-Fi no lo toca
+    RawBatchBuilder& batch = _batch[pending];
+    batch.finish(millis(), _dropped);
+    if (send(batch.data(), batch.size())) {
+        _batches++;
+        _bytesSent += batch.size();
+    } else {
+        _sendErrors++;
+    }
+
+    portENTER_CRITICAL(&_lock);
+    _sealed[pending] = false;
+    portEXIT_CRITICAL(&_lock);
+}
+
+bool RawForwarder::send(const uint8_t* data, size_t len) {
+    portENTER_CRITICAL(&_lock);
+    const IPAddress host = _host;
+    const uint16_t port = _port;
+    const ForwardProto proto = _proto;
+    const uint8_t target = _target;
+    portEXIT_CRITICAL(&_lock);
+
+    // Destino nuevo en /forward: se corta la conexión al anterior y se
+    // reintenta sin esperar
+    if (target != _tcpTarget) {
+        _tcpTarget = target;
+        _tcp.stop();
+        _reconnectMs = 0;
+    }
+
+    if (proto == FORWARD_UDP) {
+        if (!_udp.beginPacket(host, port)) return false;
+        _udp.write(data, len);
+        return _udp.endPacket() == 1;
+    }
+
+    // TCP: el stream se delimita con RawBatchHeader_t::length
+    if (!_tcp.connected()) {
+        const uint32_t now = millis();
+        if (_reconnectMs != 0 && now - _lastConnectMs < _reconnectMs) return false;
+        _lastConnectMs = now;
+        if (!_tcp.connect(host, port, FORWARD_CONNECT_TIMEOUT_MS)) {
+            // Cada intento fallido bloquea loop(): con el servicio caído se
+            // espacian hasta FORWARD_RECONNECT_MAX_MS
+            _reconnectMs = (_reconnectMs == 0) ? FORWARD_RECONNECT_MS
+                         : (_reconnectMs < FORWARD_RECONNECT_MAX_MS / 2) ? _reconnectMs * 2 : FORWARD_RECONNECT_MAX_MS;
+            LOG_W("[FWD] Sin conexión TCP con el servicio (reintento en %lu ms).\n", (unsigned long)_reconnectMs);
+            return false;
+        }
+        _reconnectMs = 0;
+        _tcp.setNoDelay(true);
+    }
+    if (_tcp.write(data, len) == len) return true;
+    _tcp.stop();
+    return false;
+}
+
+void RawForwarder::serve(AsyncWebServer& server) {
+    // /forward?mode=local|raw&host=<ip>&port=<n>&proto=udp|tcp: consulta o cambia el reenvío
+    server.on("/forward", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("host")) {
+            IPAddress host;
+            if (!host.fromString(request->getParam("host")->value())) {
+                return request->send(400, "text/plain", "host debe ser una IP");
+            }
+            portENTER_CRITICAL(&_lock);
+            _host = host;
+            _hasHost = true;
+            _target++;
+            portEXIT_CRITICAL(&_lock);
+        }
+        if (request->hasParam("port")) {
+            const long port = request->getParam("port")->value().toInt();
+            if (port < 1 || port > 65535) return request->send(400, "text/plain", "Puerto inválido");
+            portENTER_CRITICAL(&_lock);
+            _port = (uint16_t)port;
+            _target++;
+            portEXIT_CRITICAL(&_lock);
+        }
+        if (request->hasParam("proto")) {
+            const String& proto = request->getParam("proto")->value();
+            if (proto != "udp" && proto != "tcp") return request->send(400, "text/plain", "Protocolo desconocido");
+            portENTER_CRITICAL(&_lock);
+            _proto = (proto == "tcp") ? FORWARD_TCP : FORWARD_UDP;
+            _target++;
+            portEXIT_CRITICAL(&_lock);
+        }
+        if (request->hasParam("mode")) {
+            const String& mode = request->getParam("mode")->value();
+            if (mode != "local" && mode != "raw") return request->send(400, "text/plain", "Modo desconocido");
+            _mode.store(mode == "raw" ? FORWARD_RAW : FORWARD_LOCAL, std::memory_order_relaxed);
+        }
+
+        portENTER_CRITICAL(&_lock);
+        const IPAddress host = _host;
+        const bool hasHost = _hasHost;
+        const uint16_t port = _port;
+        const ForwardProto proto = _proto;
+        portEXIT_CRITICAL(&_lock);
+        char json[256];
+        snprintf(json, sizeof(json),
+                 "{\"mode\":\"%s\",\"active\":%s,\"host\":\"%s\",\"port\":%u,\"proto\":\"%s\",\"forwarded\":%lu,"
+                 "\"dropped\":%lu,\"batches\":%lu,\"send_errors\":%lu,\"bytes\":%lu}",
+                 modeName((ForwardMode)_mode.load(std::memory_order_relaxed)), active() ? "true" : "false",
+                 hasHost ? host.toString().c_str() : "", port, protoName(proto),
+                 (unsigned long)_forwarded, (unsigned long)_dropped, (unsigned long)_batches,
+                 (unsigned long)_sendErrors, (unsigned long)_bytesSent);
+        request->send(200, "application/json", json);
+    });
+}
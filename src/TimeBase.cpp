@@ -0,0 +1,99 @@
+#include "PositioningManager.h"
+#include <math.h>
+
+void TimeBase::restart(AnchorClock& c, uint32_t anchor_ms, uint32_t rx_ms) {
+    c = AnchorClock();
+    c.anchor_ref = anchor_ms;
+    c.local_ref  = rx_ms;
+    c.synced     = true;
+}
+
+// La época en curso aporta su menor retardo como un punto de la recta. Las
+// primeras épocas pesan 1/n (media acumulada) hasta llegar a TIMEBASE_ALPHA.
+void TimeBase::closeEpoch(AnchorClock& c) {
+    c.epochs++;
+    float a = 1.0f / c.epochs;
+    if (a < TIMEBASE_ALPHA) a = TIMEBASE_ALPHA;
+    const float dx = (float)c.min_x - c.mean_x;
+    const float dy = (float)c.min_y - c.mean_y;
+    c.mean_x += a * dx;
+    c.mean_y += a * dy;
+    c.var_x   = (1.0f - a) * (c.var_x + a * dx * dx);
+    c.cov_xy  = (1.0f - a) * (c.cov_xy + a * dx * dy);
+}
+
+uint32_t TimeBase::toLocal(int anchorSlot, uint32_t anchor_ms, uint32_t rx_ms) {
+    if (anchorSlot < 0 || anchor_ms == 0) return rx_ms;
+    AnchorClock& c = _clocks[anchorSlot];
+    if (!c.synced) restart(c, anchor_ms, rx_ms);
+
+    int32_t x = (int32_t)(anchor_ms - c.anchor_ref);
+    int32_t y = (int32_t)(rx_ms - c.local_ref) - x;
+    const float r = (float)y - c.offsetAt((float)x);
+    if (r > TIMEBASE_RESYNC_MS || r < -TIMEBASE_RESYNC_MS) {
+        // Un tardío aislado se convierte con la recta vigente; varios seguidos
+        // (o llegar "antes" de medir) indican que el reloj del ancla cambió
+        if (++c.outliers < TIMEBASE_RESYNC_COUNT) {
+            return r > 0 ? c.local_ref + (uint32_t)x + (int32_t)lroundf(c.offsetAt((float)x)) : rx_ms;
+        }
+        _resyncs++;
+        restart(c, anchor_ms, rx_ms);
+        x = 0;
+        y = 0;
+    }
+    c.outliers = 0;
+
+    if (x - c.epoch_x >= (int32_t)TIMEBASE_EPOCH_MS) {
+        closeEpoch(c);
+        c.epoch_x = x;
+        c.min_x = x;
+        c.min_y = y;
+    } else if (y < c.min_y || x == c.epoch_x) {
+        c.min_x = x;
+        c.min_y = y;
+    }
+
+    // Origen nuevo cada TIMEBASE_REBASE_MS: x se achica y y no cambia
+    if (x >= (int32_t)TIMEBASE_REBASE_MS) {
+        c.anchor_ref += (uint32_t)x;
+        c.local_ref  += (uint32_t)x;
+        c.mean_x  -= (float)x;
+        c.epoch_x -= x;
+        c.min_x   -= x;
+        x = 0;
+    }
+
+    const uint32_t local = c.local_ref + (uint32_t)x + (int32_t)lroundf(c.offsetAt((float)x));
+    // Entrega más rápida que la recta: se toma la recepción
+    return (int32_t)(rx_ms - local) < 0 ? rx_ms : local;
+}
+
+int32_t TimeBase::offsetMs(int anchorSlot) const {
+    const AnchorClock& c = _clocks[anchorSlot];
+    if (!c.synced) return 0;
+    return (int32_t)(c.local_ref - c.anchor_ref) + (int32_t)lroundf(c.offsetAt((float)c.epoch_x));
+}
+
+// Días desde 1970-01-01 del calendario gregoriano proléptico (H. Hinnant)
+int64_t TimeBase::daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + (int64_t)doe - 719468;
+}
+
+uint64_t TimeBase::tagEpochMs(int tagSlot, const TagTelemetry_t& t) {
+    if (tagSlot < 0 || t.year < 1970 || t.month < 1 || t.month > 12 || t.day < 1 || t.day > 31) return 0;
+    // La casilla se valida con la fecha misma: un tag nuevo en la casilla
+    // solo recalcula si su día es otro
+    CalendarCache& c = _calendars[tagSlot];
+    if (c.year != t.year || c.month != t.month || c.day != t.day) {
+        c.year   = t.year;
+        c.month  = t.month;
+        c.day    = t.day;
+        c.day_ms = daysFromCivil(t.year, t.month, t.day) * 86400000LL;
+    }
+    return (uint64_t)(c.day_ms + ((t.hour * 60 + t.minute) * 60 + t.second) * 1000LL + t.millis);
+}
@@ -0,0 +1,51 @@
+#include "TrailBuffer.h"
+
+TrailBuffer::TrailBuffer() : _work(), _count(0) {}
+
+void TrailBuffer::attach(PositioningManager& manager) {
+    manager.addFixListener([this](const TagFix& fix) { addFix(fix); });
+}
+
+int16_t TrailBuffer::toCm(float m) {
+    return clamp_i16(m * 100.0f);
+}
+
+void TrailBuffer::addFix(const TagFix& fix) {
+    const uint8_t n = _count.load(std::memory_order_relaxed);
+
+    // Casilla del tag; si no existe, una libre o la menos reciente
+    int slot = -1;
+    for (uint8_t i = 0; i < n; i++) {
+        if (_work[i].tag_uid == fix.tag_uid) { slot = i; break; }
+    }
+    if (slot < 0) {
+        if (n < MAX_TAGS) {
+            slot = n;
+        } else {
+            slot = 0;
+            for (uint8_t i = 1; i < MAX_TAGS; i++) {
+                if ((int32_t)(_work[i].last_ms - _work[slot].last_ms) < 0) slot = i;
+            }
+        }
+        _work[slot] = TagTrail();
+        _work[slot].tag_uid = fix.tag_uid;
+    }
+
+    TagTrail& t = _work[slot];
+    t.points[t.head] = { toCm(fix.pos.x), toCm(fix.pos.y), toCm(fix.pos.z) };
+    t.head = (t.head + 1) % TRAIL_LENGTH;
+    if (t.count < TRAIL_LENGTH) t.count++;
+    t.last_ms = fix.t_ms;
+
+    _slots[slot].write(t);
+    if (slot == n) _count.store((uint8_t)(n + 1), std::memory_order_release);
+}
+
+size_t TrailBuffer::count() const {
+    return _count.load(std::memory_order_acquire);
+}
+
+bool TrailBuffer::read(size_t index, TagTrail& out) const {
+    if (index >= count()) return false;
+    return _slots[index].read(out);
+}
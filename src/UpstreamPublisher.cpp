@@ -0,0 +1,370 @@
+#include "UpstreamPublisher.h"
+#include "AsyncLog.h"
+
+#define UPSTREAM_MASK          (UPSTREAM_QUEUE_LEN - 1)
+#define UPSTREAM_UDP_OVERHEAD  28     // IPv4 + UDP
+#define UPSTREAM_TCP_OVERHEAD  40     // IPv4 + TCP sin opciones
+
+UpstreamPublisher::UpstreamPublisher()
+    : _head(0), _tail(0), _len(0), _source(0), _nextSeq(0), _enabled(true), _port(UPSTREAM_PORT),
+      _proto(UPSTREAM_PROTO), _format(UPSTREAM_FORMAT), _hasHost(false), _batchFixes(UPSTREAM_BATCH_FIXES),
+      _flushMs(UPSTREAM_FLUSH_MS), _lastConnectMs(0), _lastTxMs(0), _retryMs(0), _retrying(false),
+      _restart(false), _queued(0), _dropped(0), _published(0), _batches(0), _sendErrors(0), _bytesSent(0),
+      _wireBytes(0), _latencyMs(0.0f), _latencyMaxMs(0) {
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+    _topic[0] = '\0';
+}
+
+void UpstreamPublisher::begin(PositioningManager& manager, const uint8_t mac[6]) {
+    _source = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+    snprintf(_topic, sizeof(_topic), UPSTREAM_MQTT_PREFIX "/%08lx/fixes", (unsigned long)_source);
+    _hasHost = _host.fromString(UPSTREAM_HOST);
+    setBatching(_batchFixes, _flushMs);
+    manager.addFixListener([this](const TagFix& fix) { push(fix); });
+    DEBUG_PRINTF("[UP] Colector %s:%u (%s, %s)\n", _hasHost ? _host.toString().c_str() : "-", _port,
+                 protoName(_proto), formatName(_format));
+}
+
+void UpstreamPublisher::setTarget(const IPAddress& host, uint16_t port, UpstreamProto proto) {
+    portENTER_CRITICAL(&_lock);
+    _host = host;
+    _hasHost = true;
+    _port = port;
+    _proto = proto;
+    portEXIT_CRITICAL(&_lock);
+    _restart.store(true);                            // loop() cierra la conexión MQTT anterior
+}
+
+void UpstreamPublisher::setFormat(UpstreamFormat format) {
+    portENTER_CRITICAL(&_lock);
+    _format = format;
+    portEXIT_CRITICAL(&_lock);
+}
+
+bool UpstreamPublisher::target(IPAddress& host) const {
+    portENTER_CRITICAL(&_lock);
+    host = _host;
+    const bool hasHost = _hasHost;
+    portEXIT_CRITICAL(&_lock);
+    return hasHost;
+}
+
+void UpstreamPublisher::setBatching(uint16_t batch_fixes, uint16_t flush_ms) {
+    if (batch_fixes < 1) batch_fixes = 1;
+    if (batch_fixes > UPSTREAM_BATCH_MAX) batch_fixes = UPSTREAM_BATCH_MAX;
+    if (flush_ms < 1) flush_ms = 1;
+    portENTER_CRITICAL(&_lock);
+    _batchFixes = batch_fixes;
+    _flushMs = flush_ms;
+    portEXIT_CRITICAL(&_lock);
+}
+
+// Contexto del escritor del manager: codificar fuera del lock, copiar dentro
+void UpstreamPublisher::push(const TagFix& fix) {
+    if (!active()) return;
+    StreamEvent ev;
+    ev.type = STREAM_EVT_FIX;
+    ev.fix = fix;
+    Item item;
+    encode_event_struct(ev, (uint8_t*)&item.fix, sizeof(item.fix));
+    item.queued_ms = millis();
+
+    portENTER_CRITICAL(&_lock);
+    if (_tail - _head == UPSTREAM_QUEUE_LEN) {
+        _head++;                                     // descarta el más antiguo
+        _dropped++;
+    }
+    _queue[_tail & UPSTREAM_MASK] = item;
+    _tail++;
+    _queued++;
+    portEXIT_CRITICAL(&_lock);
+}
+
+uint32_t UpstreamPublisher::depth() const {
+    return _tail - _head;
+}
+
+float UpstreamPublisher::efficiency() const {
+    return _wireBytes ? (float)_published * sizeof(BinFixRecord_t) / _wireBytes : 0.0f;
+}
+
+void UpstreamPublisher::loop() {
+    if (!active()) return;
+    if (_restart.exchange(false)) _tcp.stop();
+    // Solo por la STA: sin enlace la cola absorbe el corte (y descarta lo viejo)
+    if (!WiFi.isConnected()) return;
+    const uint32_t now = millis();
+
+    // Una sola copia de la configuración por pasada, la misma para el envío
+    portENTER_CRITICAL(&_lock);
+    const IPAddress host = _host;
+    const uint16_t port = _port;
+    const UpstreamProto proto = _proto;
+    const uint16_t batchFixes = _batchFixes;
+    const uint16_t flushMs = _flushMs;
+    const UpstreamFormat format = _format;
+    portEXIT_CRITICAL(&_lock);
+
+    if (proto == UPSTREAM_MQTT) mqttKeepAlive();
+    if (_retrying && (int32_t)(now - _retryMs) < 0) return;
+    const uint16_t cap = (format == UPSTREAM_JSON) ? UPSTREAM_JSON_BATCH_MAX : UPSTREAM_BATCH_MAX;
+    const uint16_t target = batchFixes < cap ? batchFixes : cap;
+
+    for (uint8_t i = 0; i < UPSTREAM_BATCHES_PER_LOOP; i++) {
+        // Copia del batch bajo el lock: un descarte posterior no lo toca
+        portENTER_CRITICAL(&_lock);
+        const uint32_t first = _head;
+        uint32_t n = _tail - _head;
+        const bool due = n >= target || (n > 0 && now - _queue[first & UPSTREAM_MASK].queued_ms >= flushMs);
+        if (!due) {
+            portEXIT_CRITICAL(&_lock);
+            break;
+        }
+        if (n > target) n = target;
+        for (uint32_t j = 0; j < n; j++) _out[j] = _queue[(first + j) & UPSTREAM_MASK];
+        portEXIT_CRITICAL(&_lock);
+
+        const uint16_t k = encode((uint16_t)n, format, now);
+        const size_t wire = k ? send(_len, host, port, proto) : 0;
+        if (wire == 0) {
+            // Los fixes quedan en cola: reintento tras UPSTREAM_RETRY_MS
+            _sendErrors++;
+            _retrying = true;
+            _retryMs = now + UPSTREAM_RETRY_MS;
+            break;
+        }
+        _retrying = false;
+        _nextSeq++;
+        _batches++;
+        _published += k;
+        _bytesSent += wire;
+        _wireBytes += wire + (proto == UPSTREAM_MQTT ? UPSTREAM_TCP_OVERHEAD : UPSTREAM_UDP_OVERHEAD);
+        for (uint16_t j = 0; j < k; j++) {
+            const uint32_t latency = now - _out[j].queued_ms;
+            _latencyMs = (_batches > 1 || j > 0) ? _latencyMs + ANCHOR_EMA_ALPHA * ((float)latency - _latencyMs)
+                                                 : (float)latency;
+            if (latency > _latencyMaxMs) _latencyMaxMs = latency;
+        }
+
+        portENTER_CRITICAL(&_lock);
+        if ((int32_t)(first + k - _head) > 0) _head = first + k;
+        portEXIT_CRITICAL(&_lock);
+    }
+}
+
+// Arma la carga de los primeros n fixes de _out en _buf + UPSTREAM_HEADROOM.
+// Devuelve cuántos entraron.
+uint16_t UpstreamPublisher::encode(uint16_t n, UpstreamFormat format, uint32_t now) {
+    uint8_t* payload = _buf + UPSTREAM_HEADROOM;
+    if (format == UPSTREAM_BIN) {
+        _batch.begin(_source, _nextSeq, FIX_BATCH_MAGIC);
+        uint16_t k = 0;
+        while (k < n && _batch.addRecord(&_out[k].fix, sizeof(BinFixRecord_t))) k++;
+        _batch.finish(now, _dropped);
+        memcpy(payload, _batch.data(), _batch.size());
+        _len = _batch.size();
+        return k;
+    }
+
+    char* json = (char*)payload;
+    int head = snprintf(json, RAW_BATCH_MAX, "{\"source\":\"%08lx\",\"batch\":%lu,\"sent_ms\":%lu,\"dropped\":%lu,\"fixes\":[",
+                        (unsigned long)_source, (unsigned long)_nextSeq, (unsigned long)now, (unsigned long)_dropped);
+    size_t len = (size_t)head;
+    uint16_t k = 0;
+    for (; k < n; k++) {
+        // Mismo objeto que el SSE: se deshace la cuantización del registro
+        const BinFixRecord_t& r = _out[k].fix;
+        StreamEvent ev;
+        ev.type = STREAM_EVT_FIX;
+        ev.fix.tag_uid = r.tag_uid;
+        ev.fix.seq = r.seq;
+        ev.fix.pos = { r.x_mm / 1000.0f, r.y_mm / 1000.0f, r.z_mm / 1000.0f };
+        ev.fix.rms = r.rms_mm / 1000.0f;
+        ev.fix.anchors = r.anchors;
+        ev.fix.is3D = (r.flags & STREAM_FLAG_3D) != 0;
+        ev.fix.t_ms = r.t_ms;
+        // Reserva la coma y el cierre "]}"
+        const size_t sep = k ? 1 : 0;
+        if (len + sep + 2 >= RAW_BATCH_MAX) break;
+        const size_t w = encode_event_json(ev, json + len + sep, RAW_BATCH_MAX - len - sep - 2);
+        if (w == 0) break;
+        if (sep) json[len] = ',';
+        len += sep + w;
+    }
+    json[len++] = ']';
+    json[len++] = '}';
+    _len = len;
+    return k;
+}
+
+// Envía la carga de _buf + UPSTREAM_HEADROOM al destino copiado por loop();
+// devuelve los bytes enviados (0: falló)
+size_t UpstreamPublisher::send(size_t len, const IPAddress& host, uint16_t port, UpstreamProto proto) {
+    if (proto == UPSTREAM_UDP) {
+        if (!_udp.beginPacket(host, port)) return 0;
+        _udp.write(_buf + UPSTREAM_HEADROOM, len);
+        return _udp.endPacket() == 1 ? len : 0;
+    }
+    if (!_tcp.connected() && !mqttConnect(host, port)) return 0;
+    return mqttPublish(len);
+}
+
+// ============================================================================
+// MQTT 3.1.1 mínimo: CONNECT con sesión limpia, PUBLISH QoS 0 y PINGREQ.
+// No se suscribe a nada: lo que llega del broker (CONNACK, PINGRESP) se lee
+// y se descarta.
+// ============================================================================
+
+// connect() y la espera del CONNACK comparten un solo plazo de
+// UPSTREAM_CONNECT_TIMEOUT_MS contado desde el intento: el CONNACK solo
+// espera lo que connect() no usó.
+bool UpstreamPublisher::mqttConnect(const IPAddress& host, uint16_t port) {
+    const uint32_t start = millis();
+    if (_lastConnectMs != 0 && start - _lastConnectMs < UPSTREAM_RECONNECT_MS) return false;
+    _lastConnectMs = start;
+    if (!_tcp.connect(host, port, UPSTREAM_CONNECT_TIMEOUT_MS)) {
+        LOG_W("[UP] Sin conexión con el broker MQTT.\n");
+        return false;
+    }
+    _tcp.setNoDelay(true);
+
+    char clientId[24];
+    const int idLen = snprintf(clientId, sizeof(clientId), "conc-%08lx", (unsigned long)_source);
+    uint8_t pkt[48];
+    size_t n = 0;
+    pkt[n++] = 0x10;                                 // CONNECT
+    pkt[n++] = (uint8_t)(10 + 2 + idLen);            // remaining length
+    const uint8_t varHeader[] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02,
+                                  (uint8_t)(UPSTREAM_MQTT_KEEPALIVE_S >> 8), (uint8_t)UPSTREAM_MQTT_KEEPALIVE_S };
+    memcpy(pkt + n, varHeader, sizeof(varHeader));
+    n += sizeof(varHeader);
+    pkt[n++] = 0;
+    pkt[n++] = (uint8_t)idLen;
+    memcpy(pkt + n, clientId, idLen);
+    n += idLen;
+    if (_tcp.write(pkt, n) != n) {
+        _tcp.stop();
+        return false;
+    }
+
+    // CONNACK: 0x20 0x02 <flags> <código>, con lo que quede del plazo
+    while (millis() - start < UPSTREAM_CONNECT_TIMEOUT_MS) {
+        if (_tcp.available() >= 4) {
+            uint8_t ack[4];
+            _tcp.read(ack, sizeof(ack));
+            if (ack[0] == 0x20 && ack[3] == 0) {
+                _lastTxMs = millis();
+                return true;
+            }
+            LOG_W("[UP] El broker rechazó la conexión (código %u).\n", ack[3]);
+            break;
+        }
+        delay(1);
+    }
+    _tcp.stop();
+    return false;
+}
+
+// PUBLISH QoS 0: la cabecera se escribe en el hueco delante de la carga
+size_t UpstreamPublisher::mqttPublish(size_t len) {
+    const size_t topicLen = strlen(_topic);
+    const size_t remaining = 2 + topicLen + len;
+    uint8_t lenBytes[2];
+    size_t lenSize = 0;
+    size_t r = remaining;
+    do {
+        lenBytes[lenSize] = r & 0x7F;
+        r >>= 7;
+        if (r) lenBytes[lenSize] |= 0x80;
+        lenSize++;
+    } while (r && lenSize < sizeof(lenBytes));
+
+    const size_t headLen = 1 + lenSize + 2 + topicLen;
+    uint8_t* p = _buf + UPSTREAM_HEADROOM - headLen;
+    p[0] = 0x30;                                     // PUBLISH, QoS 0, sin retain
+    memcpy(p + 1, lenBytes, lenSize);
+    p[1 + lenSize] = (uint8_t)(topicLen >> 8);
+    p[2 + lenSize] = (uint8_t)topicLen;
+    memcpy(p + 3 + lenSize, _topic, topicLen);
+
+    const size_t total = headLen + len;
+    if (_tcp.write(p, total) != total) {
+        _tcp.stop();
+        return 0;
+    }
+    _lastTxMs = millis();
+    return total;
+}
+
+void UpstreamPublisher::mqttKeepAlive() {
+    if (!_tcp.connected()) return;
+    while (_tcp.available() > 0) _tcp.read();
+    if (millis() - _lastTxMs < UPSTREAM_MQTT_KEEPALIVE_S * 1000UL / 2) return;
+    const uint8_t ping[2] = { 0xC0, 0x00 };          // PINGREQ
+    if (_tcp.write(ping, sizeof(ping)) != sizeof(ping)) {
+        _tcp.stop();
+        return;
+    }
+    _lastTxMs = millis();
+}
+
+void UpstreamPublisher::serve(AsyncWebServer& server) {
+    // /upstream?enable=0|1&host=<ip>&port=<n>&proto=udp|mqtt&format=bin|json&batch=<n>&flush_ms=<n>
+    server.on("/upstream", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        portENTER_CRITICAL(&_lock);
+        IPAddress host = _host;
+        bool hasHost = _hasHost;
+        uint16_t port = _port;
+        UpstreamProto proto = _proto;
+        UpstreamFormat format = _format;
+        portEXIT_CRITICAL(&_lock);
+
+        if (request->hasParam("host")) {
+            if (!host.fromString(request->getParam("host")->value())) {
+                return request->send(400, "text/plain", "host debe ser una IP");
+            }
+            hasHost = true;
+        }
+        if (request->hasParam("port")) {
+            const long p = request->getParam("port")->value().toInt();
+            if (p < 1 || p > 65535) return request->send(400, "text/plain", "Puerto inválido");
+            port = (uint16_t)p;
+        }
+        if (request->hasParam("proto")) {
+            const String& p = request->getParam("proto")->value();
+            if (p != "udp" && p != "mqtt") return request->send(400, "text/plain", "Protocolo desconocido");
+            proto = (p == "mqtt") ? UPSTREAM_MQTT : UPSTREAM_UDP;
+        }
+        if (request->hasParam("format")) {
+            const String& f = request->getParam("format")->value();
+            if (f != "bin" && f != "json") return request->send(400, "text/plain", "Formato desconocido");
+            format = (f == "json") ? UPSTREAM_JSON : UPSTREAM_BIN;
+        }
+        if (hasHost && (request->hasParam("host") || request->hasParam("port") || request->hasParam("proto"))) {
+            setTarget(host, port, proto);
+        }
+        setFormat(format);
+        if (request->hasParam("batch") || request->hasParam("flush_ms")) {
+            const long batch = request->hasParam("batch") ? request->getParam("batch")->value().toInt() : _batchFixes;
+            const long flushMs = request->hasParam("flush_ms") ? request->getParam("flush_ms")->value().toInt() : _flushMs;
+            if (batch < 1 || flushMs < 1 || flushMs > 60000) return request->send(400, "text/plain", "batch o flush_ms inválido");
+            setBatching((uint16_t)(batch > 0xFFFF ? 0xFFFF : batch), (uint16_t)flushMs);
+        }
+        if (request->hasParam("enable")) {
+            _enabled.store(request->getParam("enable")->value().toInt() != 0, std::memory_order_relaxed);
+        }
+
+        char json[384];
+        snprintf(json, sizeof(json),
+                 "{\"active\":%s,\"sta\":%s,\"host\":\"%s\",\"port\":%u,\"proto\":\"%s\",\"format\":\"%s\","
+                 "\"batch\":%u,\"flush_ms\":%u,\"queued\":%lu,\"dropped\":%lu,\"published\":%lu,\"batches\":%lu,"
+                 "\"send_errors\":%lu,\"bytes\":%lu,\"depth\":%lu,\"latency_ms\":%.1f,\"latency_max_ms\":%lu,"
+                 "\"fixes_per_batch\":%.1f,\"efficiency\":%.3f}",
+                 active() ? "true" : "false", WiFi.isConnected() ? "true" : "false",
+                 hasHost ? host.toString().c_str() : "", port, protoName(proto), formatName(format),
+                 _batchFixes, _flushMs, (unsigned long)_queued, (unsigned long)_dropped, (unsigned long)_published,
+                 (unsigned long)_batches, (unsigned long)_sendErrors, (unsigned long)_bytesSent,
+                 (unsigned long)depth(), _latencyMs, (unsigned long)_latencyMaxMs, fixesPerBatch(), efficiency());
+        request->send(200, "application/json", json);
+    });
+}
@@ -1,36 +1,124 @@
 #include <Arduino.h>
 #include <esp_now.h>
 #include <WiFi.h>
+#include <esp_wifi.h>
 #include "DataUtils.h"
+#include "AnchorFrame.h"
 #include "PositioningManager.h"
 #include "PortalWeb.h"
+#include "FlashLog.h"
+#include "AnchorRegistry.h"
+#include "RawForwarder.h"
+#include "UpstreamPublisher.h"
+#include "LinkProbe.h"
+#include "PerfProbe.h"
+#include "AsyncLog.h"
 
 // --- CONFIGURACIÓN ---
 const char* pmk_key_str = "pmk-123456789012";
 #define AP_SSID "ESP32-Concentrador"
 #define AP_PASSWORD "123456789"
 #define MIN_ANCHORS_FOR_CALCULATION 4
+// Red del sitio (opcional, -DSTA_SSID=... -DSTA_PASSWORD=...): salida hacia
+// el servicio de resolución y el colector de fixes. El AP y ESP-NOW pasan
+// al canal de esa red.
+#ifndef STA_PASSWORD
+#define STA_PASSWORD ""
+#endif
+// RSSI de ESP-NOW en el core 2.x (-DESPNOW_RSSI_PROMISCUOUS=1): su callback no
+// lo trae y se lee en modo promiscuo, que pasa por la tarea Wi-Fi cada frame
+// de gestión del canal. Apagado, las anclas quedan con rssi 0 en ese core.
+#ifndef ESPNOW_RSSI_PROMISCUOUS
+#define ESPNOW_RSSI_PROMISCUOUS 0
+#endif
 
 // --- OBJETOS GLOBALES ---
 PortalWeb portal(AP_SSID, AP_PASSWORD);
 PositioningManager manager(MIN_ANCHORS_FOR_CALCULATION);
+FlashLog flashLog;
+AnchorRegistry registry;
+RawForwarder forwarder;
+UpstreamPublisher upstream;
+LinkProbe linkProbe;
 
-// FUNCIÓN CALLBACK: Se ejecuta cuando se recibe un mensaje por ESP-NOW
-void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) {
-    if (len == sizeof(AnchorRangeReport_t)) {
-        AnchorRangeReport_t packedReport;
-        memcpy(&packedReport, incomingData, sizeof(packedReport));
-        
-        DecodedAnchorReport_t decodedReport = unpack_anchor_report(packedReport);
-        
-        manager.addAnchorReport(decodedReport);
+// Procesa un frame recibido por ESP-NOW (tarea Wi-Fi): v1 con un reporte o
+// v2 con varios (y bloques del tag sueltos), decodificados en una sola pasada.
+// Antes de tocar el contenido se verifica que la MAC emisora sea un ancla
+// registrada con el saddr que declara el frame.
+static void handleReport(const uint8_t *mac, const uint8_t *incomingData, int len, int8_t rssi) {
+    PERF_SCOPE(PERF_RECEIVE);
+    uint16_t saddr;
+    if (anchor_frame_saddr(incomingData, len, saddr)) {
+        const RegistryVerdict verdict = registry.check(mac, saddr);
+        if (verdict != REGISTRY_ACCEPT) {
+            LOG_D("[REG] Frame de ..:%02X:%02X:%02X descartado (%s, saddr 0x%X)\n",
+                  mac[3], mac[4], mac[5],
+                  verdict == REGISTRY_UNKNOWN ? "desconocida" : "saddr distinto", saddr);
+            return;
+        }
+    }
+    const uint32_t rx_ms = millis();
+    // Raw-forward: el frame sale tal como llegó y lo resuelve el servicio
+    if (forwarder.active()) {
+        forwarder.push(mac, incomingData, len, rssi, rx_ms);
+        return;
+    }
+    AnchorFrameInfo info;
+    {
+        PERF_SCOPE(PERF_DECODE);
+        info = decode_anchor_frame(incomingData, len, [&](DecodedAnchorReport_t& report) {
+            report.rx_ms   = rx_ms;
+            report.rx_rssi = rssi;
+            if (flashLog.logsReports()) flashLog.logReport(pack_anchor_report(report), rx_ms);
+            manager.addAnchorReport(report);
+        }, [&](const TagTelemetryRecord_t& telemetry) {
+            manager.addTagTelemetry(telemetry, rx_ms);
+        });
+    }
+    if (info.version == 0) {
+        manager.countWrongSize();
+        LOG_W("Error: Frame no reconocido (%d bytes). v1 mide %u.\n", len, sizeof(AnchorRangeReport_t));
     } else {
-        DEBUG_PRINTF("Error: Tamaño de paquete incorrecto. Esperado: %d, Recibido: %d\n", sizeof(AnchorRangeReport_t), len);
+        manager.countFrame(info);
     }
 }
 
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+// FUNCIÓN CALLBACK: Se ejecuta cuando se recibe un mensaje por ESP-NOW.
+// En el core 3.x el callback ya trae el RSSI del frame.
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+    handleReport(info->src_addr, incomingData, len, info->rx_ctrl ? (int8_t)info->rx_ctrl->rssi : 0);
+}
+#elif ESPNOW_RSSI_PROMISCUOUS
+// En el core 2.x el callback de ESP-NOW no trae el RSSI: se toma del frame
+// de acción (ESP-NOW) visto en modo promiscuo justo antes, en la misma
+// tarea Wi-Fi, y se usa si el emisor coincide.
+static uint8_t lastActionMac[6];
+static int8_t  lastActionRssi = 0;
+
+static void OnPromiscuousRx(void *buf, wifi_promiscuous_pkt_type_t type) {
+    if (type != WIFI_PKT_MGMT) return;
+    const wifi_promiscuous_pkt_t *pkt = (const wifi_promiscuous_pkt_t *)buf;
+    if (pkt->rx_ctrl.sig_len < 24 || pkt->payload[0] != 0xD0) return;   // subtipo Action
+    memcpy(lastActionMac, pkt->payload + 10, 6);                         // addr2: emisor
+    lastActionRssi = (int8_t)pkt->rx_ctrl.rssi;
+}
+
+// FUNCIÓN CALLBACK: Se ejecuta cuando se recibe un mensaje por ESP-NOW
+void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) {
+    const int8_t rssi = (memcmp(mac_addr, lastActionMac, 6) == 0) ? lastActionRssi : 0;
+    handleReport(mac_addr, incomingData, len, rssi);
+}
+#else
+// FUNCIÓN CALLBACK: Se ejecuta cuando se recibe un mensaje por ESP-NOW (sin RSSI)
+void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) {
+    handleReport(mac_addr, incomingData, len, 0);
+}
+#endif
+
 void setup() {
     Serial.begin(115200);
+    asyncLog.begin();   // drena LOG_* a Serial desde una tarea de baja prioridad
     DEBUG_PRINTLN("\n== INICIANDO CONCENTRADOR TWR V4 ==");
 
     // !!! TAREA CRÍTICA: CONFIGURAR POSICIONES DE LAS ANCLAS !!!
@@ -41,9 +129,24 @@ void setup() {
     manager.setAnchorPosition(0x1004, 0.0, 5.0, 2.5);
     DEBUG_PRINTLN("[SETUP] Posiciones de anclas configuradas.");
 
+    // Log persistente de fixes en LittleFS (antes del portal, que lo publica)
+    flashLog.begin(manager);
+    // MAC -> ancla: se carga antes de recibir; sin registro guardado arranca aprendiendo
+    registry.begin();
+
     WiFi.mode(WIFI_AP_STA);
+#ifdef STA_SSID
+    WiFi.begin(STA_SSID, STA_PASSWORD);
+#endif
     String mac = WiFi.macAddress();
-    portal.begin(mac, manager);
+    uint8_t macBytes[6];
+    WiFi.macAddress(macBytes);
+    forwarder.begin(macBytes);
+    // Fixes al colector por la STA (solo con destino: UPSTREAM_HOST o /upstream)
+    upstream.begin(manager, macBytes);
+    // Ecos ICMP al colector en su propia tarea; ajusta el batching del publicador
+    linkProbe.begin(upstream);
+    portal.begin(mac, manager, &flashLog, &registry, &forwarder, &upstream, &linkProbe);
 
     if (esp_now_init() != ESP_OK) {
         DEBUG_PRINTLN("Error al inicializar ESP-NOW");
@@ -52,10 +155,22 @@ void setup() {
 
     esp_now_set_pmk((const uint8_t *)pmk_key_str);
     esp_now_register_recv_cb(OnDataRecv);
+#if ESP_ARDUINO_VERSION_MAJOR < 3 && ESPNOW_RSSI_PROMISCUOUS
+    wifi_promiscuous_filter_t filter = { .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT };
+    esp_wifi_set_promiscuous_filter(&filter);
+    esp_wifi_set_promiscuous_rx_cb(OnPromiscuousRx);
+    esp_wifi_set_promiscuous(true);
+#endif
     DEBUG_PRINTLN("ESP-NOW inicializado. Esperando reportes de rango...");
     DEBUG_PRINTLN("=================================================");
 }
 
 void loop() {
-    delay(2000);
+    manager.poll();     // plazos de espera de la política (define su resolución)
+    portal.loop();
+    flashLog.loop();
+    registry.loop();
+    forwarder.loop();
+    upstream.loop();
+    delay(5);
 }
\ No newline at end of file
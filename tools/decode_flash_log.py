@@ -0,0 +1,63 @@
+# ========================================================================
+# decode_flash_log.py
+# Convierte a CSV un log descargado de /log/download (uno o varios
+# segmentos concatenados; formato en include/FlashLog.h).
+#
+# Uso:
+#   curl -o fixes.log http://192.168.4.1/log/download
+#   python tools/decode_flash_log.py fixes.log > fixes.csv
+#   python tools/decode_flash_log.py --reports fixes.log > reportes.csv
+# ========================================================================
+import struct
+import sys
+import zlib
+
+MAGIC = 0x31474C46
+HEADER = struct.Struct("<IHHIIII")        # LogSegmentHeader_t
+FIX = struct.Struct("<IIHiiiHBB")         # LogFixRecord_t
+REPORT_HEAD = struct.Struct("<IHIHfI")    # rx_ms + inicio de AnchorRangeReport_t
+REC_FIX, REC_REPORT = 1, 2
+
+
+def records(data):
+    """Recorre segmentos y registros; valida cada cabecera con su CRC."""
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, version, header_len, segment, created_ms, block_size, crc = HEADER.unpack_from(data, pos)
+        if magic != MAGIC or zlib.crc32(data[pos:pos + HEADER.size - 4]) != crc:
+            raise SystemExit("cabecera de segmento inválida en el byte %d" % pos)
+        pos += header_len
+        # Los registros siguen hasta la próxima cabecera o el final
+        while pos + 2 <= len(data):
+            if data[pos:pos + 4] == struct.pack("<I", MAGIC):
+                break
+            rtype, rlen = data[pos], data[pos + 1]
+            payload = data[pos + 2:pos + 2 + rlen]
+            pos += 2 + rlen
+            if len(payload) == rlen:
+                yield segment, rtype, payload
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    reports = "--reports" in sys.argv
+    if len(args) != 1:
+        raise SystemExit("uso: decode_flash_log.py [--reports] <archivo>")
+    with open(args[0], "rb") as f:
+        data = f.read()
+
+    if reports:
+        print("segment,rx_ms,anchor_saddr,tag_uid,seq,range_m,anchor_t_ms")
+    else:
+        print("segment,t_ms,tag_uid,seq,x_m,y_m,z_m,rms_m,anchors,is3D")
+    for segment, rtype, payload in records(data):
+        if rtype == REC_FIX and not reports:
+            t_ms, tag, seq, x, y, z, rms, anchors, flags = FIX.unpack_from(payload)
+            print("%d,%d,%x,%d,%.3f,%.3f,%.3f,%.3f,%d,%d" % (
+                segment, t_ms, tag, seq, x / 1000, y / 1000, z / 1000, rms / 1000, anchors, flags & 1))
+        elif rtype == REC_REPORT and reports:
+            rx_ms, saddr, tag, seq, range_m, t_ms = REPORT_HEAD.unpack_from(payload)
+            print("%d,%d,%x,%x,%d,%.3f,%d" % (segment, rx_ms, saddr, tag, seq, range_m, t_ms))
+
+
+main()
@@ -0,0 +1,143 @@
+# ========================================================================
+# embed_web_assets.py
+# Genera include/WebAssets.h a partir de los archivos de web/:
+#   - cada archivo se comprime con gzip (nivel 9, mtime=0 => reproducible)
+#   - el ETag es un hash SHA-256 truncado del contenido sin comprimir
+#   - los recursos distintos de index.html se publican con nombre versionado
+#     (/app.<hash>.js) y el marcador {{app.js}} de index.html se reemplaza por
+#     esa ruta, de modo que pueden cachearse como inmutables
+#
+# Uso:
+#   - Automático: platformio.ini lo ejecuta como "pre:" en cada compilación.
+#   - Manual:     python tools/embed_web_assets.py
+# ========================================================================
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 (contexto SCons de PlatformIO)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUT_FILE = os.path.join(PROJECT_DIR, "include", "WebAssets.h")
+INDEX = "index.html"
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".json": "application/json",
+}
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def compress(data):
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "static const uint8_t %s[] PROGMEM = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def build_assets():
+    assets = []
+    index_data = None
+    for name in sorted(os.listdir(WEB_DIR)):
+        path = os.path.join(WEB_DIR, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        if name == INDEX:
+            index_data = data
+            continue
+        base, ext = os.path.splitext(name)
+        digest = content_hash(data)
+        assets.append({
+            "name": name,
+            "url": "/%s.%s%s" % (base, digest[:8], ext),
+            "type": CONTENT_TYPES.get(ext, "application/octet-stream"),
+            "data": data,
+            "etag": digest,
+            "immutable": True,
+        })
+
+    if index_data is None:
+        raise SystemExit("embed_web_assets: falta web/%s" % INDEX)
+
+    html = index_data.decode("utf-8")
+    for a in assets:
+        html = html.replace("{{%s}}" % a["name"], a["url"])
+    index_data = html.encode("utf-8")
+    assets.insert(0, {
+        "name": INDEX,
+        "url": "/",
+        "type": "text/html",
+        "data": index_data,
+        "etag": content_hash(index_data),
+        "immutable": False,
+    })
+    return assets
+
+
+def render(assets):
+    out = [
+        "// Archivo generado por tools/embed_web_assets.py a partir de web/. NO EDITAR.",
+        "#ifndef WEB_ASSETS_H",
+        "#define WEB_ASSETS_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "// Recurso del panel, precomprimido con gzip",
+        "struct WebAsset {",
+        "    const char*    url;",
+        "    const char*    contentType;",
+        "    const uint8_t* gzData;",
+        "    size_t         gzLen;",
+        "    const char*    etag;        // ETag fuerte (entre comillas)",
+        "    bool           immutable;   // URL versionada: cacheable indefinidamente",
+        "};",
+        "",
+    ]
+    entries = []
+    for i, a in enumerate(assets):
+        gz = compress(a["data"])
+        var = "WEB_ASSET_%d_GZ" % i
+        out.append("// %s: %d bytes -> %d bytes gzip" % (a["name"], len(a["data"]), len(gz)))
+        out.append(c_array(var, gz))
+        entries.append('    { "%s", "%s", %s, %d, "\\"%s\\"", %s },' % (
+            a["url"], a["type"], var, len(gz), a["etag"], "true" if a["immutable"] else "false"))
+    out.append("static const WebAsset WEB_ASSETS[] = {")
+    out.extend(entries)
+    out.append("};")
+    out.append("static const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    out.append("")
+    out.append("#endif // WEB_ASSETS_H")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    text = render(build_assets())
+    old = None
+    if os.path.exists(OUT_FILE):
+        with open(OUT_FILE, "r", encoding="utf-8") as f:
+            old = f.read()
+    # Solo se reescribe si cambió, para no forzar recompilaciones
+    if text != old:
+        with open(OUT_FILE, "w", encoding="utf-8") as f:
+            f.write(text)
+        print("embed_web_assets: %s actualizado" % os.path.relpath(OUT_FILE, PROJECT_DIR))
+
+
+main()
@@ -0,0 +1,269 @@
+// ========================================================================
+// SimScene.h
+// Escena sintética compartida por el simulador (concentrator_sim) y el
+// generador de tráfico (traffic_gen): anclas en grilla, tags en movimiento,
+// pérdidas, ruido de rango, jitter y retransmisiones. buildTrace() arma los
+// frames ESP-NOW que enviaría cada ancla con el protocolo dado; la escena
+// depende solo de la semilla.
+// ========================================================================
+#ifndef SIM_SCENE_H
+#define SIM_SCENE_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "AnchorFrame.h"
+
+enum Proto { PROTO_V1, PROTO_V2, PROTO_V2_SPLIT, PROTO_COUNT };
+static const char* const PROTO_NAMES[PROTO_COUNT] = { "v1", "v2", "v2s" };
+
+struct Config {
+    int      anchors = 6;
+    int      tags = 10;
+    float    rate_hz = 10.0f;
+    int      seconds = 60;
+    float    area_m = 20.0f;
+    float    hear_m = 18.0f;      // alcance UWB
+    float    anchor_z_m = 0.0f;   // desnivel de anclas alternas (> 0: solución 3D)
+    float    loss = 0.02f;        // probabilidad de perder un reporte
+    float    noise_m = 0.05f;     // desvío del rango
+    int      flush_ms = 20;       // latencia máxima de un registro en el ancla (v2)
+    int      tele_copies = 1;     // anclas que envían el bloque del tag por seq (v2s)
+    float    dup = 0.01f;         // probabilidad de que un frame llegue dos veces (ACK perdido)
+    int      jitter_ms = 8;       // demora máxima de procesamiento en el ancla
+    float    late = 0.0f;         // probabilidad de que un reporte llegue 0,5-4 s tarde
+    int      seq_start = -1;      // seq inicial de los tags (-1 = al azar)
+    float    drift_ppm = 50.0f;   // deriva máxima de los relojes de ancla (±)
+    int      repeat = 5;          // reproducciones cronometradas
+    uint32_t seed = 1;
+    bool     proto[PROTO_COUNT] = { true, true, true };
+};
+
+struct Frame {
+    uint32_t t_ms;
+    uint8_t  len;
+    uint8_t  data[ESPNOW_MAX_PAYLOAD];
+};
+
+struct SimAnchor {
+    uint16_t saddr;
+    float    x, y, z;
+    uint32_t clock_offset;        // reloj propio del ancla (t_ms)...
+    float    drift;               // ...que avanza (1 + drift) ms por ms
+    AnchorFrameBuilder builder;
+    uint32_t oldest_ms;           // primer registro pendiente en el builder
+};
+
+struct SimTag {
+    uint32_t uid;
+    float    x, y, z, vx, vy;
+    uint16_t seq;
+    uint32_t next_ms;
+};
+
+struct Pending {
+    uint32_t t_ms;
+    int      anchor;
+    DecodedAnchorReport_t report;
+    bool operator>(const Pending& o) const { return t_ms > o.t_ms; }
+};
+
+// Posición real del tag y momento de la ronda de ranging
+struct Truth {
+    float    x, y;
+    uint32_t t_ms;
+};
+
+struct Scene {
+    std::vector<SimAnchor> anchors;
+    std::map<uint64_t, Truth> truth;                     // (tag, seq) -> ronda
+    std::map<uint32_t, uint16_t> first_seq;              // tag -> primera seq
+};
+
+static uint64_t truthKey(uint32_t tag, uint16_t seq) { return ((uint64_t)tag << 16) | seq; }
+
+static void emit(std::vector<Frame>& out, uint32_t t, const uint8_t* data, size_t len) {
+    Frame f;
+    f.t_ms = t;
+    f.len = (uint8_t)len;
+    memcpy(f.data, data, len);
+    out.push_back(f);
+}
+
+static void flushAnchor(std::vector<Frame>& out, SimAnchor& a, uint32_t t) {
+    if (a.builder.empty()) return;
+    emit(out, t, a.builder.data(), a.builder.size());
+    a.builder.reset();
+}
+
+// Genera la traza de frames que verían las anclas con el protocolo dado.
+// La escena depende solo de la semilla: todos los protocolos ven lo mismo.
+static std::vector<Frame> buildTrace(const Config& cfg, Proto proto, Scene& scene) {
+    std::mt19937 rng(cfg.seed);
+    std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, cfg.noise_m);
+    // Deriva con su propio generador: no altera la escena de las demás opciones
+    std::mt19937 driftRng(cfg.seed + 2);
+
+    scene.anchors.clear();
+    scene.truth.clear();
+    scene.first_seq.clear();
+    const int side = (int)ceilf(sqrtf((float)cfg.anchors));
+    for (int i = 0; i < cfg.anchors; i++) {
+        SimAnchor a;
+        a.saddr = (uint16_t)(0x1001 + i);
+        a.x = cfg.area_m * ((i % side) + 0.5f) / side;
+        a.y = cfg.area_m * ((i / side) + 0.5f) / side;
+        a.z = 2.5f + ((i % 2) ? cfg.anchor_z_m : 0.0f);   // 0: misma altura, solución 2D
+        a.clock_offset = (uint32_t)(uni(rng) * 1e6f);
+        a.drift = (2.0f * uni(driftRng) - 1.0f) * cfg.drift_ppm * 1e-6f;
+        a.oldest_ms = 0;
+        scene.anchors.push_back(a);
+    }
+
+    std::vector<SimTag> tags;
+    const uint32_t period = (uint32_t)(1000.0f / cfg.rate_hz);
+    for (int i = 0; i < cfg.tags; i++) {
+        SimTag t;
+        t.uid = 0xC0DE0000u + i;
+        t.x = uni(rng) * cfg.area_m;
+        t.y = uni(rng) * cfg.area_m;
+        t.z = 1.0f;
+        const float heading = uni(rng) * 6.2832f;
+        t.vx = cosf(heading);
+        t.vy = sinf(heading);
+        t.seq = (uint16_t)(uni(rng) * 65535.0f);
+        if (cfg.seq_start >= 0) t.seq = (uint16_t)(cfg.seq_start - i);
+        scene.first_seq[t.uid] = (uint16_t)(t.seq + 1);
+        t.next_ms = (uint32_t)(uni(rng) * period);
+        tags.push_back(t);
+    }
+
+    std::vector<Frame> trace;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> air;
+    const uint32_t end = (uint32_t)cfg.seconds * 1000;
+
+    for (uint32_t now = 0; now < end; now++) {
+        // Rondas de ranging de los tags
+        for (SimTag& t : tags) {
+            if (now < t.next_ms) continue;
+            t.next_ms = now + period;
+            const float dt = period / 1000.0f;
+            t.x += t.vx * dt;  t.y += t.vy * dt;
+            if (t.x < 0 || t.x > cfg.area_m) { t.vx = -t.vx; t.x += 2 * t.vx * dt; }
+            if (t.y < 0 || t.y > cfg.area_m) { t.vy = -t.vy; t.y += 2 * t.vy * dt; }
+            t.seq++;
+            scene.truth[truthKey(t.uid, t.seq)] = { t.x, t.y, now };
+
+            for (size_t i = 0; i < scene.anchors.size(); i++) {
+                const SimAnchor& a = scene.anchors[i];
+                const float dx = t.x - a.x, dy = t.y - a.y, dz = t.z - a.z;
+                const float d = sqrtf(dx * dx + dy * dy + dz * dz);
+                if (d > cfg.hear_m || uni(rng) < cfg.loss) continue;
+
+                Pending p;
+                p.t_ms = now + 1 + (uint32_t)(uni(rng) * cfg.jitter_ms);   // procesamiento en el ancla
+                if (cfg.late > 0 && uni(rng) < cfg.late) p.t_ms += 500 + (uint32_t)(uni(rng) * 3500.0f);
+                p.anchor = (int)i;
+                DecodedAnchorReport_t& r = p.report;
+                r = {};
+                r.anchor_saddr = a.saddr;
+                r.tag_uid   = t.uid;
+                r.seq       = t.seq;
+                r.range_m   = d + noise(rng);
+                r.t_ms      = a.clock_offset + p.t_ms + (uint32_t)lroundf(p.t_ms * a.drift);
+                r.rxpacc    = 900 + (uint16_t)(uni(rng) * 100);
+                r.std_noise = 40 + (uint16_t)(uni(rng) * 20);
+                r.fp_ampl1  = 8000;  r.fp_ampl2 = 7000;  r.fp_ampl3 = 6000;
+                r.cir_pwr   = 12000;
+                r.uwb_ch = 5;  r.uwb_prf = 64;  r.uwb_pcode = 9;  r.uwb_drate = 2;
+                r.year = 2026;  r.month = 1;  r.day = 1;
+                r.hour = (uint8_t)(now / 3600000);  r.minute = (uint8_t)(now / 60000 % 60);
+                r.second = (uint8_t)(now / 1000 % 60);  r.millis = (uint16_t)(now % 1000);
+                r.temp = 24.5f + 0.01f * (t.seq % 50);  r.hum = 40.0f;
+                r.aX = t.vx * 0.1f;  r.aY = t.vy * 0.1f;  r.aZ = 1.0f;  r.aSQ = 1.0f;
+                strncpy(r.etiqueta, "HB", sizeof(r.etiqueta));
+                air.push(p);
+            }
+        }
+
+        // Reportes listos en cada ancla
+        while (!air.empty() && air.top().t_ms <= now) {
+            const Pending p = air.top();
+            air.pop();
+            SimAnchor& a = scene.anchors[p.anchor];
+            if (proto == PROTO_V1) {
+                const AnchorRangeReport_t packed = pack_anchor_report(p.report);
+                emit(trace, now, (const uint8_t*)&packed, sizeof(packed));
+                continue;
+            }
+            const bool tele = telemetry_duty(p.report.seq, (uint8_t)p.anchor, (uint8_t)scene.anchors.size(),
+                                             (uint8_t)cfg.tele_copies);
+            auto add = [&]() {
+                return proto == PROTO_V2 ? a.builder.add(p.report) : a.builder.addRange(p.report, tele);
+            };
+            if (a.builder.empty()) a.oldest_ms = now;
+            if (!add()) {
+                flushAnchor(trace, a, now);
+                a.oldest_ms = now;
+                add();
+            }
+        }
+
+        // v2: ningún registro espera más de flush_ms en el ancla
+        for (SimAnchor& a : scene.anchors) {
+            if (!a.builder.empty() && now - a.oldest_ms >= (uint32_t)cfg.flush_ms) flushAnchor(trace, a, now);
+        }
+    }
+    for (SimAnchor& a : scene.anchors) flushAnchor(trace, a, end);
+
+    // Retransmisiones: el concentrador recibió el frame pero el ancla no vio
+    // el ACK y lo reenvía unos ms después (con su propio generador: no
+    // altera la escena)
+    std::mt19937 dupRng(cfg.seed + 1);
+    const size_t sent = trace.size();
+    for (size_t i = 0; i < sent; i++) {
+        if (uni(dupRng) >= cfg.dup) continue;
+        Frame copy = trace[i];
+        copy.t_ms += 1 + (uint32_t)(uni(dupRng) * 4.0f);
+        trace.push_back(copy);
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const Frame& a, const Frame& b) { return a.t_ms < b.t_ms; });
+    return trace;
+}
+
+// Opciones de escena comunes a las herramientas; false si arg no es una
+static bool parseSceneOption(Config& cfg, const std::string& arg, const char* v) {
+    if (arg == "--tags") cfg.tags = atoi(v);
+    else if (arg == "--anchors") cfg.anchors = atoi(v);
+    else if (arg == "--rate") cfg.rate_hz = (float)atof(v);
+    else if (arg == "--seconds") cfg.seconds = atoi(v);
+    else if (arg == "--area") cfg.area_m = (float)atof(v);
+    else if (arg == "--hear") cfg.hear_m = (float)atof(v);
+    else if (arg == "--anchor-z") cfg.anchor_z_m = (float)atof(v);
+    else if (arg == "--flush-ms") cfg.flush_ms = atoi(v);
+    else if (arg == "--loss") cfg.loss = (float)atof(v);
+    else if (arg == "--noise") cfg.noise_m = (float)atof(v);
+    else if (arg == "--tele-copies") cfg.tele_copies = atoi(v);
+    else if (arg == "--dup") cfg.dup = (float)atof(v);
+    else if (arg == "--jitter") cfg.jitter_ms = atoi(v);
+    else if (arg == "--late") cfg.late = (float)atof(v);
+    else if (arg == "--seq-start") cfg.seq_start = atoi(v) & 0xFFFF;
+    else if (arg == "--drift-ppm") cfg.drift_ppm = (float)atof(v);
+    else if (arg == "--seed") cfg.seed = (uint32_t)atoi(v);
+    else if (arg == "--scenario" && strcmp(v, "wrap") == 0) {
+        cfg.seq_start = 65535 - 20;
+        cfg.jitter_ms = 150;
+        cfg.late = 0.02f;
+    }
+    else return false;
+    return true;
+}
+
+#endif // SIM_SCENE_H
@@ -0,0 +1,201 @@
+// ========================================================================
+// concentrator_sim.cpp
+// Simulador en host del enlace anclas -> concentrador. Genera una escena
+// (anclas en grilla, tags en movimiento, pérdidas y ruido de rango), arma
+// los frames ESP-NOW que enviaría cada ancla según el protocolo y los pasa
+// por el mismo código del concentrador (decode_anchor_frame +
+// PositioningManager). Compara protocolos en:
+//   - frames y bytes en el aire, y airtime estimado a 1 Mbps;
+//   - CPU del concentrador por frame y reportes/s (reproducción cronometrada);
+//   - fixes obtenidos y error horizontal contra la posición real (medio,
+//     mediana y máximo);
+//   - secuencias cuya telemetría del tag llegó al concentrador;
+//   - retransmisiones descartadas por el filtro de duplicados y reportes
+//     descartados por llegar fuera de la ventana de reorden;
+//   - tiempo de los fixes (base de tiempo, relojes de ancla con deriva)
+//     contra el de la ronda de ranging.
+// Protocolos: v1 (un reporte por frame), v2 (RANGE_FULL agregados) y v2s
+// (RANGE agregados + el bloque del tag una vez por seq, por turno).
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -DPERF_PROBES=0 -Itools/sim/shim -Iinclude
+//       tools/sim/concentrator_sim.cpp src/PositioningManager.cpp src/TimeBase.cpp
+//       src/AsyncLog.cpp -o concentrator_sim
+// Uso:
+//   ./concentrator_sim [--tags 10] [--anchors 6] [--rate 10] [--seconds 60]
+//                      [--proto v1|v2|v2s|all] [--flush-ms 20] [--loss 0.02]
+//                      [--noise 0.05] [--tele-copies 1] [--dup 0.01]
+//                      [--jitter 8] [--late 0] [--seq-start N] [--drift-ppm 50]
+//                      [--anchor-z 0] [--scenario wrap] [--repeat 5] [--seed 1]
+// --anchor-z M: las anclas impares quedan M metros más arriba, lo que lleva
+// al solver por el camino 3D.
+// --scenario wrap: todos los tags arrancan poco antes de seq 65535, con
+// jitter de 150 ms en las anclas (reportes desordenados entre seqs) y 2 %
+// de reportes que llegan 0,5-4 s tarde.
+// ========================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "PositioningManager.h"
+#include "AnchorFrame.h"
+#include "AsyncLog.h"
+#include "SimScene.h"
+
+uint32_t sim_now_ms = 0;
+
+// --- Modelo de airtime ESP-NOW (802.11b, 1 Mbps, preámbulo largo) ---
+#define AIR_PLCP_US        192     // preámbulo + cabecera PLCP
+#define AIR_MAC_BYTES       43     // MAC + categoría/OUI/aleatorio + IE de vendor + FCS
+#define AIR_US_PER_BYTE      8
+#define AIR_ACK_US         304     // ACK a 1 Mbps
+#define AIR_SIFS_DIFS_US    60
+#define AIR_BACKOFF_US     150     // media de CWmin 15 * 20 µs / 2
+
+static uint32_t frameAirtimeUs(size_t payload) {
+    return AIR_PLCP_US + (AIR_MAC_BYTES + payload) * AIR_US_PER_BYTE + AIR_SIFS_DIFS_US + AIR_ACK_US + AIR_BACKOFF_US;
+}
+
+struct ReplayResult {
+    uint64_t reports = 0;
+    uint64_t fixes = 0;
+    double   err_sum = 0.0;
+    uint64_t err_n = 0;
+    double   err_max = 0.0;
+    std::vector<double> errs;     // para la mediana
+    uint64_t fixes_wrapped = 0;   // fixes de seqs posteriores al paso 65535 -> 0
+    double   t_err_sum = 0.0;     // |fix.t_ms - ronda|
+    double   lat_sum = 0.0;       // publicación - ronda
+    double   wall_s = 0.0;
+    ManagerStats stats;
+};
+
+static double median(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+// Pasa la traza por el pipeline del concentrador, como OnDataRecv + loop()
+static ReplayResult replay(const std::vector<Frame>& trace, const Scene& scene) {
+    ReplayResult res;
+    PositioningManager manager(4);
+    for (const SimAnchor& a : scene.anchors) manager.setAnchorPosition(a.saddr, a.x, a.y, a.z);
+    manager.addFixListener([&](const TagFix& fix) {
+        res.fixes++;
+        if (fix.seq < scene.first_seq.at(fix.tag_uid)) res.fixes_wrapped++;
+        auto it = scene.truth.find(truthKey(fix.tag_uid, fix.seq));
+        if (it == scene.truth.end()) return;
+        res.t_err_sum += fabs((double)(int32_t)(fix.t_ms - it->second.t_ms));
+        res.lat_sum += (double)(int32_t)(sim_now_ms - it->second.t_ms);
+        const double dx = fix.pos.x - it->second.x, dy = fix.pos.y - it->second.y;
+        const double err = sqrt(dx * dx + dy * dy);
+        res.err_sum += err;
+        res.err_n++;
+        res.errs.push_back(err);
+        if (err > res.err_max) res.err_max = err;
+    });
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const Frame& f : trace) {
+        sim_now_ms = f.t_ms;
+        manager.poll();
+        const AnchorFrameInfo info = decode_anchor_frame(f.data, f.len, [&](DecodedAnchorReport_t& report) {
+            report.rx_ms = sim_now_ms;
+            manager.addAnchorReport(report);
+        }, [&](const TagTelemetryRecord_t& telemetry) {
+            manager.addTagTelemetry(telemetry, sim_now_ms);
+        });
+        if (info.version == 0) manager.countWrongSize(); else manager.countFrame(info);
+        res.reports += info.reports;
+    }
+    sim_now_ms += 1000;
+    manager.poll();
+    res.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    res.stats = manager.stats();
+    return res;
+}
+
+static void usage() {
+    fprintf(stderr, "uso: concentrator_sim [--tags N] [--anchors N] [--rate HZ] [--seconds S] [--proto v1|v2|v2s|all]\n"
+                    "                      [--flush-ms MS] [--loss P] [--noise M] [--tele-copies N] [--dup P]\n"
+                    "                      [--jitter MS] [--late P] [--seq-start N] [--drift-ppm PPM]\n"
+                    "                      [--area M] [--hear M] [--anchor-z M]\n"
+                    "                      [--scenario wrap]\n"
+                    "                      [--repeat N] [--seed N]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) usage();
+        const char* v = argv[++i];
+        if (parseSceneOption(cfg, arg, v)) continue;
+        if (arg == "--repeat") cfg.repeat = atoi(v);
+        else if (arg == "--proto") {
+            for (int p = 0; p < PROTO_COUNT; p++) cfg.proto[p] = (strcmp(v, "all") == 0 || strcmp(v, PROTO_NAMES[p]) == 0);
+        } else usage();
+    }
+    if (cfg.tags < 1 || cfg.anchors < 4 || cfg.rate_hz <= 0 || cfg.seconds < 1 || cfg.repeat < 1 || cfg.tele_copies < 1) usage();
+    asyncLog.setLevel(LOG_LEVEL_OFF);
+
+    printf("escena: %d anclas, %d tags a %.1f Hz, %d s, pérdida %.0f%%, duplicados %.1f%%, flush v2 %d ms, telemetría v2s x%d\n"
+           "        jitter %d ms, tardíos %.1f%%, seq inicial %s, deriva de anclas ±%.0f ppm\n\n",
+           cfg.anchors, cfg.tags, cfg.rate_hz, cfg.seconds, cfg.loss * 100, cfg.dup * 100, cfg.flush_ms, cfg.tele_copies,
+           cfg.jitter_ms, cfg.late * 100, cfg.seq_start >= 0 ? std::to_string(cfg.seq_start).c_str() : "al azar",
+           cfg.drift_ppm);
+    printf("%-5s %9s %11s %9s %8s %9s %9s %11s %8s %8s %8s %8s %7s %7s %7s %7s %6s %6s\n",
+           "proto", "frames", "bytes", "rep/frm", "aire %", "us/frame", "us/rep", "reportes/s", "fixes", "err cm", "med cm", "máx cm",
+           "tele %", "dups", "stale", "wrap", "t ms", "lat ms");
+
+    for (int p = 0; p < PROTO_COUNT; p++) {
+        if (!cfg.proto[p]) continue;
+        Scene scene;
+        const std::vector<Frame> trace = buildTrace(cfg, (Proto)p, scene);
+
+        uint64_t bytes = 0, airUs = 0;
+        for (const Frame& f : trace) { bytes += f.len; airUs += frameAirtimeUs(f.len); }
+
+        ReplayResult first;
+        double best = 1e30;
+        for (int r = 0; r < cfg.repeat; r++) {
+            const ReplayResult res = replay(trace, scene);
+            if (r == 0) first = res;
+            if (res.wall_s < best) best = res.wall_s;
+        }
+
+        const double frames = (double)trace.size();
+        printf("%-5s %9zu %11llu %9.2f %8.1f %9.3f %9.3f %11.0f %8llu %8.1f %8.1f %8.1f %7.1f %7lu %7lu %7llu %6.1f %6.1f\n",
+               PROTO_NAMES[p], trace.size(), (unsigned long long)bytes,
+               frames ? first.reports / frames : 0.0,
+               100.0 * airUs / (cfg.seconds * 1e6),
+               frames ? best * 1e6 / frames : 0.0,
+               first.reports ? best * 1e6 / first.reports : 0.0,
+               best > 0 ? first.reports / best : 0.0,
+               (unsigned long long)first.fixes,
+               first.err_n ? 100.0 * first.err_sum / first.err_n : 0.0,
+               100.0 * median(first.errs),
+               100.0 * first.err_max,
+               scene.truth.empty() ? 0.0 : 100.0 * first.stats.telemetry_updates / scene.truth.size(),
+               (unsigned long)first.stats.reports_duplicate, (unsigned long)first.stats.reports_stale,
+               (unsigned long long)first.fixes_wrapped,
+               first.err_n ? first.t_err_sum / first.err_n : 0.0,
+               first.err_n ? first.lat_sum / first.err_n : 0.0);
+    }
+    printf("\naire %%: ocupación estimada del canal (todas las anclas, 1 Mbps, con ACK y backoff).\n"
+           "us/frame, us/rep, reportes/s: CPU del host en decode + correlación + solver (mejor de %d).\n"
+           "err cm, med cm, máx cm: error horizontal del fix (medio, mediana y máximo).\n"
+           "tele %%: secuencias cuya telemetría del tag llegó al concentrador.\n"
+           "dups: reportes retransmitidos que descartó el filtro de duplicados.\n"
+           "stale: reportes llegados más de SEQ_REORDER_WINDOW seqs detrás del tag.\n"
+           "wrap: fixes de secuencias posteriores al paso 65535 -> 0.\n"
+           "t ms: |t_ms del fix - ronda de ranging| medio (base de tiempo sobre relojes de ancla con deriva).\n"
+           "lat ms: publicación del fix - ronda de ranging (medio).\n",
+           cfg.repeat);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// ========================================================================
+// manager_check.cpp
+// Casos de regresión deterministas del PositioningManager en el host, con
+// el reloj simulado del shim (sim_now_ms). Cada caso arma una secuencia
+// corta de reportes que alguna vez rompió el orden o las tablas y verifica
+// el estado publicado:
+//   - anchor_slots: el primer reporte de un ancla nueva llega atrasado
+//                   (stale) y se descarta; la siguiente ancla nueva no debe
+//                   recibir la misma casilla.
+//   - quick_reboot: un tag reinicia su seq sin callar SEQ_RESTART_MS; el
+//                   orden se resincroniza y vuelve a publicar fixes.
+//   - telemetry_restart: tras un reinicio del orden del tag, su telemetría
+//                   se incorpora aunque la seq nueva sea menor que la vieja.
+// Termina con código 1 si algún caso falla.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -DPERF_PROBES=0 -Itools/sim/shim -Iinclude
+//       tools/sim/manager_check.cpp src/PositioningManager.cpp src/TimeBase.cpp src/AsyncLog.cpp
+//       -o manager_check
+// ========================================================================
+#include <stdio.h>
+#include <set>
+#include "PositioningManager.h"
+
+uint32_t sim_now_ms = 1000;
+
+static const uint16_t kAnchors[] = { 0x1001, 0x1002, 0x1003, 0x1004 };
+static const float    kAnchorXY[][2] = { { 0, 0 }, { 6, 0 }, { 0, 6 }, { 6, 6 } };
+
+static DecodedAnchorReport_t makeReport(uint16_t anchor, uint32_t tag, uint16_t seq) {
+    DecodedAnchorReport_t r = {};
+    r.anchor_saddr = anchor;
+    r.tag_uid      = tag;
+    r.seq          = seq;
+    r.range_m      = 3.0f + (anchor & 0xF) * 0.1f;
+    r.rx_ms        = sim_now_ms;
+    return r;
+}
+
+static void placeAnchors(PositioningManager& m) {
+    for (size_t i = 0; i < sizeof(kAnchors) / sizeof(kAnchors[0]); i++) {
+        m.setAnchorPosition(kAnchors[i], kAnchorXY[i][0], kAnchorXY[i][1], 0.0f);
+    }
+}
+
+// Una ronda completa: las cuatro anclas reportan la seq (telemetría en la primera)
+static void round(PositioningManager& m, uint32_t tag, uint16_t seq, bool telemetry) {
+    for (size_t i = 0; i < sizeof(kAnchors) / sizeof(kAnchors[0]); i++) {
+        DecodedAnchorReport_t r = makeReport(kAnchors[i], tag, seq);
+        r.has_telemetry = telemetry && i == 0;
+        r.temp = seq;
+        m.addAnchorReport(r);
+    }
+}
+
+static bool check(bool ok, const char* what) {
+    if (!ok) printf("  FALLA: %s\n", what);
+    return ok;
+}
+
+static bool anchorSlots() {
+    PositioningManager m(3);
+    const uint32_t tag = 0x42;
+    m.addAnchorReport(makeReport(0x1001, tag, 100));
+    m.addAnchorReport(makeReport(0x1001, tag, 140));
+    m.addAnchorReport(makeReport(0x1002, tag, 100));     // stale: ancla nueva descartada
+    m.addAnchorReport(makeReport(0x1003, tag, 141));
+    m.addAnchorReport(makeReport(0x1002, tag, 141));
+
+    bool ok = check(m.stats().reports_stale == 1, "el reporte atrasado cuenta como stale");
+    ok &= check(m.stats().reports_duplicate == 0, "ningún reporte de otra ancla se toma por duplicado");
+    ok &= check(m.anchorCount() == 3, "tres anclas, tres casillas");
+    std::set<uint16_t> seen;
+    for (size_t i = 0; i < m.anchorCount(); i++) {
+        AnchorEntry e;
+        if (m.readAnchor(i, e)) seen.insert(e.report.anchor_saddr);
+    }
+    ok &= check(seen == std::set<uint16_t>({ 0x1001, 0x1002, 0x1003 }), "cada casilla tiene su propia ancla");
+    return ok;
+}
+
+static bool quickReboot() {
+    PositioningManager m(3);
+    placeAnchors(m);
+    uint32_t fixes = 0;
+    uint16_t lastSeq = 0;
+    m.addFixListener([&](const TagFix& fix) { fixes++; lastSeq = fix.seq; });
+    const uint32_t tag = 0x43;
+    for (uint16_t s = 1000; s < 1020; s++) { sim_now_ms += 100; round(m, tag, s, false); }
+    const uint32_t before = fixes;
+    sim_now_ms += 300;                                   // reinicio corto: menos que SEQ_RESTART_MS
+    for (uint16_t s = 1; s < 20; s++) { sim_now_ms += 100; round(m, tag, s, false); }
+
+    bool ok = check(before == 20, "fixes antes del reinicio");
+    ok &= check(m.stats().seq_resyncs == 1, "una resincronización");
+    ok &= check(lastSeq == 19, "el último fix es de la numeración nueva");
+    ok &= check(fixes - before >= 14, "vuelve a publicar tras unas pocas secuencias");
+    return ok;
+}
+
+static bool telemetryRestart() {
+    PositioningManager m(3);
+    placeAnchors(m);
+    const uint32_t tag = 0x44;
+    for (uint16_t s = 1000; s < 1010; s++) { sim_now_ms += 100; round(m, tag, s, true); }
+    sim_now_ms += SEQ_RESTART_MS + 500;                  // callado: el orden se reinicia
+    for (uint16_t s = 1; s < 5; s++) { sim_now_ms += 100; round(m, tag, s, true); }
+
+    TagTelemetryEntry e;
+    bool ok = check(m.readTagTelemetry(0, e), "el tag tiene telemetría");
+    ok &= check(e.seq == 4, "la telemetría sigue a la seq nueva");
+    ok &= check(m.stats().telemetry_redundant == 0, "ningún bloque nuevo se toma por copia");
+    return ok;
+}
+
+int main() {
+    struct Case { const char* name; bool (*run)(); };
+    const Case cases[] = {
+        { "anchor_slots",      anchorSlots },
+        { "quick_reboot",      quickReboot },
+        { "telemetry_restart", telemetryRestart },
+    };
+    int failed = 0;
+    for (const Case& c : cases) {
+        const bool ok = c.run();
+        printf("%-18s %s\n", c.name, ok ? "ok" : "FALLA");
+        if (!ok) failed++;
+    }
+    printf(failed ? "%d caso(s) fallaron\n" : "OK\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+// ========================================================================
+// seqlock_stress.cpp
+// Prueba de estrés en host del estado publicado con seqlock: un escritor y
+// varios lectores en hilos reales, como la tarea Wi-Fi, loop() y los
+// handlers de async_tcp en el ESP32. Dos partes:
+//   - slot:    un SeqlockSlot<Payload> grande escrito sin pausa. Cada
+//              escritura repite el mismo número de generación en todas las
+//              palabras: una copia que mezcla dos escrituras se detecta.
+//              Como control, los lectores también copian la casilla sin el
+//              protocolo y cuentan esas copias rotas (deben aparecer: si no,
+//              la prueba no tiene poder para ver un fallo).
+//   - manager: PositioningManager con el escritor real (addAnchorReport),
+//              loop() llamando a poll() y lectores sobre readTag/readAnchor/
+//              getVersion. Los tags recorren una trayectoria conocida en
+//              función de su seq y las anclas miden el rango exacto, así que
+//              cada casilla leída se puede verificar campo contra campo:
+//              posición del fix contra la trayectoria de su seq, rango del
+//              ancla contra el tag y la seq del mismo reporte, versiones que
+//              no retroceden.
+// Termina con código 1 si algún lector vio una lectura rota.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -pthread -DPERF_PROBES=0 -DSHIM_WALL_CLOCK -Itools/sim/shim -Iinclude
+//       tools/sim/seqlock_stress.cpp src/PositioningManager.cpp src/TimeBase.cpp src/AsyncLog.cpp
+//       -o seqlock_stress
+// Uso:
+//   ./seqlock_stress [--seconds 5] [--readers 3] [--tags 16] [--rate 0] [--part slot|manager|all]
+// --rate limita las rondas por tag y segundo del escritor (0: sin pausa, la
+// mayor presión sobre las casillas; con pausa, más secuencias llegan a fix).
+// ========================================================================
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PositioningManager.h"
+#include "AsyncLog.h"
+
+struct StressOptions {
+    int seconds = 5;
+    int readers = 3;
+    int tags = 16;
+    int rate = 0;            // rondas/s por tag en la parte manager (0: sin pausa)
+    bool slot = true;
+    bool manager = true;
+};
+
+// Contadores de un lector (se suman al final)
+struct ReaderCounts {
+    uint64_t reads = 0;      // lecturas consistentes verificadas
+    uint64_t gaveUp = 0;     // read() agotó SEQLOCK_MAX_RETRIES (permitido, se cuenta)
+    uint64_t torn = 0;       // lecturas consistentes que no cuadran: fallo
+    uint64_t control = 0;    // copias sin protocolo (solo slot)
+    uint64_t controlTorn = 0;
+};
+
+static void sumCounts(const std::vector<ReaderCounts>& per, ReaderCounts& total) {
+    for (const ReaderCounts& c : per) {
+        total.reads += c.reads;
+        total.gaveUp += c.gaveUp;
+        total.torn += c.torn;
+        total.control += c.control;
+        total.controlTorn += c.controlTorn;
+    }
+}
+
+// --- Parte 1: SeqlockSlot aislado ---
+
+#define PAYLOAD_WORDS 64
+
+struct Payload {
+    uint32_t gen;
+    uint32_t words[PAYLOAD_WORDS];
+};
+
+static bool payloadIntact(const Payload& p) {
+    for (uint32_t w : p.words) {
+        if (w != p.gen) return false;
+    }
+    return true;
+}
+
+static bool stressSlot(const StressOptions& opt) {
+    static SeqlockSlot<Payload> slot;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> writes{0};
+
+    std::thread writer([&] {
+        Payload p;
+        for (uint32_t gen = 1; !stop.load(std::memory_order_relaxed); gen++) {
+            p.gen = gen;
+            for (uint32_t& w : p.words) w = gen;
+            slot.write(p);
+            writes.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    std::vector<ReaderCounts> per(opt.readers);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < opt.readers; r++) {
+        readers.emplace_back([&, r] {
+            ReaderCounts& c = per[r];
+            uint32_t lastGen = 0;
+            Payload p;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!slot.read(p)) {
+                    c.gaveUp++;
+                } else {
+                    c.reads++;
+                    // Además de intacta, nunca más vieja que la anterior
+                    if (!payloadIntact(p) || p.gen < lastGen) c.torn++;
+                    lastGen = p.gen;
+                }
+                // Control: la misma copia sin mirar el contador
+                memcpy(&p, (const void*)&slot.peek(), sizeof(p));
+                c.control++;
+                if (!payloadIntact(p)) c.controlTorn++;
+            }
+        });
+    }
+
+    delay((uint32_t)opt.seconds * 1000);
+    stop = true;
+    writer.join();
+    for (std::thread& t : readers) t.join();
+
+    ReaderCounts total;
+    sumCounts(per, total);
+    printf("slot:    %llu escrituras, %llu lecturas, %llu agotadas, %llu rotas | control sin seqlock: %llu de %llu rotas\n",
+           (unsigned long long)writes.load(), (unsigned long long)total.reads, (unsigned long long)total.gaveUp,
+           (unsigned long long)total.torn, (unsigned long long)total.controlTorn, (unsigned long long)total.control);
+    if (total.controlTorn == 0) printf("  (el control no vio copias rotas: pocos cambios de contexto, probar con más --seconds)\n");
+    return total.torn == 0;
+}
+
+// --- Parte 2: PositioningManager ---
+
+struct StressAnchor {
+    uint16_t saddr;
+    Point    pos;
+};
+
+static const StressAnchor STRESS_ANCHORS[] = {
+    { 0x1001, {  0.0f,  0.0f, 2.5f } },
+    { 0x1002, { 10.0f,  0.0f, 2.5f } },
+    { 0x1003, { 10.0f, 10.0f, 2.5f } },
+    { 0x1004, {  0.0f, 10.0f, 2.5f } },
+    { 0x1005, {  5.0f,  0.0f, 0.5f } },
+    { 0x1006, {  5.0f, 10.0f, 0.5f } },
+};
+#define STRESS_TAG_BASE     0xA0000000u
+#define STRESS_FIX_TOL_M    0.25f    // error de solución aceptado con rangos exactos
+#define STRESS_RANGE_TOL_M  0.001f
+
+// Círculo de 3 m: dos seqs seguidas quedan a ~2 m, así que un fix que mezcle
+// la seq de una escritura con la posición de otra no pasa la tolerancia
+static Point trajectory(uint32_t tag_uid, uint16_t seq) {
+    const float a = 0.7f * seq + 0.4f * (tag_uid - STRESS_TAG_BASE);
+    return { 5.0f + 3.0f * cosf(a), 5.0f + 3.0f * sinf(a), 1.2f };
+}
+
+static float distance(const Point& a, const Point& b) {
+    const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Los fixes 2D salen con z = 0: se comparan en el plano
+static float horizontal(const Point& a, const Point& b) {
+    return hypotf(a.x - b.x, a.y - b.y);
+}
+
+static bool stressManager(const StressOptions& opt) {
+    PositioningManager manager(4);
+    for (const StressAnchor& a : STRESS_ANCHORS) manager.setAnchorPosition(a.saddr, a.pos.x, a.pos.y, a.pos.z);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> fixes{0}, sent{0};
+    manager.addFixListener([&](const TagFix&) { fixes.fetch_add(1, std::memory_order_relaxed); });
+
+    // Tarea Wi-Fi: rondas de todos los tags, un reporte por ancla
+    std::thread writer([&] {
+        const uint32_t start = millis();
+        uint64_t rounds = 0;
+        for (uint16_t seq = 0; !stop.load(std::memory_order_relaxed); seq++, rounds++) {
+            while (opt.rate > 0 && rounds * 1000 > (uint64_t)(millis() - start) * opt.rate) delay(1);
+            for (int t = 0; t < opt.tags; t++) {
+                const uint32_t tag = STRESS_TAG_BASE + (uint32_t)t;
+                const Point p = trajectory(tag, seq);
+                for (const StressAnchor& a : STRESS_ANCHORS) {
+                    DecodedAnchorReport_t r = {};
+                    r.anchor_saddr = a.saddr;
+                    r.tag_uid = tag;
+                    r.seq = seq;
+                    r.range_m = distance(p, a.pos);
+                    r.rx_ms = millis();
+                    manager.addAnchorReport(r);
+                    sent.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    });
+
+    // loop(): plazos de la política, como en el firmware
+    std::thread poller([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            manager.poll();
+            delay(1);
+        }
+    });
+
+    std::vector<ReaderCounts> per(opt.readers);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < opt.readers; r++) {
+        readers.emplace_back([&, r] {
+            ReaderCounts& c = per[r];
+            uint32_t lastVersion = 0;
+            std::vector<uint32_t> tagVersion(MAX_TAGS, 0), tagUid(MAX_TAGS, 0);
+            std::vector<uint32_t> anchorVersion(MAX_ANCHORS, 0);
+            std::vector<uint16_t> anchorSaddr(MAX_ANCHORS, 0);
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (size_t i = 0; i < manager.tagCount(); i++) {
+                    TagFix f;
+                    if (!manager.readTag(i, f)) { c.gaveUp++; continue; }
+                    if (f.version == 0) continue;
+                    c.reads++;
+                    const bool bad = f.tag_uid < STRESS_TAG_BASE || f.tag_uid >= STRESS_TAG_BASE + (uint32_t)opt.tags
+                        || horizontal(f.pos, trajectory(f.tag_uid, f.seq)) > STRESS_FIX_TOL_M
+                        || f.version < tagVersion[i] || (tagUid[i] && f.tag_uid != tagUid[i]);
+                    if (bad) c.torn++;
+                    tagVersion[i] = f.version;
+                    tagUid[i] = f.tag_uid;
+                }
+                for (size_t i = 0; i < manager.anchorCount(); i++) {
+                    AnchorEntry e;
+                    if (!manager.readAnchor(i, e)) { c.gaveUp++; continue; }
+                    if (e.reports == 0) continue;
+                    c.reads++;
+                    const DecodedAnchorReport_t& d = e.report;
+                    const StressAnchor* a = nullptr;
+                    for (const StressAnchor& s : STRESS_ANCHORS) if (s.saddr == d.anchor_saddr) a = &s;
+                    const bool bad = !a || d.tag_uid < STRESS_TAG_BASE
+                        || d.tag_uid >= STRESS_TAG_BASE + (uint32_t)opt.tags
+                        || fabsf(d.range_m - distance(a->pos, trajectory(d.tag_uid, d.seq))) > STRESS_RANGE_TOL_M
+                        || e.version < anchorVersion[i] || (anchorSaddr[i] && d.anchor_saddr != anchorSaddr[i]);
+                    if (bad) c.torn++;
+                    anchorVersion[i] = e.version;
+                    anchorSaddr[i] = d.anchor_saddr;
+                }
+                const uint32_t v = manager.getVersion();
+                if (v < lastVersion) c.torn++;
+                lastVersion = v;
+            }
+        });
+    }
+
+    delay((uint32_t)opt.seconds * 1000);
+    stop = true;
+    writer.join();
+    poller.join();
+    for (std::thread& t : readers) t.join();
+
+    ReaderCounts total;
+    sumCounts(per, total);
+    const ManagerStats& st = manager.stats();
+    printf("manager: %llu reportes, %llu fixes (%lu solves ok), %llu lecturas, %llu agotadas, %llu rotas\n",
+           (unsigned long long)sent.load(), (unsigned long long)fixes.load(), (unsigned long)st.solves_ok,
+           (unsigned long long)total.reads, (unsigned long long)total.gaveUp, (unsigned long long)total.torn);
+    return total.torn == 0 && fixes.load() > 0;
+}
+
+static bool parseArgs(int argc, char** argv, StressOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const std::string a = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* v = argv[++i];
+        if (a == "--seconds") opt.seconds = atoi(v);
+        else if (a == "--readers") opt.readers = atoi(v);
+        else if (a == "--tags") opt.tags = atoi(v);
+        else if (a == "--rate") opt.rate = atoi(v);
+        else if (a == "--part") {
+            const std::string p = v;
+            if (p != "slot" && p != "manager" && p != "all") return false;
+            opt.slot = (p != "manager");
+            opt.manager = (p != "slot");
+        } else {
+            return false;
+        }
+    }
+    return opt.seconds > 0 && opt.readers > 0 && opt.tags > 0 && opt.tags <= MAX_TAGS && opt.rate >= 0;
+}
+
+int main(int argc, char** argv) {
+    StressOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        fprintf(stderr, "uso: %s [--seconds 5] [--readers 3] [--tags 16] [--rate 0] [--part slot|manager|all]\n", argv[0]);
+        return 2;
+    }
+    asyncLog.setLevel(LOG_LEVEL_OFF);
+    bool ok = true;
+    if (opt.slot) ok = stressSlot(opt) && ok;
+    if (opt.manager) ok = stressManager(opt) && ok;
+    printf("%s\n", ok ? "OK" : "FALLO: lecturas rotas");
+    return ok ? 0 : 1;
+}
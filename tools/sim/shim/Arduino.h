@@ -0,0 +1,91 @@
+// ========================================================================
+// Arduino.h mínimo para compilar el pipeline del concentrador en el host
+// (tools/sim, tools/solver). Solo lo que usan PositioningManager,
+// AnchorFrame y AsyncLog: millis() sobre el reloj virtual del simulador (o
+// el reloj real con -DSHIM_WALL_CLOCK) y un Serial a stdout. Para los
+// módulos de red (WiFi.h y compañía, también en esta carpeta): un String
+// sobre std::string, portMUX como spinlock, delay() y tareas de FreeRTOS
+// como hilos (un tick = 1 ms).
+// ========================================================================
+#ifndef SIM_ARDUINO_SHIM_H
+#define SIM_ARDUINO_SHIM_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifdef SHIM_WALL_CLOCK
+// Servicios en host (tools/solver): reloj monótono real
+inline uint32_t millis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#else
+// Reloj virtual: lo avanza el simulador
+extern uint32_t sim_now_ms;
+inline uint32_t millis() { return sim_now_ms; }
+#endif
+
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+// Sección crítica de FreeRTOS: en el host, un spinlock
+struct portMUX_TYPE {
+    std::atomic<bool> locked{false};
+    portMUX_TYPE() = default;
+    portMUX_TYPE(const portMUX_TYPE&) {}
+    portMUX_TYPE& operator=(const portMUX_TYPE&) { return *this; }
+};
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE()
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+    while (mux->locked.exchange(true, std::memory_order_acquire)) {}
+}
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) { mux->locked.store(false, std::memory_order_release); }
+
+// Tareas de FreeRTOS: un hilo suelto por tarea (la prioridad no aplica)
+typedef void (*TaskFunction_t)(void*);
+typedef void* TaskHandle_t;
+#define ARDUINO_RUNNING_CORE 1
+#define pdPASS               1
+#define pdMS_TO_TICKS(ms)    (ms)
+inline int xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* arg, unsigned, TaskHandle_t*, int) {
+    std::thread(fn, arg).detach();
+    return pdPASS;
+}
+inline void vTaskDelay(uint32_t ticks) { delay(ticks); }
+
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    const char* c_str() const { return _s.c_str(); }
+    size_t length() const { return _s.size(); }
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+    bool operator==(const char* s) const { return _s == s; }
+    bool operator!=(const char* s) const { return _s != s; }
+    String& operator+=(const char* s) { _s += s; return *this; }
+
+private:
+    std::string _s;
+};
+
+struct SimSerial {
+    template <typename T> void print(const T& v) { (void)v; }
+    template <typename T> void println(const T& v) { (void)v; }
+    void printf(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(stdout, fmt, ap);
+        va_end(ap);
+    }
+    size_t write(const uint8_t* buf, size_t len) { return fwrite(buf, 1, len, stdout); }
+};
+inline SimSerial Serial;
+
+#endif // SIM_ARDUINO_SHIM_H
@@ -0,0 +1,111 @@
+// ========================================================================
+// ESP32Ping.h para el host: la misma interfaz bloqueante de
+// lib/ESP32Ping-1.6 (ping(ip, count), averageTime()) sobre ICMP de Linux.
+// Usa un socket ICMP "datagram" si net.ipv4.ping_group_range lo permite y,
+// si no, uno raw (root o CAP_NET_RAW). Como la librería, espera cada eco
+// hasta 1 s y deja en averageTime() la media de los que volvieron.
+// impair() es solo del host: pierde ecos con probabilidad loss y suma
+// extra_ms al RTT, para probar el ajuste por enlace sobre loopback.
+// ========================================================================
+#ifndef SIM_ESP32_PING_SHIM_H
+#define SIM_ESP32_PING_SHIM_H
+
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <random>
+#include <WiFi.h>
+
+#define SIM_PING_TIMEOUT_MS 1000
+
+class PingClass {
+public:
+    bool ping(const IPAddress& dest, uint8_t count = 5) {
+        float total = 0.0f;
+        uint8_t ok = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            float rtt;
+            if (echo(dest, rtt)) {
+                total += rtt;
+                ok++;
+            }
+        }
+        _avg = ok ? total / ok : 0.0f;
+        return ok > 0;
+    }
+    float averageTime() const { return _avg; }
+
+    void impair(float loss, uint32_t extra_ms) {
+        _loss.store(loss);
+        _extraMs.store(extra_ms);
+    }
+
+private:
+    bool open() {
+        if (_fd >= 0) return true;
+        _fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+        _raw = false;
+        if (_fd < 0) {
+            _fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+            _raw = true;
+        }
+        if (_fd < 0) perror("socket ICMP");
+        return _fd >= 0;
+    }
+
+    bool echo(const IPAddress& dest, float& rtt) {
+        if (!open()) return false;
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t extra = _extraMs.load();
+        if (extra) delay(extra);
+
+        icmphdr req = {};
+        req.type = ICMP_ECHO;
+        req.un.echo.id = htons(_id);
+        req.un.echo.sequence = htons(++_seq);
+        req.checksum = checksum(&req, sizeof(req));
+        const sockaddr_in to = sim_sockaddr(dest, 0);
+        if (sendto(_fd, &req, sizeof(req), 0, (const sockaddr*)&to, sizeof(to)) != (ssize_t)sizeof(req)) return false;
+        const bool drop = std::uniform_real_distribution<float>(0.0f, 1.0f)(_rng) < _loss.load();
+
+        for (;;) {
+            const int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= SIM_PING_TIMEOUT_MS + (int)extra) return false;
+            pollfd p = { _fd, POLLIN, 0 };
+            if (poll(&p, 1, SIM_PING_TIMEOUT_MS + (int)extra - elapsed) != 1) return false;
+            uint8_t buf[256];
+            const ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+            // Raw: trae la cabecera IP y también ve el propio eco saliente
+            const size_t off = _raw ? (size_t)(((const iphdr*)buf)->ihl * 4) : 0;
+            if (n < (ssize_t)(off + sizeof(icmphdr))) continue;
+            icmphdr rep;
+            memcpy(&rep, buf + off, sizeof(rep));
+            if (rep.type != ICMP_ECHOREPLY || ntohs(rep.un.echo.sequence) != _seq) continue;
+            if (_raw && ntohs(rep.un.echo.id) != _id) continue;
+            if (drop) continue;                      // se espera el timeout, como un eco perdido
+            rtt = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return true;
+        }
+    }
+
+    static uint16_t checksum(const void* data, size_t len) {
+        const uint8_t* p = (const uint8_t*)data;
+        uint32_t sum = 0;
+        for (size_t i = 0; i + 1 < len; i += 2) sum += (uint32_t)p[i] << 8 | p[i + 1];
+        if (len & 1) sum += (uint32_t)p[len - 1] << 8;
+        while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+        return htons((uint16_t)~sum);
+    }
+
+    int      _fd = -1;
+    bool     _raw = false;
+    uint16_t _id = (uint16_t)getpid();
+    uint16_t _seq = 0;
+    float    _avg = 0.0f;
+    std::atomic<float>    _loss{0.0f};
+    std::atomic<uint32_t> _extraMs{0};
+    std::mt19937 _rng{12345};
+};
+inline PingClass Ping;
+
+#endif // SIM_ESP32_PING_SHIM_H
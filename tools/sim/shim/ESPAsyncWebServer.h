@@ -0,0 +1,40 @@
+// ========================================================================
+// ESPAsyncWebServer.h mínimo para el host: los módulos registran sus rutas
+// con serve(), pero en tools/sim nadie las atiende. Alcanza con que
+// compilen.
+// ========================================================================
+#ifndef SIM_ASYNC_WEB_SERVER_SHIM_H
+#define SIM_ASYNC_WEB_SERVER_SHIM_H
+
+#include <functional>
+#include <Arduino.h>
+
+enum WebRequestMethod { HTTP_GET = 1, HTTP_POST = 2 };
+
+class AsyncWebParameter {
+public:
+    const String& value() const { return _value; }
+
+private:
+    String _value;
+};
+
+class AsyncWebServerRequest {
+public:
+    bool hasParam(const char*) const { return false; }
+    const AsyncWebParameter* getParam(const char*) const { return &_param; }
+    void send(int, const char*, const char*) {}
+
+private:
+    AsyncWebParameter _param;
+};
+
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(uint16_t) {}
+    void on(const char*, WebRequestMethod, ArRequestHandlerFunction) {}
+};
+
+#endif // SIM_ASYNC_WEB_SERVER_SHIM_H
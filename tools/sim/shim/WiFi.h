@@ -0,0 +1,133 @@
+// ========================================================================
+// WiFi.h mínimo para probar en el host los módulos que salen por la STA
+// (UpstreamPublisher): IPAddress, un WiFiClient sobre sockets TCP POSIX y
+// un objeto WiFi cuyo isConnected() se puede bajar para simular un corte
+// del enlace (WiFi.setConnected(false)).
+// ========================================================================
+#ifndef SIM_WIFI_SHIM_H
+#define SIM_WIFI_SHIM_H
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class IPAddress {
+public:
+    IPAddress() : _addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr(htonl((uint32_t)a << 24 | b << 16 | c << 8 | d)) {}
+    bool fromString(const char* s) {
+        in_addr a;
+        if (!s || inet_pton(AF_INET, s, &a) != 1) return false;
+        _addr = a.s_addr;
+        return true;
+    }
+    bool fromString(const String& s) { return fromString(s.c_str()); }
+    String toString() const {
+        char buf[INET_ADDRSTRLEN];
+        in_addr a;
+        a.s_addr = _addr;
+        inet_ntop(AF_INET, &a, buf, sizeof(buf));
+        return String(buf);
+    }
+    // Orden de red, como lo guarda lwIP
+    uint32_t raw() const { return _addr; }
+
+private:
+    uint32_t _addr;
+};
+
+inline sockaddr_in sim_sockaddr(const IPAddress& ip, uint16_t port) {
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = ip.raw();
+    return sa;
+}
+
+class WiFiClient {
+public:
+    ~WiFiClient() { stop(); }
+
+    // connect() no bloqueante con plazo, como el de arduino-esp32
+    int connect(const IPAddress& ip, uint16_t port, int32_t timeout_ms) {
+        stop();
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (_fd < 0) return 0;
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+        const sockaddr_in sa = sim_sockaddr(ip, port);
+        if (::connect(_fd, (const sockaddr*)&sa, sizeof(sa)) != 0) {
+            pollfd p = { _fd, POLLOUT, 0 };
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (errno != EINPROGRESS || poll(&p, 1, timeout_ms) != 1
+                || getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+                stop();
+                return 0;
+            }
+        }
+        // Escrituras bloqueantes, como el WiFiClient del ESP32
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) & ~O_NONBLOCK);
+        return 1;
+    }
+    void setNoDelay(bool on) {
+        const int v = on ? 1 : 0;
+        if (_fd >= 0) setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+    }
+    uint8_t connected() {
+        if (_fd < 0) return 0;
+        char c;
+        const ssize_t n = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) stop();
+        return _fd >= 0;
+    }
+    size_t write(const uint8_t* buf, size_t len) {
+        if (_fd < 0) return 0;
+        size_t off = 0;
+        while (off < len) {
+            const ssize_t n = ::send(_fd, buf + off, len - off, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            off += (size_t)n;
+        }
+        return off;
+    }
+    int available() {
+        int n = 0;
+        if (_fd < 0 || ioctl(_fd, FIONREAD, &n) != 0) return 0;
+        return n;
+    }
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    int read(uint8_t* buf, size_t len) {
+        if (_fd < 0) return -1;
+        const ssize_t n = recv(_fd, buf, len, MSG_DONTWAIT);
+        return n > 0 ? (int)n : -1;
+    }
+    void stop() {
+        if (_fd >= 0) close(_fd);
+        _fd = -1;
+    }
+
+private:
+    int _fd = -1;
+};
+
+class SimWiFi {
+public:
+    bool isConnected() const { return _connected.load(std::memory_order_relaxed); }
+    void setConnected(bool on) { _connected.store(on, std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> _connected{true};
+};
+inline SimWiFi WiFi;
+
+#endif // SIM_WIFI_SHIM_H
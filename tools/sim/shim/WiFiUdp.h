@@ -0,0 +1,38 @@
+// ========================================================================
+// WiFiUdp.h mínimo para el host: beginPacket/write/endPacket sobre un
+// socket UDP POSIX (un datagrama por endPacket, como en el ESP32).
+// ========================================================================
+#ifndef SIM_WIFI_UDP_SHIM_H
+#define SIM_WIFI_UDP_SHIM_H
+
+#include <vector>
+#include <WiFi.h>
+
+class WiFiUDP {
+public:
+    ~WiFiUDP() {
+        if (_fd >= 0) close(_fd);
+    }
+    int beginPacket(const IPAddress& ip, uint16_t port) {
+        if (_fd < 0) _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (_fd < 0) return 0;
+        _to = sim_sockaddr(ip, port);
+        _pkt.clear();
+        return 1;
+    }
+    size_t write(const uint8_t* buf, size_t len) {
+        _pkt.insert(_pkt.end(), buf, buf + len);
+        return len;
+    }
+    int endPacket() {
+        const ssize_t n = sendto(_fd, _pkt.data(), _pkt.size(), 0, (const sockaddr*)&_to, sizeof(_to));
+        return n == (ssize_t)_pkt.size() ? 1 : 0;
+    }
+
+private:
+    int _fd = -1;
+    sockaddr_in _to = {};
+    std::vector<uint8_t> _pkt;
+};
+
+#endif // SIM_WIFI_UDP_SHIM_H
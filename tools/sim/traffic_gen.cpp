@@ -0,0 +1,297 @@
+// ========================================================================
+// traffic_gen.cpp
+// Generador de tráfico para el modo raw-forward: arma la misma escena que
+// concentrator_sim (SimScene.h), agrupa los frames en batches como lo hace
+// RawForwarder (lleno o FORWARD_FLUSH_MS) y los envía por UDP o TCP a
+// tools/solver/raw_solver, haciéndose pasar por un concentrador.
+// - Zonas: con --zones N el área se parte en N franjas en x y este proceso
+//   es el concentrador de la franja --zone K. Oye las anclas de su franja y
+//   las que están a menos de --overlap m del borde (también las oye la
+//   vecina). Se lanza un proceso por zona, todos con la misma semilla.
+// - --send fixes: resuelve en el proceso con su propio PositioningManager
+//   (un concentrador en modo local) y envía batches de fixes en lugar de
+//   frames.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -DPERF_PROBES=0 -DSHIM_WALL_CLOCK -Itools/sim/shim -Iinclude
+//       -Ilib/ArduinoJson-6.21.5/src tools/sim/traffic_gen.cpp
+//       src/PositioningManager.cpp src/TimeBase.cpp src/AsyncLog.cpp -o traffic_gen
+// Uso:
+//   ./traffic_gen [opciones de escena de concentrator_sim] [--proto v1|v2|v2s]
+//                 [--target IP:PUERTO] [--transport udp|tcp] [--speed X]
+//                 [--batch-ms MS] [--batch-loss P] [--source ID]
+//                 [--zones N --zone K --overlap M] [--send raw|fixes]
+//                 [--write-layout anclas.csv]
+// --speed 1 reproduce en tiempo real; 0 envía sin pausas. --batch-loss
+// descarta batches antes de enviarlos (el solver los cuenta como huecos).
+// ========================================================================
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include "SimScene.h"
+#include "RawBatch.h"
+#include "PositioningManager.h"
+#include "StreamCodec.h"
+#include "AsyncLog.h"
+
+struct GenOptions {
+    Proto       proto = PROTO_V2;
+    std::string host = "127.0.0.1";
+    uint16_t    port = RAW_FORWARD_PORT;
+    bool        tcp = false;
+    double      speed = 1.0;
+    int         batch_ms = 20;        // FORWARD_FLUSH_MS del firmware
+    float       batch_loss = 0.0f;
+    uint32_t    source = 0;           // 0 = 0xC0DE0000 + zona
+    int         zones = 1;
+    int         zone = 0;
+    float       overlap_m = 3.0f;
+    bool        send_fixes = false;
+    int         min_anchors = 4;
+    std::string layout;
+};
+
+struct GenStats {
+    uint64_t batches = 0;
+    uint64_t records = 0;             // frames o fixes enviados
+    uint64_t bytes = 0;
+    uint64_t lost = 0;                // descartados a propósito (--batch-loss)
+    uint64_t send_errors = 0;
+    uint64_t frames_heard = 0;        // frames de anclas de la zona
+};
+
+static bool writeLayout(const std::string& path, const Scene& scene) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) { perror(path.c_str()); return false; }
+    fprintf(f, "# saddr,x,y,z\n");
+    for (const SimAnchor& a : scene.anchors) fprintf(f, "%04x,%.3f,%.3f,%.3f\n", a.saddr, a.x, a.y, a.z);
+    fclose(f);
+    return true;
+}
+
+// Anclas que oye el concentrador de la zona: las de su franja y las de
+// borde de las vecinas
+static std::vector<bool> zoneAnchors(const Config& cfg, const GenOptions& opt, const Scene& scene) {
+    const float width = cfg.area_m / opt.zones;
+    const float lo = opt.zone * width, hi = lo + width;
+    std::vector<bool> heard;
+    for (const SimAnchor& a : scene.anchors) {
+        const bool inside = (a.x >= lo && a.x < hi) || (opt.zone == opt.zones - 1 && a.x >= hi);
+        const bool border = (opt.zone > 0 && fabsf(a.x - lo) < opt.overlap_m)
+                         || (opt.zone < opt.zones - 1 && fabsf(a.x - hi) < opt.overlap_m);
+        heard.push_back(inside || border);
+    }
+    return heard;
+}
+
+static int openSocket(const GenOptions& opt, sockaddr_in& addr) {
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1) {
+        fprintf(stderr, "IP inválida: %s\n", opt.host.c_str());
+        return -1;
+    }
+    const int fd = socket(AF_INET, opt.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    if (opt.tcp) {
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            close(fd);
+            return -1;
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const GenOptions& opt, const sockaddr_in& addr, const uint8_t* data, size_t len) {
+    if (!opt.tcp) return sendto(fd, data, len, 0, (const sockaddr*)&addr, sizeof(addr)) == (ssize_t)len;
+    while (len > 0) {
+        const ssize_t n = send(fd, data, len, 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr, "uso: traffic_gen [opciones de escena de concentrator_sim] [--proto v1|v2|v2s]\n"
+                    "                 [--target IP:PUERTO] [--transport udp|tcp] [--speed X]\n"
+                    "                 [--batch-ms MS] [--batch-loss P] [--source ID]\n"
+                    "                 [--zones N --zone K --overlap M] [--send raw|fixes] [--min-anchors N]\n"
+                    "                 [--write-layout FILE]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    GenOptions opt;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) usage();
+        const char* v = argv[++i];
+        if (parseSceneOption(cfg, arg, v)) continue;
+        if (arg == "--proto") {
+            int p = 0;
+            while (p < PROTO_COUNT && strcmp(v, PROTO_NAMES[p]) != 0) p++;
+            if (p == PROTO_COUNT) usage();
+            opt.proto = (Proto)p;
+        } else if (arg == "--target") {
+            const char* colon = strrchr(v, ':');
+            if (!colon) usage();
+            opt.host.assign(v, colon - v);
+            opt.port = (uint16_t)atoi(colon + 1);
+        } else if (arg == "--transport") {
+            if (strcmp(v, "udp") != 0 && strcmp(v, "tcp") != 0) usage();
+            opt.tcp = strcmp(v, "tcp") == 0;
+        } else if (arg == "--send") {
+            if (strcmp(v, "raw") != 0 && strcmp(v, "fixes") != 0) usage();
+            opt.send_fixes = strcmp(v, "fixes") == 0;
+        } else if (arg == "--speed") opt.speed = atof(v);
+        else if (arg == "--batch-ms") opt.batch_ms = atoi(v);
+        else if (arg == "--batch-loss") opt.batch_loss = (float)atof(v);
+        else if (arg == "--source") opt.source = (uint32_t)strtoul(v, nullptr, 0);
+        else if (arg == "--zones") opt.zones = atoi(v);
+        else if (arg == "--zone") opt.zone = atoi(v);
+        else if (arg == "--overlap") opt.overlap_m = (float)atof(v);
+        else if (arg == "--min-anchors") opt.min_anchors = atoi(v);
+        else if (arg == "--write-layout") opt.layout = v;
+        else usage();
+    }
+    if (cfg.tags < 1 || cfg.anchors < 4 || cfg.rate_hz <= 0 || cfg.seconds < 1 || opt.speed < 0) usage();
+    if (opt.zones < 1 || opt.zone < 0 || opt.zone >= opt.zones) usage();
+    // Resolver en el proceso necesita el tiempo real: los plazos son en ms
+    if (opt.send_fixes && opt.speed != 1.0) usage();
+    if (opt.source == 0) opt.source = 0xC0DE0000u + (uint32_t)opt.zone;
+    asyncLog.setLevel(LOG_LEVEL_OFF);
+
+    Scene scene;
+    const std::vector<Frame> trace = buildTrace(cfg, opt.proto, scene);
+    if (!opt.layout.empty() && !writeLayout(opt.layout, scene)) return 1;
+    if (trace.empty()) return 0;
+    const std::vector<bool> heard = zoneAnchors(cfg, opt, scene);
+
+    sockaddr_in addr;
+    const int fd = openSocket(opt, addr);
+    if (fd < 0) return 1;
+
+    std::mt19937 rng(cfg.seed + 3 + opt.zone);
+    std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+    GenStats st;
+    const uint8_t magic = opt.send_fixes ? FIX_BATCH_MAGIC : RAW_BATCH_MAGIC;
+    RawBatchBuilder batch;
+    uint32_t nextSeq = 0, batchStart = 0;
+    batch.begin(opt.source, nextSeq++, magic);
+
+    const uint32_t t_first = trace.front().t_ms;
+    const auto wall0 = std::chrono::steady_clock::now();
+    // Reloj del concentrador simulado: la escena, escalada por --speed
+    auto sceneNow = [&]() -> uint32_t {
+        if (opt.speed == 0) return 0;
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall0).count();
+        return t_first + (uint32_t)(ms * opt.speed);
+    };
+    auto flush = [&](uint32_t sent_ms) {
+        if (batch.empty()) return;
+        batch.finish(sent_ms, 0);
+        if (opt.batch_loss > 0 && uni(rng) < opt.batch_loss) {
+            st.lost++;
+        } else if (sendAll(fd, opt, addr, batch.data(), batch.size())) {
+            st.batches++;
+            st.records += batch.count();
+            st.bytes += batch.size();
+        } else {
+            st.send_errors++;
+        }
+        batch.begin(opt.source, nextSeq++, magic);
+    };
+
+    // --send fixes: el concentrador de la zona resuelve con sus anclas
+    PositioningManager manager(opt.min_anchors);
+    for (const SimAnchor& a : scene.anchors) manager.setAnchorPosition(a.saddr, a.x, a.y, a.z);
+    uint32_t fixTime = 0;   // t_ms de escena del fix en curso
+    manager.addFixListener([&](const TagFix& fix) {
+        StreamEvent ev;
+        ev.type = STREAM_EVT_FIX;
+        ev.fix = fix;
+        ev.fix.t_ms = fixTime - (millis() - fix.t_ms);   // millis() del host -> reloj de la escena
+        uint8_t rec[sizeof(BinFixRecord_t)];
+        encode_event_struct(ev, rec, sizeof(rec));
+        if (batch.empty()) batchStart = fixTime;
+        if (!batch.addRecord(rec, sizeof(rec))) {
+            flush(fixTime);
+            batchStart = fixTime;
+            batch.addRecord(rec, sizeof(rec));
+        }
+    });
+
+    for (const Frame& f : trace) {
+        if (opt.speed > 0) {
+            std::this_thread::sleep_until(wall0 + std::chrono::microseconds(
+                (int64_t)((f.t_ms - t_first) * 1000.0 / opt.speed)));
+        }
+        if (!batch.empty() && f.t_ms - batchStart >= (uint32_t)opt.batch_ms) flush(f.t_ms);
+        uint16_t saddr = 0;
+        if (!anchor_frame_saddr(f.data, f.len, saddr)) continue;
+        const int idx = saddr - scene.anchors.front().saddr;
+        if (idx < 0 || idx >= (int)heard.size() || !heard[idx]) continue;
+        st.frames_heard++;
+
+        if (opt.send_fixes) {
+            fixTime = f.t_ms;
+            const uint32_t rx_ms = millis();
+            decode_anchor_frame(f.data, f.len, [&](DecodedAnchorReport_t& report) {
+                report.rx_ms = rx_ms;
+                report.rx_rssi = -60;
+                manager.addAnchorReport(report);
+            }, [&](const TagTelemetryRecord_t& telemetry) {
+                manager.addTagTelemetry(telemetry, rx_ms);
+            });
+            manager.poll();
+            continue;
+        }
+
+        const uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0x00, (uint8_t)(saddr >> 8), (uint8_t)saddr };
+        if (batch.empty()) batchStart = f.t_ms;
+        if (!batch.add(mac, f.data, f.len, -60, f.t_ms)) {
+            flush(f.t_ms);
+            batchStart = f.t_ms;
+            batch.add(mac, f.data, f.len, -60, f.t_ms);
+        }
+    }
+    if (opt.send_fixes) {
+        // Las secuencias que quedan cierran por plazo
+        const uint32_t until = millis() + SEQUENCE_TIMEOUT_MS + SEQUENCE_SWEEP_MS;
+        while ((int32_t)(until - millis()) > 0) {
+            fixTime = sceneNow();
+            manager.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    flush(opt.speed > 0 ? sceneNow() : trace.back().t_ms);
+    close(fd);
+
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+    int zoneAnchorCount = 0;
+    for (bool h : heard) zoneAnchorCount += h;
+    printf("%s %s %s:%u  fuente %08lx  zona %d/%d (%d anclas)  envía %s\n", PROTO_NAMES[opt.proto],
+           opt.tcp ? "tcp" : "udp", opt.host.c_str(), opt.port, (unsigned long)opt.source, opt.zone, opt.zones,
+           zoneAnchorCount, opt.send_fixes ? "fixes" : "frames");
+    printf("%zu secuencias en la escena, %zu frames ESP-NOW (%llu de la zona)\n", scene.truth.size(), trace.size(),
+           (unsigned long long)st.frames_heard);
+    printf("%llu batches (%.1f %s/batch, %llu bytes), %llu descartados a propósito, %llu errores de envío\n",
+           (unsigned long long)st.batches, st.batches ? (double)st.records / st.batches : 0.0,
+           opt.send_fixes ? "fixes" : "frames", (unsigned long long)st.bytes, (unsigned long long)st.lost,
+           (unsigned long long)st.send_errors);
+    printf("%.2f s de pared (%.0f %s/s)\n", wall_s, wall_s > 0 ? st.records / wall_s : 0.0,
+           opt.send_fixes ? "fixes" : "frames");
+    return st.send_errors ? 1 : 0;
+}
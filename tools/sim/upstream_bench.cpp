@@ -0,0 +1,394 @@
+// ========================================================================
+// upstream_bench.cpp
+// Banco del publicador de fixes (UpstreamPublisher) en el host. El mismo
+// código del firmware publica hacia un receptor local en este proceso:
+// - UDP: un socket que decodifica cada datagrama (binario o JSON).
+// - MQTT: un broker mínimo (CONNECT/CONNACK, PUBLISH QoS 0, PINGREQ).
+// Un hilo productor hace de fix listener (tag a tag, a --rate fixes/s) y el
+// hilo principal llama a loop() cada 5 ms, como el loop() del firmware.
+// --outage-ms baja la STA un rato para ver la cola y los descartes.
+// Informa fixes entregados, descartes, batches, fixes por batch, bytes por
+// fix, eficiencia y latencia (la del publicador y la de punta a punta).
+// --probe-ms arranca el LinkProbe del firmware contra 127.0.0.1 (ICMP de
+// Linux por el shim ESP32Ping.h; hace falta root o ping_group_range) y
+// --impair-* empeora esos ecos un rato: cada segundo se imprime el nivel
+// del enlace, el batching elegido y la peor parada de loop(). Con
+// --inline-ping el eco se hace dentro de loop(), para ver lo que bloquea.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -pthread -DPERF_PROBES=0 -DSHIM_WALL_CLOCK -Itools/sim/shim -Iinclude
+//       -Ilib/ArduinoJson-6.21.5/src tools/sim/upstream_bench.cpp src/UpstreamPublisher.cpp
+//       src/PositioningManager.cpp src/TimeBase.cpp src/AsyncLog.cpp src/LinkProbe.cpp -o upstream_bench
+// Uso:
+//   ./upstream_bench [--proto udp|mqtt] [--format bin|json] [--batch N] [--flush-ms N]
+//                    [--rate FIXES_S] [--tags N] [--seconds S] [--port N]
+//                    [--outage-at S --outage-ms MS] [--sweep]
+//                    [--probe-ms MS [--inline-ping] [--no-adapt]
+//                     [--impair-at S --impair-s S --impair-loss P --impair-delay MS]]
+// --sweep recorre protocolo x formato x batch con los demás parámetros.
+// ========================================================================
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ESP32Ping.h>
+#include "UpstreamPublisher.h"
+#include "LinkProbe.h"
+#include "AsyncLog.h"
+
+struct BenchOptions {
+    UpstreamProto  proto = UPSTREAM_UDP;
+    UpstreamFormat format = UPSTREAM_BIN;
+    int      batch = UPSTREAM_BATCH_FIXES;
+    int      flush_ms = UPSTREAM_FLUSH_MS;
+    int      rate = 200;          // fixes/s (40 tags a 5 Hz)
+    int      tags = 40;
+    int      seconds = 10;
+    uint16_t port = 0;            // 0: 9751 (UDP) o 1883 (MQTT)
+    int      outage_at_s = 0;
+    int      outage_ms = 0;
+    bool     sweep = false;
+    int      probe_ms = 0;        // 0: sin LinkProbe
+    bool     inline_ping = false;
+    bool     adapt = true;
+    int      impair_at_s = 0;
+    int      impair_s = 0;
+    float    impair_loss = 0.0f;
+    int      impair_delay_ms = 0;
+};
+
+// Lo que ve el colector
+struct Received {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> fixes{0};
+    std::atomic<uint64_t> bad{0};         // mensajes que no decodifican
+    std::vector<uint32_t> latency;        // por fix: recibido - t_ms (ms)
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    void addFix(uint32_t t_ms, uint32_t now) {
+        portENTER_CRITICAL(&lock);
+        latency.push_back(now - t_ms);
+        portEXIT_CRITICAL(&lock);
+        fixes++;
+    }
+};
+
+static void handlePayload(const uint8_t* data, size_t len, Received& rx) {
+    const uint32_t now = millis();
+    rx.messages++;
+    rx.bytes += len;
+    if (len > 0 && data[0] == FIX_BATCH_MAGIC) {
+        RawBatchInfo info = decode_fix_batch<BinFixRecord_t>(data, len, [&](const BinFixRecord_t& r) {
+            rx.addFix(r.t_ms, now);
+        });
+        if (!info.ok || info.truncated) rx.bad++;
+        return;
+    }
+    DynamicJsonDocument doc(8192);
+    if (deserializeJson(doc, (const char*)data, len) != DeserializationError::Ok || !doc["fixes"].is<JsonArray>()) {
+        rx.bad++;
+        return;
+    }
+    for (JsonObject f : doc["fixes"].as<JsonArray>()) rx.addFix(f["t_ms"].as<uint32_t>(), now);
+}
+
+static int listenSocket(int type, uint16_t port) {
+    const int fd = socket(AF_INET, type, 0);
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    IPAddress lo(127, 0, 0, 1);
+    const sockaddr_in sa = sim_sockaddr(lo, port);
+    if (bind(fd, (const sockaddr*)&sa, sizeof(sa)) != 0 || (type == SOCK_STREAM && listen(fd, 4) != 0)) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void udpListener(int fd, Received& rx, std::atomic<bool>& stop) {
+    uint8_t buf[2048];
+    while (!stop) {
+        pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) != 1) continue;
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) handlePayload(buf, (size_t)n, rx);
+    }
+}
+
+// Broker MQTT mínimo: una conexión a la vez, solo lo que usa el publicador
+static bool readFull(int fd, uint8_t* buf, size_t len, std::atomic<bool>& stop) {
+    size_t off = 0;
+    while (off < len && !stop) {
+        pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) != 1) continue;
+        const ssize_t n = recv(fd, buf + off, len - off, 0);
+        if (n <= 0) return false;
+        off += (size_t)n;
+    }
+    return off == len;
+}
+
+static void mqttBroker(int fd, Received& rx, std::atomic<bool>& stop, std::atomic<uint32_t>& connects) {
+    std::vector<uint8_t> body;
+    while (!stop) {
+        pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) != 1) continue;
+        const int c = accept(fd, nullptr, nullptr);
+        if (c < 0) continue;
+        for (;;) {
+            uint8_t type;
+            if (!readFull(c, &type, 1, stop)) break;
+            uint32_t remaining = 0;
+            bool ok = true;
+            for (int shift = 0; shift < 28; shift += 7) {
+                uint8_t b;
+                if (!(ok = readFull(c, &b, 1, stop))) break;
+                remaining |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            if (!ok) break;
+            body.resize(remaining);
+            if (remaining && !readFull(c, body.data(), remaining, stop)) break;
+
+            if ((type & 0xF0) == 0x10) {                     // CONNECT
+                connects++;
+                const uint8_t ack[4] = { 0x20, 0x02, 0x00, 0x00 };
+                ::send(c, ack, sizeof(ack), MSG_NOSIGNAL);
+            } else if ((type & 0xF0) == 0x30 && remaining >= 2) {   // PUBLISH QoS 0
+                const size_t topicLen = (size_t)body[0] << 8 | body[1];
+                if (2 + topicLen <= remaining) handlePayload(body.data() + 2 + topicLen, remaining - 2 - topicLen, rx);
+                else rx.bad++;
+            } else if ((type & 0xF0) == 0xC0) {              // PINGREQ
+                const uint8_t resp[2] = { 0xD0, 0x00 };
+                ::send(c, resp, sizeof(resp), MSG_NOSIGNAL);
+            } else if ((type & 0xF0) == 0xE0) {              // DISCONNECT
+                break;
+            }
+        }
+        close(c);
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t>& v, double q) {
+    if (v.empty()) return 0;
+    const size_t i = std::min(v.size() - 1, (size_t)(q * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+static void printHistogram(const char* name, const LinkHistogram& h) {
+    printf("  %-16s", name);
+    for (uint8_t i = 0; i <= h.n; i++) {
+        if (i < h.n) printf(" <=%g:%lu", h.le[i], (unsigned long)h.buckets[i]);
+        else printf(" +Inf:%lu", (unsigned long)h.buckets[i]);
+    }
+    printf("  (n=%lu, media %.3f)\n", (unsigned long)h.count, h.count ? h.sum / h.count : 0.0);
+}
+
+static void runOnce(const BenchOptions& opt, bool header) {
+    const uint16_t port = opt.port ? opt.port : (opt.proto == UPSTREAM_MQTT ? 1883 : UPSTREAM_PORT);
+    Received rx;
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> connects{0};
+    const int fd = listenSocket(opt.proto == UPSTREAM_MQTT ? SOCK_STREAM : SOCK_DGRAM, port);
+    if (fd < 0) return;
+    std::thread listener = (opt.proto == UPSTREAM_MQTT)
+        ? std::thread(mqttBroker, fd, std::ref(rx), std::ref(stop), std::ref(connects))
+        : std::thread(udpListener, fd, std::ref(rx), std::ref(stop));
+
+    // Configuración como la haría /upstream
+    std::unique_ptr<UpstreamPublisher> publisher(new UpstreamPublisher());
+    UpstreamPublisher& pub = *publisher;
+    PositioningManager manager(4);
+    const uint8_t mac[6] = { 0x24, 0x6f, 0x28, 0xbe, 0x7c, 0x01 };
+    pub.begin(manager, mac);
+    pub.setTarget(IPAddress(127, 0, 0, 1), port, opt.proto);
+    pub.setFormat(opt.format);
+    pub.setBatching((uint16_t)opt.batch, (uint16_t)opt.flush_ms);
+    WiFi.setConnected(true);
+
+    // El sondeo vive hasta el final del proceso (su tarea no termina): sin
+    // --sweep, una sola corrida, y publicador y sondeo no se liberan
+    LinkProbe* link = nullptr;
+    if (opt.probe_ms > 0) {
+        link = new LinkProbe();
+        link->setIntervalMs((uint32_t)opt.probe_ms);
+        link->setAdapt(opt.adapt);
+        link->setEnabled(!opt.inline_ping);
+        link->begin(pub);
+        publisher.release();
+        printf("   t  nivel    batch flush  rtt.ms  pérdida  entregados/s  parada.max.ms\n");
+    }
+    const IPAddress lo(127, 0, 0, 1);
+
+    // Productor: el fix listener, en otro hilo como la tarea Wi-Fi
+    const uint32_t start = millis();
+    const uint32_t runMs = (uint32_t)opt.seconds * 1000;
+    std::atomic<bool> producing{true};
+    std::atomic<uint64_t> offered{0};
+    std::thread producer([&] {
+        std::vector<uint16_t> seq(opt.tags, 0);
+        uint64_t n = 0;
+        while (millis() - start < runMs) {
+            const uint64_t due = (uint64_t)(millis() - start) * opt.rate / 1000;
+            for (; n < due; n++) {
+                TagFix fix;
+                fix.tag_uid = 0xA0000000u + (uint32_t)(n % opt.tags);
+                fix.seq = seq[n % opt.tags]++;
+                fix.pos = { (float)(n % 500) * 0.1f, (float)(n % 300) * 0.1f, 1.2f };
+                fix.rms = 0.05f;
+                fix.anchors = 6;
+                fix.is3D = true;
+                fix.t_ms = millis();
+                pub.push(fix);
+            }
+            offered = n;
+            delay(1);
+        }
+        producing = false;
+    });
+
+    // loop() del firmware, con el corte de la STA y el enlace empeorado
+    const uint32_t outageStart = (uint32_t)opt.outage_at_s * 1000;
+    const uint32_t impairStart = (uint32_t)opt.impair_at_s * 1000;
+    uint32_t stallMax = 0, stallMaxTotal = 0, lastProbe = 0, nextReport = 1000;
+    uint64_t reportedFixes = 0;
+    while (producing || (pub.depth() > 0 && millis() - start < runMs + 2000)) {
+        const uint32_t t = millis() - start;
+        WiFi.setConnected(!(opt.outage_ms > 0 && t >= outageStart && t < outageStart + (uint32_t)opt.outage_ms));
+        if (link) {
+            const bool impaired = opt.impair_s > 0 && t >= impairStart && t < impairStart + (uint32_t)opt.impair_s * 1000;
+            Ping.impair(impaired ? opt.impair_loss : 0.0f, impaired ? (uint32_t)opt.impair_delay_ms : 0);
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        pub.loop();
+        if (link && opt.inline_ping && t - lastProbe >= (uint32_t)opt.probe_ms) {
+            lastProbe = t;
+            link->probe(lo);                         // lo que no hay que hacer: bloquea loop()
+        }
+        const uint32_t stall = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - t0).count();
+        stallMax = std::max(stallMax, stall);
+        stallMaxTotal = std::max(stallMaxTotal, stall);
+
+        if (link && t >= nextReport) {
+            printf("%4u  %-7s %6u %5u %7.2f %8.3f %13llu %14u\n", nextReport / 1000, LinkProbe::levelName(link->level()),
+                   pub.batchFixes(), pub.flushMs(), link->rttMs(), link->lossRatio(),
+                   (unsigned long long)(rx.fixes - reportedFixes), stallMax);
+            fflush(stdout);
+            reportedFixes = rx.fixes;
+            stallMax = 0;
+            nextReport += 1000;
+        }
+        delay(5);
+    }
+    producer.join();
+    delay(200);                                      // lo que queda en vuelo
+    stop = true;
+    listener.join();
+    close(fd);
+
+    std::vector<uint32_t> lat = rx.latency;
+    const double elapsed = opt.seconds;
+    if (header) {
+        printf("proto fmt   batch flush  ofrecidos  entregados  descartes  err  batches  fix/batch  B/fix  efic.  "
+               "lat.p50  lat.p99  lat.max  msgs/s\n");
+    }
+    printf("%-5s %-5s %5d %5d %10llu %11llu %10lu %4lu %8lu %10.1f %6.1f %6.3f %7u %8u %8u %7.0f\n",
+           UpstreamPublisher::protoName(opt.proto), UpstreamPublisher::formatName(opt.format), pub.batchFixes(),
+           pub.flushMs(), (unsigned long long)offered.load(), (unsigned long long)rx.fixes.load(),
+           (unsigned long)pub.dropped(), (unsigned long)pub.sendErrors(), (unsigned long)pub.batches(),
+           pub.fixesPerBatch(), rx.fixes ? (double)rx.bytes / rx.fixes : 0.0, pub.efficiency(), percentile(lat, 0.5), percentile(lat, 0.99),
+           lat.empty() ? 0u : *std::max_element(lat.begin(), lat.end()), rx.messages / elapsed);
+    if (rx.bad) printf("  !! %llu mensajes sin decodificar\n", (unsigned long long)rx.bad.load());
+    if (opt.proto == UPSTREAM_MQTT && connects != 1) printf("  conexiones MQTT: %u\n", connects.load());
+    if (link) {
+        printf("sondeo: %lu ecos ok, %lu perdidos, %lu cambios de nivel, parada máx. de loop() %u ms\n",
+               (unsigned long)link->probesOk(), (unsigned long)link->probesLost(),
+               (unsigned long)link->levelChanges(), stallMaxTotal);
+        printHistogram("rtt ms", link->rttHistogram());
+        printHistogram("pérdida/ventana", link->lossHistogram());
+    }
+    fflush(stdout);
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const std::string a = argv[i];
+        auto next = [&](int& v) {
+            if (i + 1 >= argc) return false;
+            v = atoi(argv[++i]);
+            return true;
+        };
+        int v = 0;
+        if (a == "--proto" && i + 1 < argc) {
+            const std::string p = argv[++i];
+            if (p != "udp" && p != "mqtt") return false;
+            opt.proto = (p == "mqtt") ? UPSTREAM_MQTT : UPSTREAM_UDP;
+        } else if (a == "--format" && i + 1 < argc) {
+            const std::string f = argv[++i];
+            if (f != "bin" && f != "json") return false;
+            opt.format = (f == "json") ? UPSTREAM_JSON : UPSTREAM_BIN;
+        } else if (a == "--batch" && next(opt.batch)) {
+        } else if (a == "--flush-ms" && next(opt.flush_ms)) {
+        } else if (a == "--rate" && next(opt.rate)) {
+        } else if (a == "--tags" && next(opt.tags)) {
+        } else if (a == "--seconds" && next(opt.seconds)) {
+        } else if (a == "--port" && next(v)) {
+            opt.port = (uint16_t)v;
+        } else if (a == "--outage-at" && next(opt.outage_at_s)) {
+        } else if (a == "--outage-ms" && next(opt.outage_ms)) {
+        } else if (a == "--sweep") {
+            opt.sweep = true;
+        } else if (a == "--probe-ms" && next(opt.probe_ms)) {
+        } else if (a == "--inline-ping") {
+            opt.inline_ping = true;
+        } else if (a == "--no-adapt") {
+            opt.adapt = false;
+        } else if (a == "--impair-at" && next(opt.impair_at_s)) {
+        } else if (a == "--impair-s" && next(opt.impair_s)) {
+        } else if (a == "--impair-loss" && i + 1 < argc) {
+            opt.impair_loss = (float)atof(argv[++i]);
+        } else if (a == "--impair-delay" && next(opt.impair_delay_ms)) {
+        } else {
+            return false;
+        }
+    }
+    return opt.tags > 0 && opt.rate > 0 && opt.seconds > 0 && opt.batch > 0 && opt.flush_ms > 0
+        && !(opt.sweep && opt.probe_ms > 0) && (opt.probe_ms == 0 || opt.probe_ms >= 100);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        fprintf(stderr, "uso: %s [--proto udp|mqtt] [--format bin|json] [--batch N] [--flush-ms N] [--rate FIXES_S]\n"
+                        "       [--tags N] [--seconds S] [--port N] [--outage-at S --outage-ms MS] [--sweep]\n"
+                        "       [--probe-ms MS [--inline-ping] [--no-adapt]\n"
+                        "        [--impair-at S --impair-s S --impair-loss P --impair-delay MS]]\n", argv[0]);
+        return 2;
+    }
+    asyncLog.setLevel(LOG_LEVEL_OFF);
+    if (!opt.sweep) {
+        runOnce(opt, true);
+        return 0;
+    }
+    bool header = true;
+    for (UpstreamProto proto : { UPSTREAM_UDP, UPSTREAM_MQTT }) {
+        for (UpstreamFormat format : { UPSTREAM_BIN, UPSTREAM_JSON }) {
+            for (int batch : { 1, 8, 32 }) {
+                BenchOptions o = opt;
+                o.proto = proto;
+                o.format = format;
+                o.batch = batch;
+                runOnce(o, header);
+                header = false;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+// ========================================================================
+// ZoneArbiter.h
+// Dueño de cada tag en un despliegue por zonas (un concentrador por zona).
+// - Cada (tag, seq) se publica una sola vez: el primero que llegue entre
+//   el fix resuelto aquí con la unión de las anclas de todas las zonas y
+//   el que resolvió el concentrador dueño del tag.
+// - El dueño es la zona que oye al tag con más anclas. Cambia (handover)
+//   cuando otra zona lo supera ZONE_HANDOVER_SEQS secuencias seguidas, o de
+//   inmediato si el dueño calla ZONE_OWNER_TIMEOUT_MS (el tag salió de su
+//   alcance). La histéresis evita que un tag en el borde rebote.
+// - Un ancla de borde que oyen dos concentradores suma en ambas zonas.
+// Lo usa un solo worker del solver (los tags se reparten por tag_uid):
+// sin locks.
+// ========================================================================
+#ifndef ZONE_ARBITER_H
+#define ZONE_ARBITER_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include "PositioningManager.h"
+
+#define ZONE_HANDOVER_SEQS     3     // secuencias seguidas en que otra zona oye más anclas
+#define ZONE_OWNER_TIMEOUT_MS  500   // dueño sin aportar: la zona que sí aporta toma el tag
+#define ZONE_TRACK             4     // zonas que pueden oír un mismo tag a la vez
+#define ZONE_PUBLISH_WINDOW    32    // seqs recordadas por tag para publicar cada una una vez
+
+struct ZoneArbiterStats {
+    uint64_t handovers = 0;          // por mayoría de anclas
+    uint64_t handovers_timeout = 0;  // por dueño callado
+    uint64_t merged_published = 0;   // fixes resueltos aquí
+    uint64_t zone_published = 0;     // fixes de un concentrador dueño
+    uint64_t zone_dropped = 0;       // fixes de zonas no dueñas o de seqs ya publicadas
+    uint64_t merged_late = 0;        // resueltos aquí con la seq ya publicada por una zona
+};
+
+class ZoneArbiter {
+public:
+    // Aporte de la zona a (tag, seq): un reporte crudo (1 ancla) o un fix
+    // resuelto allí (sus anclas)
+    void note(uint32_t tag_uid, uint16_t seq, uint32_t zone, uint8_t anchors, uint32_t now) {
+        TagZones& t = _tags[tag_uid];
+        if (!t.has_seq) {
+            t.seq = seq;
+            t.has_seq = true;
+        }
+        // Se cuentan la seq más nueva y la anterior: el batch de la otra
+        // zona puede llegar después del primer reporte de la siguiente
+        const int16_t d = (int16_t)(seq - t.seq);
+        if (d > 0) {
+            closeSequence(t, t.tally[1], now);
+            t.tally[1] = (d == 1) ? t.tally[0] : Tally();
+            t.tally[0] = Tally();
+            t.seq = seq;
+        } else if (d < -1) {
+            return;                                  // ya evaluada
+        }
+        checkTimeout(t, zone, now);
+        if (t.has_owner && t.owner == zone) t.owner_ms = now;
+        Tally& tally = t.tally[d < 0 ? 1 : 0];
+        for (uint8_t i = 0; i < tally.n; i++) {
+            if (tally.zone[i] == zone) {
+                tally.count[i] += anchors;
+                return;
+            }
+        }
+        if (tally.n < ZONE_TRACK) {
+            tally.zone[tally.n] = zone;
+            tally.count[tally.n++] = anchors;
+        }
+    }
+
+    // Fix resuelto con la unión de anclas: se publica si la seq no salió ya
+    bool offerMerged(const TagFix& fix) {
+        if (!claim(_tags[fix.tag_uid], fix.seq)) {
+            _stats.merged_late++;
+            return false;
+        }
+        _stats.merged_published++;
+        return true;
+    }
+
+    // Fix resuelto por el concentrador de zone: solo el del dueño
+    bool offerZone(uint32_t zone, const TagFix& fix, uint32_t now) {
+        note(fix.tag_uid, fix.seq, zone, fix.anchors, now);
+        TagZones& t = _tags[fix.tag_uid];
+        if (!t.has_owner) {
+            t.owner = zone;
+            t.has_owner = true;
+            t.owner_ms = now;
+        }
+        if (t.owner != zone || !claim(t, fix.seq)) {
+            _stats.zone_dropped++;
+            return false;
+        }
+        _stats.zone_published++;
+        return true;
+    }
+
+    // Zona dueña del tag (0 si todavía no tiene)
+    uint32_t owner(uint32_t tag_uid) const {
+        auto it = _tags.find(tag_uid);
+        return (it != _tags.end() && it->second.has_owner) ? it->second.owner : 0;
+    }
+
+    const ZoneArbiterStats& stats() const { return _stats; }
+
+    // Tags por zona dueña
+    template <typename F>
+    void forEachOwner(F&& f) const {
+        for (const auto& kv : _tags) {
+            if (kv.second.has_owner) f(kv.first, kv.second.owner);
+        }
+    }
+
+private:
+    // Anclas por zona en una secuencia
+    struct Tally {
+        uint32_t zone[ZONE_TRACK];
+        uint16_t count[ZONE_TRACK];
+        uint8_t  n = 0;
+    };
+
+    struct TagZones {
+        uint32_t owner = 0;
+        bool     has_owner = false;
+        uint32_t owner_ms = 0;           // último aporte del dueño
+        uint16_t seq = 0;                // seq más nueva que se está contando
+        bool     has_seq = false;
+        Tally    tally[2];               // [0] = seq, [1] = seq - 1
+        uint32_t candidate = 0;          // zona que supera al dueño...
+        uint8_t  wins = 0;               // ...en tantas secuencias seguidas
+        uint16_t top = 0;                // seq publicada más nueva...
+        uint32_t published = 0;          // ...y bitmap de las ZONE_PUBLISH_WINDOW anteriores (bit 0 = top)
+        bool     has_published = false;
+    };
+
+    // Publica (tag, seq) una vez. Las secuencias no cierran en orden (una
+    // espera su plazo mientras la siguiente se completa): se recuerda una
+    // ventana, como el filtro de duplicados del PositioningManager.
+    static bool claim(TagZones& t, uint16_t seq) {
+        if (!t.has_published) {
+            t.top = seq;
+            t.published = 1;
+            t.has_published = true;
+            return true;
+        }
+        const int16_t d = (int16_t)(seq - t.top);
+        if (d > 0) {
+            t.published = (d >= ZONE_PUBLISH_WINDOW) ? 1 : (t.published << d) | 1;
+            t.top = seq;
+            return true;
+        }
+        if (-d >= ZONE_PUBLISH_WINDOW) return false;
+        const uint32_t bit = 1u << -d;
+        if (t.published & bit) return false;
+        t.published |= bit;
+        return true;
+    }
+
+    void checkTimeout(TagZones& t, uint32_t zone, uint32_t now) {
+        if (!t.has_owner || t.owner == zone) return;
+        // Con signo: las zonas no llegan en orden estricto
+        if ((int32_t)(now - t.owner_ms) < ZONE_OWNER_TIMEOUT_MS) return;
+        t.owner = zone;
+        t.owner_ms = now;
+        t.wins = 0;
+        _stats.handovers_timeout++;
+    }
+
+    // Cierra la secuencia contada: mayoría de anclas con histéresis
+    void closeSequence(TagZones& t, const Tally& tally, uint32_t now) {
+        if (tally.n == 0) return;
+        uint8_t best = 0;
+        uint16_t ownerCount = 0;
+        for (uint8_t i = 0; i < tally.n; i++) {
+            if (tally.count[i] > tally.count[best]) best = i;
+            if (t.has_owner && tally.zone[i] == t.owner) ownerCount = tally.count[i];
+        }
+        const uint32_t bestZone = tally.zone[best];
+        if (!t.has_owner) {
+            t.owner = bestZone;
+            t.has_owner = true;
+            t.owner_ms = now;
+        } else if (bestZone != t.owner && tally.count[best] > ownerCount) {
+            if (t.candidate != bestZone) {
+                t.candidate = bestZone;
+                t.wins = 0;
+            }
+            if (++t.wins >= ZONE_HANDOVER_SEQS) {
+                t.owner = bestZone;
+                t.owner_ms = now;
+                t.wins = 0;
+                _stats.handovers++;
+            }
+        } else {
+            t.wins = 0;
+        }
+    }
+
+    std::unordered_map<uint32_t, TagZones> _tags;
+    ZoneArbiterStats _stats;
+};
+
+#endif // ZONE_ARBITER_H
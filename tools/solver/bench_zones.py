@@ -0,0 +1,83 @@
+# ========================================================================
+# bench_zones.py
+# Rendimiento del agregador (raw_solver) frente a la cantidad de
+# concentradores. Para cada N lanza el solver y N procesos traffic_gen, uno
+# por zona, sobre el mismo sitio con N veces más tags, y resume fixes,
+# handovers y CPU del solver. Todo sobre loopback.
+#
+# Uso (desde la raíz del repo, con raw_solver y traffic_gen compilados):
+#   python tools/solver/bench_zones.py --bin . --zones 1 2 3 4
+#   python tools/solver/bench_zones.py --bin . --send fixes --tags-per-zone 15
+# ========================================================================
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+SITE = ["--anchors", "25", "--area", "50"]
+
+
+def summary_value(text, pattern, cast=int):
+    m = re.search(pattern, text)
+    return cast(m.group(1)) if m else 0
+
+
+def run(args, zones, port):
+    scene = SITE + ["--tags", str(args.tags_per_zone * zones), "--seconds", str(args.seconds)]
+    layout = os.path.join(args.tmp, "bench_layout.csv")
+    gen = os.path.join(args.bin, "traffic_gen")
+    subprocess.run([gen] + scene + ["--write-layout", layout, "--target", "127.0.0.1:1", "--speed", "0"],
+                   check=True, stdout=subprocess.DEVNULL)
+
+    solver = subprocess.Popen([os.path.join(args.bin, "raw_solver"), "--layout", layout, "--udp", str(port),
+                               "--workers", str(args.workers), "--idle-exit", "1500"],
+                              stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+    time.sleep(0.3)
+    gens = [subprocess.Popen([gen] + scene + ["--zones", str(zones), "--zone", str(k), "--send", args.send,
+                                              "--target", "127.0.0.1:%d" % port],
+                             stdout=subprocess.DEVNULL)
+            for k in range(zones)]
+    for g in gens:
+        g.wait()
+    out, _ = solver.communicate()
+
+    sequences = args.tags_per_zone * zones * args.seconds * 10
+    return {
+        "zones": zones,
+        "tags": args.tags_per_zone * zones,
+        "sequences": sequences,
+        "fixes": summary_value(out, r"fixes (\d+) \("),
+        "rate": summary_value(out, r"fixes \d+ \((\d+)/s\)"),
+        "duplicates": summary_value(out, r"duplicados (\d+)"),
+        "handovers": summary_value(out, r"handovers (\d+) por anclas") + summary_value(out, r"(\d+) por dueño callado"),
+        "lost": sum(int(x) for x in re.findall(r"^[0-9a-f]{8}\s+\d+\s+(\d+)", out, re.M)),
+        "cpu_us": summary_value(out, r"\(([\d.]+) us por fix\)", float),
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description="agregador vs número de concentradores")
+    ap.add_argument("--bin", default=".", help="carpeta con raw_solver y traffic_gen")
+    ap.add_argument("--zones", type=int, nargs="+", default=[1, 2, 3, 4])
+    ap.add_argument("--tags-per-zone", type=int, default=100)
+    ap.add_argument("--seconds", type=int, default=15)
+    ap.add_argument("--workers", type=int, default=4)
+    ap.add_argument("--send", choices=["raw", "fixes"], default="raw")
+    ap.add_argument("--port", type=int, default=9770)
+    ap.add_argument("--tmp", default="/tmp")
+    args = ap.parse_args()
+
+    print("zonas  tags  secuencias   fixes  fixes/s  %   duplicados  handovers  batches perdidos  us/fix")
+    for i, zones in enumerate(args.zones):
+        r = run(args, zones, args.port + i)
+        pct = 100.0 * r["fixes"] / r["sequences"] if r["sequences"] else 0.0
+        print("%5d %5d %11d %7d %8d %4.1f %11d %10d %17d %7.1f" % (
+            r["zones"], r["tags"], r["sequences"], r["fixes"], r["rate"], pct, r["duplicates"],
+            r["handovers"], r["lost"], r["cpu_us"]))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
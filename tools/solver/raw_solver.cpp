@@ -0,0 +1,527 @@
+// ========================================================================
+// raw_solver.cpp
+// Servicio en Linux para el modo raw-forward del concentrador: recibe los
+// batches de frames ESP-NOW crudos (include/RawBatch.h) por UDP o TCP, los
+// decodifica con decode_anchor_frame y resuelve con el mismo
+// PositioningManager del firmware, repartido en un pool de workers.
+// - Cada worker tiene su propio PositioningManager y atiende los tags que
+//   le asigna shardOf() (hash de Fibonacci del tag_uid): todos los reportes
+//   de una secuencia caen en el mismo worker y no hay estado compartido
+//   entre workers.
+// - El hilo receptor decodifica y reparte; cada worker tiene una cola
+//   acotada (--queue-max) y cuenta lo que descarta.
+// - Por fuente (concentrador) cuenta batches perdidos (huecos en
+//   batch_seq) y los frames que el propio concentrador descartó.
+// - rx_ms se lleva al reloj del host: ahora - (sent_ms - rx_ms).
+// - Agregador de zonas: con un concentrador por zona, los reportes de un
+//   mismo (tag, seq) llegados por distintas fuentes caen en el mismo
+//   worker y se resuelven con la unión de las anclas (un ancla de borde
+//   que oyen dos concentradores se descarta como duplicado). También
+//   acepta batches de fixes ya resueltos por concentradores en modo local.
+//   ZoneArbiter decide el dueño de cada tag y publica cada (tag, seq) una vez.
+// - Las tablas del manager se agrandan con -D (MAX_TAGS, por worker; hasta
+//   255) porque el host no tiene los límites de memoria del ESP32.
+//
+// Compilar (desde la raíz del repo):
+//   g++ -std=gnu++17 -O2 -pthread -DPERF_PROBES=0 -DSHIM_WALL_CLOCK
+//       -DMAX_TAGS=255 -DMAX_PENDING_SEQUENCES=1024 -Itools/sim/shim -Iinclude -Ilib/ArduinoJson-6.21.5/src
+//       tools/solver/raw_solver.cpp src/PositioningManager.cpp src/TimeBase.cpp src/AsyncLog.cpp -o raw_solver
+// Uso:
+//   ./raw_solver --layout anclas.csv [--udp 9750 | --tcp 9750] [--workers N]
+//                [--min-anchors 4] [--queue-max 65536] [--fixes fixes.csv]
+//                [--seconds S] [--idle-exit MS]
+// anclas.csv: una línea "saddr_hex,x,y,z" por ancla (traffic_gen la genera
+// con --write-layout).
+// ========================================================================
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PositioningManager.h"
+#include "AnchorFrame.h"
+#include "RawBatch.h"
+#include "StreamCodec.h"
+#include "AsyncLog.h"
+#include "ZoneArbiter.h"
+
+struct Options {
+    bool     tcp = false;
+    uint16_t port = RAW_FORWARD_PORT;
+    int      workers = 0;             // 0 = núcleos del host
+    int      min_anchors = 4;
+    size_t   queue_max = 65536;       // ítems por worker
+    int      seconds = 0;             // 0 = hasta SIGINT
+    int      idle_exit_ms = 0;        // sale tras este silencio (si ya recibió algo)
+    std::string layout;
+    std::string fixes;
+};
+
+enum WorkKind : uint8_t { WORK_REPORT, WORK_TELEMETRY, WORK_FIX };
+
+// Un reporte, un bloque del tag o un fix de zona, ya decodificado y en el
+// reloj del host
+struct WorkItem {
+    WorkKind kind;
+    uint32_t zone;                    // fuente (concentrador) que lo entregó
+    uint32_t rx_ms;
+    DecodedAnchorReport_t report;
+    TagTelemetryRecord_t  telemetry;
+    TagFix   fix;
+};
+
+struct Worker {
+    std::unique_ptr<PositioningManager> manager;
+    ZoneArbiter arbiter;               // dueño de los tags de este worker
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<WorkItem> queue;
+    size_t   high_water = 0;
+    uint64_t dropped = 0;              // cola llena (bajo mutex)
+    std::atomic<uint64_t> fixes{0};        // publicados (una vez por tag, seq)
+    std::atomic<uint64_t> processed{0};
+};
+
+// Estado de cada concentrador que envía
+struct SourceStats {
+    bool     seen = false;
+    uint32_t next_seq = 0;
+    uint64_t batches = 0;
+    uint64_t lost = 0;                 // huecos en batch_seq
+    uint64_t reordered = 0;            // batch_seq anterior al esperado
+    uint32_t device_dropped = 0;       // último "dropped" informado
+    uint64_t frames = 0;
+    uint64_t fixes = 0;                // fixes recibidos ya resueltos (modo local)
+};
+
+struct Totals {
+    uint64_t bytes = 0;
+    uint64_t batches = 0;
+    uint64_t bad_batches = 0;          // cabecera inválida o registros truncados
+    uint64_t frames = 0;
+    uint64_t frames_unknown = 0;       // ni v1 ni v2
+    uint64_t reports = 0;
+    uint64_t telemetry = 0;
+    uint64_t zone_fixes = 0;
+};
+
+static std::atomic<bool> g_stop{false};
+static void onSignal(int) { g_stop = true; }
+
+class Solver {
+public:
+    explicit Solver(const Options& opt) : _opt(opt) {}
+
+    bool loadLayout() {
+        FILE* f = fopen(_opt.layout.c_str(), "r");
+        if (!f) { perror(_opt.layout.c_str()); return false; }
+        char line[128];
+        while (fgets(line, sizeof(line), f)) {
+            unsigned saddr;
+            float x, y, z;
+            if (line[0] == '#' || sscanf(line, "%x,%f,%f,%f", &saddr, &x, &y, &z) != 4) continue;
+            _layout.push_back({ (uint16_t)saddr, { x, y, z } });
+        }
+        fclose(f);
+        if (_layout.empty()) fprintf(stderr, "%s: sin anclas\n", _opt.layout.c_str());
+        return !_layout.empty();
+    }
+
+    void start() {
+        if (!_opt.fixes.empty()) _fixOut = fopen(_opt.fixes.c_str(), "w");
+        if (_fixOut) fprintf(_fixOut, "tag_uid,seq,x,y,z,rms,anchors,t_ms,owner,origin\n");
+        for (int i = 0; i < _opt.workers; i++) _workers.emplace_back(new Worker());
+        for (auto& w : _workers) {
+            w->manager.reset(new PositioningManager(_opt.min_anchors));
+            for (const auto& a : _layout) w->manager->setAnchorPosition(a.first, a.second.x, a.second.y, a.second.z);
+            Worker* wp = w.get();
+            w->manager->addFixListener([this, wp](const TagFix& fix) {
+                if (wp->arbiter.offerMerged(fix)) publish(*wp, fix, "merged");
+            });
+            w->thread = std::thread([this, wp]() { runWorker(*wp); });
+        }
+    }
+
+    void stop() {
+        _running = false;
+        for (auto& w : _workers) {
+            w->cv.notify_all();
+            w->thread.join();
+        }
+        if (_fixOut) fclose(_fixOut);
+    }
+
+    // Hilo receptor: un batch completo (datagrama o tramo del stream TCP)
+    void onBatch(const uint8_t* data, size_t len) {
+        const uint32_t now = millis();
+        _totals.bytes += len;
+        if (raw_batch_length(data, len) == 0) {
+            _totals.bad_batches++;
+            return;
+        }
+        RawBatchHeader_t header;
+        memcpy(&header, data, sizeof(header));
+        const uint32_t zone = header.source;
+        RawBatchInfo info;
+        if (header.magic == FIX_BATCH_MAGIC) {
+            info = decode_fix_batch<BinFixRecord_t>(data, len, [&](const BinFixRecord_t& r) {
+                WorkItem item = {};
+                item.kind  = WORK_FIX;
+                item.zone  = zone;
+                item.rx_ms = now;
+                item.fix.tag_uid = r.tag_uid;
+                item.fix.seq     = r.seq;
+                item.fix.pos     = { r.x_mm / 1000.0f, r.y_mm / 1000.0f, r.z_mm / 1000.0f };
+                item.fix.rms     = r.rms_mm / 1000.0f;
+                item.fix.anchors = r.anchors;
+                item.fix.is3D    = (r.flags & STREAM_FLAG_3D) != 0;
+                item.fix.t_ms    = now - (header.sent_ms - r.t_ms);
+                _totals.zone_fixes++;
+                _sources[zone].fixes++;
+                dispatch(r.tag_uid, std::move(item));
+            });
+        } else {
+            info = decode_raw_batch(data, len, [&](const RawFrameRecord_t& r, const uint8_t* frame) {
+                _totals.frames++;
+                const uint32_t rx_ms = now - (header.sent_ms - r.rx_ms);
+                const AnchorFrameInfo fi = decode_anchor_frame(frame, r.len, [&](DecodedAnchorReport_t& report) {
+                    report.rx_ms   = rx_ms;
+                    report.rx_rssi = r.rssi;
+                    _totals.reports++;
+                    WorkItem item = {};
+                    item.kind   = WORK_REPORT;
+                    item.zone   = zone;
+                    item.rx_ms  = rx_ms;
+                    item.report = report;
+                    dispatch(report.tag_uid, std::move(item));
+                }, [&](const TagTelemetryRecord_t& telemetry) {
+                    _totals.telemetry++;
+                    WorkItem item = {};
+                    item.kind      = WORK_TELEMETRY;
+                    item.zone      = zone;
+                    item.rx_ms     = rx_ms;
+                    item.telemetry = telemetry;
+                    dispatch(telemetry.tag_uid, std::move(item));
+                });
+                if (fi.version == 0) _totals.frames_unknown++;
+            });
+            _sources[zone].frames += info.header.count;
+        }
+        if (info.truncated) _totals.bad_batches++;
+        _totals.batches++;
+
+        SourceStats& src = _sources[info.header.source];
+        const int32_t gap = (int32_t)(info.header.batch_seq - src.next_seq);
+        if (src.seen && gap > 0) src.lost += (uint32_t)gap;
+        if (src.seen && gap < 0) src.reordered++;
+        if (!src.seen || gap >= 0) src.next_seq = info.header.batch_seq + 1;
+        src.seen = true;
+        src.batches++;
+        src.device_dropped = info.header.dropped;
+    }
+
+    void printProgress(double elapsed_s) {
+        uint64_t fixes = 0;
+        for (auto& w : _workers) fixes += w->fixes;
+        uint64_t lost = 0;
+        for (const auto& kv : _sources) lost += kv.second.lost;
+        fprintf(stderr, "[%6.1f s] batches %llu  frames %llu  reportes %llu  fixes %llu  perdidos %llu\n", elapsed_s,
+                (unsigned long long)_totals.batches, (unsigned long long)_totals.frames,
+                (unsigned long long)_totals.reports, (unsigned long long)fixes, (unsigned long long)lost);
+    }
+
+    void printSummary(double elapsed_s) const {
+        uint64_t fixes = 0, dropped = 0;
+        ManagerStats sum;
+        ZoneArbiterStats zones;
+        std::map<uint32_t, uint64_t> owned;   // zona -> tags de los que es dueña
+        printf("worker  reportes     fixes  cola máx  descartes\n");
+        for (size_t i = 0; i < _workers.size(); i++) {
+            const Worker& w = *_workers[i];
+            printf("%6zu %9llu %9llu %9zu %10llu\n", i, (unsigned long long)w.processed.load(),
+                   (unsigned long long)w.fixes.load(), w.high_water, (unsigned long long)w.dropped);
+            fixes += w.fixes;
+            dropped += w.dropped;
+            const ManagerStats& st = w.manager->stats();
+            sum.sequences_completed += st.sequences_completed;
+            sum.sequences_expired   += st.sequences_expired;
+            sum.reports_duplicate   += st.reports_duplicate;
+            sum.reports_stale       += st.reports_stale;
+            sum.solves_ok           += st.solves_ok;
+            const ZoneArbiterStats& zs = w.arbiter.stats();
+            zones.handovers         += zs.handovers;
+            zones.handovers_timeout += zs.handovers_timeout;
+            zones.merged_published  += zs.merged_published;
+            zones.zone_published    += zs.zone_published;
+            zones.zone_dropped      += zs.zone_dropped;
+            zones.merged_late       += zs.merged_late;
+            w.arbiter.forEachOwner([&](uint32_t, uint32_t zone) { owned[zone]++; });
+        }
+        printf("\nfuente       batches   perdidos  desordenados  frames   fixes  tags  descartes en el concentrador\n");
+        for (const auto& kv : _sources) {
+            const SourceStats& s = kv.second;
+            const auto o = owned.find(kv.first);
+            printf("%08lx %10llu %10llu %13llu %7llu %7llu %5llu %10lu\n", (unsigned long)kv.first,
+                   (unsigned long long)s.batches, (unsigned long long)s.lost, (unsigned long long)s.reordered,
+                   (unsigned long long)s.frames, (unsigned long long)s.fixes,
+                   (unsigned long long)(o != owned.end() ? o->second : 0), (unsigned long)s.device_dropped);
+        }
+        printf("\n%.1f s: %llu bytes, %llu batches (%llu inválidos), %llu frames (%llu desconocidos), %llu reportes,"
+               " %llu bloques de tag\n",
+               elapsed_s, (unsigned long long)_totals.bytes, (unsigned long long)_totals.batches,
+               (unsigned long long)_totals.bad_batches, (unsigned long long)_totals.frames,
+               (unsigned long long)_totals.frames_unknown, (unsigned long long)_totals.reports,
+               (unsigned long long)_totals.telemetry);
+        printf("fixes %llu (%.0f/s), secuencias completas %lu, expiradas %lu, duplicados %lu, stale %lu,"
+               " descartes por cola llena %llu\n",
+               (unsigned long long)fixes, elapsed_s > 0 ? fixes / elapsed_s : 0.0,
+               (unsigned long)sum.sequences_completed, (unsigned long)sum.sequences_expired,
+               (unsigned long)sum.reports_duplicate, (unsigned long)sum.reports_stale, (unsigned long long)dropped);
+        // CPU de todo el proceso (receptor + workers): techo de fixes/s por núcleo
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        const double cpu_s = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+        printf("CPU %.2f s (%.1f us por fix)\n", cpu_s, fixes ? cpu_s * 1e6 / fixes : 0.0);
+        if (_sources.size() > 1 || zones.zone_published || zones.zone_dropped) {
+            printf("zonas: %llu fixes resueltos con la unión de anclas, %llu de concentradores dueños,"
+                   " %llu descartados (no dueño o ya publicado), %llu resueltos aquí tras el de la zona;"
+                   " handovers %llu por anclas, %llu por dueño callado\n",
+                   (unsigned long long)zones.merged_published, (unsigned long long)zones.zone_published,
+                   (unsigned long long)zones.zone_dropped, (unsigned long long)zones.merged_late, (unsigned long long)zones.handovers,
+                   (unsigned long long)zones.handovers_timeout);
+        }
+    }
+
+private:
+    // Fibonacci hashing: tag_uid consecutivos se reparten parejo
+    size_t shardOf(uint32_t tag_uid) const {
+        return (size_t)(((uint64_t)(tag_uid * 2654435761u) * _workers.size()) >> 32);
+    }
+
+    void dispatch(uint32_t tag_uid, WorkItem&& item) {
+        Worker& w = *_workers[shardOf(tag_uid)];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (w.queue.size() >= _opt.queue_max) {
+                w.dropped++;
+                return;
+            }
+            w.queue.push_back(std::move(item));
+            if (w.queue.size() > w.high_water) w.high_water = w.queue.size();
+        }
+        w.cv.notify_one();
+    }
+
+    // Worker: fix elegido por el árbitro
+    void publish(Worker& w, const TagFix& fix, const char* origin) {
+        w.fixes++;
+        if (!_fixOut) return;
+        const uint32_t owner = w.arbiter.owner(fix.tag_uid);
+        std::lock_guard<std::mutex> lock(_fixMutex);
+        fprintf(_fixOut, "%lx,%u,%.3f,%.3f,%.3f,%.3f,%u,%lu,%08lx,%s\n", (unsigned long)fix.tag_uid, fix.seq,
+                fix.pos.x, fix.pos.y, fix.pos.z, fix.rms, fix.anchors, (unsigned long)fix.t_ms,
+                (unsigned long)owner, origin);
+    }
+
+    // Toma la cola entera de una vez: el receptor nunca espera al solver
+    void runWorker(Worker& w) {
+        std::vector<WorkItem> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(w.mutex);
+                w.cv.wait_for(lock, std::chrono::milliseconds(5), [&]() { return !w.queue.empty() || !_running; });
+                if (w.queue.empty() && !_running) break;
+                batch.swap(w.queue);
+            }
+            for (const WorkItem& item : batch) {
+                switch (item.kind) {
+                    case WORK_REPORT:
+                        w.arbiter.note(item.report.tag_uid, item.report.seq, item.zone, 1, item.rx_ms);
+                        w.manager->addAnchorReport(item.report);
+                        break;
+                    case WORK_TELEMETRY:
+                        w.manager->addTagTelemetry(item.telemetry, item.rx_ms);
+                        break;
+                    case WORK_FIX:
+                        if (w.arbiter.offerZone(item.zone, item.fix, item.rx_ms)) publish(w, item.fix, "zone");
+                        break;
+                }
+            }
+            w.processed += batch.size();
+            batch.clear();
+            w.manager->poll();
+        }
+    }
+
+    const Options& _opt;
+    std::vector<std::pair<uint16_t, Point>> _layout;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<bool> _running{true};
+    std::map<uint32_t, SourceStats> _sources;
+    Totals   _totals;
+    FILE*    _fixOut = nullptr;
+    std::mutex _fixMutex;
+};
+
+// ------------------------------------------------------------------------
+// Transporte
+// ------------------------------------------------------------------------
+static int listenSocket(const Options& opt) {
+    const int fd = socket(AF_INET, opt.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (!opt.tcp) {
+        // Ráfagas de varios concentradores: que el kernel absorba la espera
+        const int rcvbuf = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(opt.port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || (opt.tcp && listen(fd, 16) < 0)) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Stream TCP de un concentrador: acumula hasta tener batches completos
+struct TcpPeer {
+    int fd;
+    std::vector<uint8_t> buf;
+};
+
+// Entrega los batches completos del buffer; false si el stream se desincronizó
+static bool drainStream(Solver& solver, TcpPeer& peer) {
+    size_t off = 0;
+    while (peer.buf.size() - off >= sizeof(RawBatchHeader_t)) {
+        const size_t len = raw_batch_length(peer.buf.data() + off, peer.buf.size() - off);
+        if (len == 0) return false;
+        if (peer.buf.size() - off < len) break;
+        solver.onBatch(peer.buf.data() + off, len);
+        off += len;
+    }
+    peer.buf.erase(peer.buf.begin(), peer.buf.begin() + off);
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "uso: raw_solver --layout FILE [--udp PORT | --tcp PORT] [--workers N] [--min-anchors N]\n"
+            "                [--queue-max N] [--fixes FILE] [--seconds S] [--idle-exit MS]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!v) usage();
+        if (!strcmp(a, "--udp")) { opt.tcp = false; opt.port = (uint16_t)atoi(v); }
+        else if (!strcmp(a, "--tcp")) { opt.tcp = true; opt.port = (uint16_t)atoi(v); }
+        else if (!strcmp(a, "--workers")) opt.workers = atoi(v);
+        else if (!strcmp(a, "--min-anchors")) opt.min_anchors = atoi(v);
+        else if (!strcmp(a, "--queue-max")) opt.queue_max = (size_t)atol(v);
+        else if (!strcmp(a, "--layout")) opt.layout = v;
+        else if (!strcmp(a, "--fixes")) opt.fixes = v;
+        else if (!strcmp(a, "--seconds")) opt.seconds = atoi(v);
+        else if (!strcmp(a, "--idle-exit")) opt.idle_exit_ms = atoi(v);
+        else usage();
+        i++;
+    }
+    if (opt.layout.empty()) usage();
+    if (opt.workers <= 0) opt.workers = (int)std::max(1u, std::thread::hardware_concurrency());
+    asyncLog.setLevel(LOG_LEVEL_OFF);
+
+    Solver solver(opt);
+    if (!solver.loadLayout()) return 1;
+    const int lfd = listenSocket(opt);
+    if (lfd < 0) return 1;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+    solver.start();
+    fprintf(stderr, "raw_solver: %s %u, %d workers\n", opt.tcp ? "tcp" : "udp", opt.port, opt.workers);
+
+    std::vector<TcpPeer> peers;
+    std::vector<uint8_t> buf(65536);
+    const uint32_t t0 = millis();
+    uint32_t firstMs = 0, lastRxMs = 0, lastProgressMs = t0;
+    while (!g_stop) {
+        std::vector<pollfd> fds;
+        fds.push_back({ lfd, POLLIN, 0 });
+        for (const TcpPeer& p : peers) fds.push_back({ p.fd, POLLIN, 0 });
+        poll(fds.data(), fds.size(), 100);
+
+        bool received = false;
+        if (fds[0].revents & POLLIN) {
+            if (opt.tcp) {
+                const int cfd = accept(lfd, nullptr, nullptr);
+                if (cfd >= 0) peers.push_back({ cfd, {} });
+            } else {
+                // Vacía la cola del socket antes de volver a poll()
+                ssize_t n;
+                while ((n = recv(lfd, buf.data(), buf.size(), MSG_DONTWAIT)) > 0) {
+                    solver.onBatch(buf.data(), (size_t)n);
+                    received = true;
+                }
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            TcpPeer& peer = peers[i - 1];
+            const ssize_t n = recv(peer.fd, buf.data(), buf.size(), 0);
+            if (n > 0) {
+                peer.buf.insert(peer.buf.end(), buf.data(), buf.data() + n);
+                received = true;
+                if (drainStream(solver, peer)) continue;
+                fprintf(stderr, "raw_solver: stream TCP desincronizado, se cierra\n");
+            }
+            close(peer.fd);
+            peer.fd = -1;
+        }
+        peers.erase(std::remove_if(peers.begin(), peers.end(), [](const TcpPeer& p) { return p.fd < 0; }),
+                    peers.end());
+
+        const uint32_t now = millis();
+        if (received) {
+            if (!firstMs) firstMs = now;
+            lastRxMs = now;
+        }
+        if (now - lastProgressMs >= 1000) {
+            lastProgressMs = now;
+            solver.printProgress((now - t0) / 1000.0);
+        }
+        if (opt.seconds > 0 && now - t0 >= (uint32_t)opt.seconds * 1000) break;
+        if (opt.idle_exit_ms > 0 && firstMs && now - lastRxMs >= (uint32_t)opt.idle_exit_ms) break;
+    }
+
+    for (const TcpPeer& p : peers) close(p.fd);
+    close(lfd);
+    solver.stop();
+    // El ritmo se mide desde el primer batch hasta el último
+    const uint32_t active = firstMs ? lastRxMs - firstMs : 0;
+    solver.printSummary(active / 1000.0);
+    return 0;
+}
@@ -0,0 +1,337 @@
+// ============================================================================
+// Panel del concentrador.
+// - Tablas con filas indexadas por clave (ancla / tag): cada actualización solo
+//   toca las celdas cuyo texto cambió, sin reconstruir el HTML.
+// - Plano de planta en canvas con anclas (/layout) y la última posición de
+//   cada tag; se redibuja en requestAnimationFrame solo si hubo cambios.
+// - Las dos fuentes de datos (sondeo /data?since= y stream /ws) alimentan las
+//   mismas funciones applyAnchor() / applyFix().
+// ============================================================================
+
+const hex = (v) => '0x' + v.toString(16).toUpperCase();
+
+// Tabla con filas indexadas por clave. columns: [{ key, fmt }]
+class KeyedTable {
+    constructor(selector, columns, emptyText) {
+        this.body = document.querySelector(selector + ' tbody');
+        this.columns = columns;
+        this.rows = new Map();   // clave -> { tr, cells[], texts[] }
+        this.body.innerHTML = `<tr class="empty"><td colspan="${columns.length}" style="text-align:center;">${emptyText}</td></tr>`;
+    }
+
+    update(key, data) {
+        let row = this.rows.get(key);
+        if (!row) row = this.insert(key);
+        this.columns.forEach((col, i) => {
+            if (data[col.key] === undefined) return;
+            const text = col.fmt ? col.fmt(data[col.key]) : String(data[col.key]);
+            if (row.texts[i] !== text) {
+                row.texts[i] = text;
+                row.cells[i].textContent = text;
+            }
+        });
+        return row.tr;
+    }
+
+    // Inserta la fila manteniendo el orden por clave
+    insert(key) {
+        const empty = this.body.querySelector('tr.empty');
+        if (empty) empty.remove();
+        const tr = document.createElement('tr');
+        const cells = this.columns.map(() => tr.appendChild(document.createElement('td')));
+        let before = null;
+        for (const [k, r] of this.rows) {
+            if (k > key && (!before || k < before.key)) before = { key: k, tr: r.tr };
+        }
+        this.body.insertBefore(tr, before ? before.tr : null);
+        const row = { tr, cells, texts: [] };
+        this.rows.set(key, row);
+        return row;
+    }
+
+    clear() {
+        for (const r of this.rows.values()) r.tr.remove();
+        this.rows.clear();
+    }
+}
+
+const anchorTable = new KeyedTable('#anchor-table', [
+    { key: 'anchor_saddr', fmt: hex },
+    { key: 'tag_uid', fmt: hex },
+    { key: 'seq' },
+    { key: 'range_m', fmt: v => v.toFixed(3) },
+    { key: 'temp', fmt: v => v.toFixed(2) },
+    { key: 'aSQ', fmt: v => v.toFixed(3) },
+    { key: 'rxpacc' },
+    { key: 'std_noise' },
+    { key: 'cir_pwr' },
+    { key: 'rate_hz', fmt: v => v.toFixed(1) },
+    { key: 'participation', fmt: v => Math.round(v * 100) + '%' },
+    { key: 'range_std', fmt: v => v.toFixed(3) },
+    { key: 'rssi', fmt: v => v ? v.toFixed(0) : '-' },
+], 'Esperando datos...');
+
+const tagTable = new KeyedTable('#tag-table', [
+    { key: 'tag_uid', fmt: hex },
+    { key: 'seq' },
+    { key: 'x', fmt: v => v.toFixed(2) },
+    { key: 'y', fmt: v => v.toFixed(2) },
+    { key: 'z', fmt: v => v.toFixed(2) },
+    { key: 'rms', fmt: v => v.toFixed(3) },
+    { key: 'anchors' },
+], 'Sin posiciones...');
+
+// --- Plano de planta ---------------------------------------------------------
+// Vista 2D (planta) o 3D (isométrica). Cada tag muestra su estela reciente
+// (recibida una vez de /trails y prolongada con los fixes del stream) y un
+// marcador que se interpola hacia el último fix. La animación corre en
+// requestAnimationFrame solo mientras algún marcador se está moviendo; no
+// hay peticiones por cuadro.
+const floor = {
+    canvas: document.getElementById('floor-plan'),
+    view: '2d',
+    trailLength: 32,
+    anchors: [],          // [{ saddr, x, y, z }] desde /layout
+    tags: new Map(),      // tag_uid -> { target, shown, trail: [{x,y,z}] }
+    scheduled: false,
+    lastFrame: 0,
+};
+
+function requestDraw() {
+    if (floor.scheduled) return;
+    floor.scheduled = true;
+    requestAnimationFrame(drawFloor);
+}
+
+function tagColor(uid) {
+    return `hsl(${(uid * 137) % 360}, 70%, 45%)`;
+}
+
+function floorTag(uid) {
+    let t = floor.tags.get(uid);
+    if (!t) {
+        t = { target: null, shown: null, trail: [] };
+        floor.tags.set(uid, t);
+    }
+    return t;
+}
+
+function pushTrail(t, p) {
+    const last = t.trail[t.trail.length - 1];
+    if (last && last.x === p.x && last.y === p.y && last.z === p.z) return;
+    t.trail.push(p);
+    if (t.trail.length > floor.trailLength) t.trail.shift();
+}
+
+function floorFix(f) {
+    const t = floorTag(f.tag_uid);
+    const p = { x: f.x, y: f.y, z: f.z };
+    t.target = p;
+    if (!t.shown) t.shown = { ...p };
+    pushTrail(t, p);
+    requestDraw();
+}
+
+// Proyección a coordenadas de pantalla (sin escalar)
+function project(p) {
+    if (floor.view === '2d') return { u: p.x, v: p.y };
+    const c = Math.cos(Math.PI / 6), s = Math.sin(Math.PI / 6);
+    return { u: (p.x - p.y) * c, v: (p.x + p.y) * s + (p.z || 0) };
+}
+
+function drawFloor(now) {
+    floor.scheduled = false;
+    const dt = floor.lastFrame ? Math.min(now - floor.lastFrame, 100) : 16;
+    floor.lastFrame = now;
+
+    // Interpolación de marcadores (constante de tiempo ~120 ms)
+    let moving = false;
+    const k = 1 - Math.exp(-dt / 120);
+    for (const t of floor.tags.values()) {
+        if (!t.target) continue;
+        for (const axis of ['x', 'y', 'z']) {
+            const d = t.target[axis] - t.shown[axis];
+            if (Math.abs(d) > 0.001) { t.shown[axis] += d * k; moving = true; }
+            else t.shown[axis] = t.target[axis];
+        }
+    }
+
+    const c = floor.canvas;
+    const dpr = window.devicePixelRatio || 1;
+    const w = c.clientWidth, h = c.clientHeight;
+    if (c.width !== w * dpr || c.height !== h * dpr) { c.width = w * dpr; c.height = h * dpr; }
+    const ctx = c.getContext('2d');
+    ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+    ctx.clearRect(0, 0, w, h);
+
+    // Extensión: anclas (y su proyección al piso) + estelas, con margen
+    const pts = [];
+    for (const a of floor.anchors) { pts.push(project(a)); pts.push(project({ x: a.x, y: a.y, z: 0 })); }
+    for (const t of floor.tags.values()) for (const p of t.trail) pts.push(project(p));
+    if (pts.length === 0) return;
+    let minU = Infinity, minV = Infinity, maxU = -Infinity, maxV = -Infinity;
+    for (const p of pts) { minU = Math.min(minU, p.u); maxU = Math.max(maxU, p.u); minV = Math.min(minV, p.v); maxV = Math.max(maxV, p.v); }
+    minU -= 0.5; minV -= 0.5; maxU += 0.5; maxV += 0.5;
+    const scale = Math.min((w - 20) / (maxU - minU), (h - 20) / (maxV - minV));
+    const toScreen = (p) => { const q = project(p); return [10 + (q.u - minU) * scale, h - 10 - (q.v - minV) * scale]; };
+
+    ctx.font = '11px sans-serif';
+    ctx.lineWidth = 1;
+    for (const a of floor.anchors) {
+        const [x, y] = toScreen(a);
+        if (floor.view === '3d') {
+            const [fx, fy] = toScreen({ x: a.x, y: a.y, z: 0 });
+            ctx.strokeStyle = '#9bb8d8';
+            ctx.beginPath(); ctx.moveTo(fx, fy); ctx.lineTo(x, y); ctx.stroke();
+        }
+        ctx.fillStyle = '#0056b3';
+        ctx.fillRect(x - 5, y - 5, 10, 10);
+        ctx.fillText(hex(a.saddr), x + 7, y - 7);
+    }
+
+    for (const [uid, t] of floor.tags) {
+        const color = tagColor(uid);
+        // Estela con opacidad creciente hacia el punto más reciente
+        ctx.strokeStyle = color;
+        ctx.lineWidth = 2;
+        for (let i = 1; i < t.trail.length; i++) {
+            const [x0, y0] = toScreen(t.trail[i - 1]);
+            const [x1, y1] = toScreen(t.trail[i]);
+            ctx.globalAlpha = 0.1 + 0.6 * (i / t.trail.length);
+            ctx.beginPath(); ctx.moveTo(x0, y0); ctx.lineTo(x1, y1); ctx.stroke();
+        }
+        ctx.globalAlpha = 1;
+        if (!t.shown) continue;
+        const [x, y] = toScreen(t.shown);
+        ctx.fillStyle = color;
+        ctx.beginPath();
+        ctx.arc(x, y, 6, 0, 2 * Math.PI);
+        ctx.fill();
+        ctx.fillText(hex(uid), x + 8, y + 4);
+    }
+
+    if (moving) requestDraw();
+    else floor.lastFrame = 0;
+}
+
+function loadTrails() {
+    fetch('/trails').then(r => r.json()).then(data => {
+        floor.trailLength = data.length;
+        for (const id in data.tags) {
+            const t = floorTag(parseInt(id, 16));
+            t.trail = data.tags[id].map(([x, y, z]) => ({ x: x / 100, y: y / 100, z: z / 100 }));
+            const last = t.trail[t.trail.length - 1];
+            if (last && !t.target) { t.target = { ...last }; t.shown = { ...last }; }
+        }
+        requestDraw();
+    }).catch(console.error);
+}
+
+document.getElementById('view-toggle').addEventListener('click', (e) => {
+    floor.view = (floor.view === '2d') ? '3d' : '2d';
+    e.target.textContent = (floor.view === '2d') ? 'Vista 3D' : 'Vista 2D';
+    requestDraw();
+});
+
+window.addEventListener('resize', requestDraw);
+
+// --- Aplicación de datos (común al sondeo y al stream) ------------------------
+function applyAnchor(a) {
+    const tr = anchorTable.update(a.anchor_saddr, a);
+    if (a.online !== undefined) tr.classList.toggle('stale', !a.online);
+}
+
+function applyFix(f) {
+    tagTable.update(f.tag_uid, f);
+    floorFix(f);
+    document.getElementById('tag-position').textContent =
+        `Tag ${hex(f.tag_uid)} - X: ${f.x.toFixed(2)}, Y: ${f.y.toFixed(2)}, Z: ${f.z.toFixed(2)}`;
+}
+
+fetch('/layout').then(r => r.json()).then(layout => {
+    floor.anchors = layout.anchors;
+    requestDraw();
+}).catch(console.error);
+loadTrails();
+
+// --- Stream binario (/ws?fmt=struct|msgpack): posición en vivo sin esperar al sondeo ---
+function decodeMsgPack(view) {
+    let o = 0;
+    function read() {
+        const b = view.getUint8(o++);
+        if (b <= 0x7f) return b;
+        if (b >= 0xe0) return b - 0x100;
+        if ((b & 0xf0) === 0x90) { const a = []; for (let i = 0; i < (b & 0x0f); i++) a.push(read()); return a; }
+        switch (b) {
+            case 0xc0: return null;
+            case 0xc2: return false;
+            case 0xc3: return true;
+            case 0xca: { const v = view.getFloat32(o); o += 4; return v; }
+            case 0xcb: { const v = view.getFloat64(o); o += 8; return v; }
+            case 0xcc: return view.getUint8(o++);
+            case 0xcd: { const v = view.getUint16(o); o += 2; return v; }
+            case 0xce: { const v = view.getUint32(o); o += 4; return v; }
+            case 0xd0: return view.getInt8(o++);
+            case 0xd1: { const v = view.getInt16(o); o += 2; return v; }
+            case 0xd2: { const v = view.getInt32(o); o += 4; return v; }
+        }
+        throw new Error('msgpack: tipo 0x' + b.toString(16) + ' no soportado');
+    }
+    return read();
+}
+
+function decodeEvent(buf, fmt) {
+    const v = new DataView(buf);
+    if (fmt === 'msgpack') {
+        const a = decodeMsgPack(v);
+        if (a[0] === 1) return { type: 'fix', tag_uid: a[1], seq: a[2], x: a[3] / 1000, y: a[4] / 1000, z: a[5] / 1000, rms: a[6] / 1000, anchors: a[7], is3D: !!(a[8] & 1), t_ms: a[9] };
+        return { type: 'anchor', anchor_saddr: a[1], online: !!(a[2] & 1), tag_uid: a[3], seq: a[4], range_m: a[5] / 1000, std_noise: a[6], cir_pwr: a[7], age_ms: a[8] };
+    }
+    // struct empaquetado little-endian (ver StreamCodec.h)
+    if (v.getUint8(0) === 1) {
+        return { type: 'fix', is3D: !!(v.getUint8(1) & 1), tag_uid: v.getUint32(2, true), seq: v.getUint16(6, true),
+                 x: v.getInt32(8, true) / 1000, y: v.getInt32(12, true) / 1000, z: v.getInt32(16, true) / 1000,
+                 rms: v.getUint16(20, true) / 1000, anchors: v.getUint8(22), t_ms: v.getUint32(23, true) };
+    }
+    return { type: 'anchor', online: !!(v.getUint8(1) & 1), anchor_saddr: v.getUint16(2, true), tag_uid: v.getUint32(4, true),
+             seq: v.getUint16(8, true), range_m: v.getUint32(10, true) / 1000, std_noise: v.getUint16(14, true),
+             cir_pwr: v.getUint16(16, true), age_ms: v.getUint32(18, true) };
+}
+
+let streamDropped = false;
+function connectStream() {
+    const fmt = new URLSearchParams(location.search).get('fmt') || 'struct';
+    const ws = new WebSocket(`ws://${location.host}/ws?fmt=${fmt}`);
+    ws.binaryType = 'arraybuffer';
+    // Tras una reconexión las estelas tienen huecos: se piden de nuevo
+    ws.onopen = () => { if (streamDropped) loadTrails(); };
+    ws.onmessage = (msg) => {
+        const ev = (typeof msg.data === 'string') ? JSON.parse(msg.data) : decodeEvent(msg.data, fmt);
+        const type = ev.type || (ev.anchor_saddr !== undefined ? 'anchor' : 'fix');
+        if (type === 'fix') applyFix(ev);
+        else applyAnchor(ev);
+    };
+    ws.onclose = () => { streamDropped = true; setTimeout(connectStream, 2000); };
+}
+connectStream();
+
+// Sondeo incremental: solo se piden las entradas posteriores a la última versión
+// vista en el mismo arranque del concentrador (boot); si reinició, llega todo
+let dataVersion = 0;
+let dataBoot = 0;
+setInterval(() => {
+    fetch(`/data?since=${dataVersion}&boot=${dataBoot}`).then(r => {
+        if (r.status === 304) return null;
+        return r.json();
+    }).then(data => {
+        if (!data) return;
+        if (data.since === 0) {
+            anchorTable.clear();
+            tagTable.clear();
+        }
+        dataVersion = data.version;
+        dataBoot = data.boot;
+        for (const id in data.anchors) applyAnchor(data.anchors[id]);
+        for (const id in data.tags) applyFix(data.tags[id]);
+    }).catch(console.error);
+}, 2000);